@@ -0,0 +1,670 @@
+/**
+ * @file BTree.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "BTree.h"
+#include "HeapTable.h"
+#include "ColumnTable.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+/**
+ * Constructor
+ * @param relation         the relation to index
+ * @param name             the index's name (its file is <table>-<name>.db)
+ * @param key_columns      the relation's columns the key is made of, in order
+ * @param unique           whether two rows can't have the same key
+ * @param include_columns  more of the relation's columns whose values the leaves carry
+ */
+BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+                       ColumnNames include_columns)
+        : DbIndex(relation, name, key_columns, unique, include_columns), file(relation.get_table_name() + "-" + name),
+          pool(file), closed(true), root(0), height(0), key_types(), include_types(), node_reads(0) {
+    for (uint i = 0; i < this->ordinals.size(); i++) {
+        Identifier column_name = i < this->key_columns.size() ? this->key_columns[i]
+                                                              : this->include_columns[i - this->key_columns.size()];
+        if (this->ordinals[i] < 0)
+            throw DbRelationError("table '" + relation.get_table_name() + "' has no column '" + column_name + "'");
+        ColumnAttribute ca = relation.get_column_attributes()[this->ordinals[i]];
+        (i < this->key_columns.size() ? this->key_types : this->include_types).push_back(ca.get_data_type());
+    }
+}
+
+/**
+ * Create the index's file with an empty root leaf, then add the relation's rows to it.
+ */
+void BTreeIndex::create() {
+    this->file.create();
+    this->closed = false;
+    Node leaf;
+    leaf.is_leaf = true;
+    leaf.link = 0;
+    SlottedPage *page = this->pool.fetch_new();
+    leaf.id = page->get_block_id();
+    this->pool.unpin(page);
+    write(leaf);
+    this->root = leaf.id;
+    this->height = 1;
+    save_stat();
+
+    Handles *handles = this->relation.select();
+    try {
+        for (auto const &handle: *handles)
+            insert(handle);
+    } catch (...) {
+        delete handles;
+        drop();
+        throw;
+    }
+    delete handles;
+}
+
+/**
+ * Remove the index's file.
+ */
+void BTreeIndex::drop() {
+    open();
+    this->pool.discard();
+    this->file.drop();
+    this->closed = true;
+}
+
+/**
+ * Open the index's file and read the tree's stats.
+ */
+void BTreeIndex::open() {
+    if (!this->closed)
+        return;
+    this->file.open();
+    this->closed = false;
+    SlottedPage *stat = this->pool.fetch(STAT_BLOCK);
+    RecordView data;
+    if (stat->view(1, data)) {
+        this->root = *(u_int32_t *) data.data;
+        this->height = *(u_int32_t *) (data.data + 4);
+    }
+    this->pool.unpin(stat);
+}
+
+/**
+ * Write back the changed nodes and close the index's file.
+ */
+void BTreeIndex::close() {
+    if (this->closed)
+        return;
+    this->pool.clear();
+    this->file.close();
+    this->closed = true;
+}
+
+/**
+ * Find the rows with a given key.
+ * @param key   a value for each key column
+ * @param rows  if not nullptr, gets the rows' values from their entries
+ * @return      the rows' handles
+ */
+Handles *BTreeIndex::lookup(const KeyValue &key, Rows *rows) {
+    return range(key, key, rows);
+}
+
+/**
+ * Find the rows whose keys are in a range: go down to the leaf where the least key would be, then read
+ * entries in order, from leaf to leaf, until one is past the greatest key. A key matches a bound if its
+ * leading values are within it, so a partial key bounds all the keys that start with it.
+ * @param min_key  least key or leading part of one (empty for none)
+ * @param max_key  greatest key or leading part of one (empty for none)
+ * @param rows     if not nullptr, gets the rows' values from their entries
+ * @return         the rows' handles, in key order
+ */
+Handles *BTreeIndex::range(const KeyValue &min_key, const KeyValue &max_key, Rows *rows) {
+    open();
+    Handles *handles = new Handles();
+    Entry least;
+    least.key = min_key;
+    Node node;
+    read(find_leaf(least, true), node);
+    while (true) {
+        for (auto const &entry: node.entries) {
+            if (compare(entry.key, min_key, min_key.size()) < 0)
+                continue;
+            if (compare(entry.key, max_key, max_key.size()) > 0)
+                return handles;
+            handles->push_back(entry.handle);
+            if (rows != nullptr) {
+                KeyValue values(entry.key);
+                values.insert(values.end(), entry.included.begin(), entry.included.end());
+                rows->push_back(make_row(values));
+            }
+        }
+        if (node.link == 0)
+            return handles;
+        read(node.link, node);
+    }
+}
+
+/**
+ * Add a row to the index, splitting the root if it overflows.
+ * @param handle  the row (stored in the relation)
+ * @throws DbRelationError  if the index is unique and already has the row's key
+ */
+void BTreeIndex::insert(Handle handle) {
+    open();
+    Entry entry;
+    entry.key = project(handle, this->key_columns);
+    entry.handle = handle;
+    entry.child = 0;
+    if (!this->include_columns.empty())
+        entry.included = project(handle, this->include_columns);
+    if (entry_size(entry, false) > node_capacity() / 4 || entry_size(entry, true) > node_capacity() / 4)
+        throw DbRelationError("key too long for index '" + this->name + "'");
+    if (this->unique) {
+        Handles *handles = lookup(entry.key);
+        bool duplicate = !handles->empty();
+        delete handles;
+        if (duplicate)
+            throw DbRelationError("duplicate key for unique index '" + this->name + "'");
+    }
+    Entry split;
+    if (insert(this->root, entry, split)) {
+        Node new_root;
+        SlottedPage *page = this->pool.fetch_new();
+        new_root.id = page->get_block_id();
+        this->pool.unpin(page);
+        new_root.is_leaf = false;
+        new_root.link = this->root;
+        new_root.entries.push_back(split);
+        write(new_root);
+        this->root = new_root.id;
+        this->height++;
+        save_stat();
+    }
+}
+
+/**
+ * Remove a row from the index.
+ * @param handle  the row (still stored in the relation)
+ * @throws DbRelationError  if the row isn't in the index
+ */
+void BTreeIndex::del(Handle handle) {
+    open();
+    Entry entry;
+    entry.key = project(handle, this->key_columns);
+    entry.handle = handle;
+    Node leaf;
+    read(find_leaf(entry, false), leaf);
+    for (auto it = leaf.entries.begin(); it != leaf.entries.end(); it++) {
+        if (compare(*it, entry) == 0) {
+            leaf.entries.erase(it);
+            write(leaf);
+            return;
+        }
+    }
+    throw DbRelationError("row not found in index '" + this->name + "'");
+}
+
+/**
+ * Insert an entry into a subtree.
+ * @param node_id  the subtree's root
+ * @param entry    the entry
+ * @param split    if the node splits, set to the boundary of its new right half
+ * @return         true if the node split
+ */
+bool BTreeIndex::insert(BlockID node_id, const Entry &entry, Entry &split) {
+    Node node;
+    read(node_id, node);
+    auto position = upper_bound(node.entries.begin(), node.entries.end(), entry,
+                                [](const Entry &a, const Entry &b) { return compare(a, b) < 0; });
+    if (node.is_leaf) {
+        node.entries.insert(position, entry);
+    } else {
+        BlockID child = position == node.entries.begin() ? node.link : (position - 1)->child;
+        Entry child_split;
+        if (!insert(child, entry, child_split))
+            return false;
+        node.entries.insert(position, child_split);
+    }
+
+    u_int32_t size = NODE_HEADER_SZ;
+    for (auto const &e: node.entries)
+        size += entry_size(e, node.is_leaf);
+    if (size <= node_capacity()) {
+        write(node);
+        return false;
+    }
+
+    // split in two by size; an interior node's middle boundary moves up instead of being copied
+    Node right;
+    SlottedPage *page = this->pool.fetch_new();
+    right.id = page->get_block_id();
+    this->pool.unpin(page);
+    right.is_leaf = node.is_leaf;
+    uint half = 0;
+    for (u_int32_t left_size = NODE_HEADER_SZ; left_size < size / 2; half++)
+        left_size += entry_size(node.entries[half], node.is_leaf);
+    half = max(1U, min(half, (uint) node.entries.size() - 1));
+    split = node.entries[half];
+    split.child = right.id;
+    split.included.clear();
+    if (node.is_leaf) {
+        right.entries.assign(node.entries.begin() + half, node.entries.end());
+        right.link = node.link;
+        node.link = right.id;
+    } else {
+        right.entries.assign(node.entries.begin() + half + 1, node.entries.end());
+        right.link = node.entries[half].child;
+    }
+    node.entries.resize(half);
+    write(right);
+    write(node);
+    return true;
+}
+
+/**
+ * Go down the tree to the leaf an entry belongs in.
+ * @param entry      the entry
+ * @param by_prefix  look for the first entry whose key starts at or after the entry's key (which may
+ *                   be a leading part of a key), rather than for the entry itself
+ * @return           the leaf's block id
+ */
+BlockID BTreeIndex::find_leaf(const Entry &entry, bool by_prefix) {
+    BlockID node_id = this->root;
+    Node node;
+    for (uint level = 1; level < this->height; level++) {
+        read(node_id, node);
+        BlockID child = node.link;
+        for (auto const &boundary: node.entries) {
+            int order = by_prefix ? compare(boundary.key, entry.key, entry.key.size()) : compare(boundary, entry);
+            if (by_prefix ? order >= 0 : order > 0)
+                break;
+            child = boundary.child;
+        }
+        node_id = child;
+    }
+    return node_id;
+}
+
+/**
+ * Read a node out of its block.
+ * @param node_id  the node's block id
+ * @param node     where to put it
+ */
+void BTreeIndex::read(BlockID node_id, Node &node) {
+    SlottedPage *page = this->pool.fetch(node_id);
+    this->node_reads++;
+    RecordView data;
+    if (!page->view(1, data)) {
+        this->pool.unpin(page);
+        throw DbRelationError("index '" + this->name + "' has no node in block " + to_string(node_id));
+    }
+    const char *bytes = data.data;
+    node.id = node_id;
+    node.is_leaf = bytes[0] != 0;
+    u16 count = *(u16 *) (bytes + 2);
+    node.link = *(u_int32_t *) (bytes + 4);
+    node.entries.resize(count);
+    uint offset = NODE_HEADER_SZ;
+    for (auto &entry: node.entries) {
+        read_values(bytes, offset, this->key_types, entry.key);
+        entry.handle.first = *(u_int32_t *) (bytes + offset);
+        entry.handle.second = *(u16 *) (bytes + offset + 4);
+        offset += 6;
+        entry.child = 0;
+        if (node.is_leaf) {
+            read_values(bytes, offset, this->include_types, entry.included);
+        } else {
+            entry.child = *(u_int32_t *) (bytes + offset);
+            offset += 4;
+            entry.included.clear();
+        }
+    }
+    this->pool.unpin(page);
+}
+
+/**
+ * Write a node into its block, replacing what was there.
+ * @param node  the node
+ */
+void BTreeIndex::write(const Node &node) {
+    u_int32_t size = NODE_HEADER_SZ;
+    for (auto const &entry: node.entries)
+        size += entry_size(entry, node.is_leaf);
+    vector<char> bytes(size, 0);
+    bytes[0] = node.is_leaf;
+    *(u16 *) (bytes.data() + 2) = (u16) node.entries.size();
+    *(u_int32_t *) (bytes.data() + 4) = node.link;
+    uint offset = NODE_HEADER_SZ;
+    for (auto const &entry: node.entries) {
+        write_values(entry.key, bytes.data(), offset);
+        *(u_int32_t *) (bytes.data() + offset) = entry.handle.first;
+        *(u16 *) (bytes.data() + offset + 4) = entry.handle.second;
+        offset += 6;
+        if (node.is_leaf) {
+            write_values(entry.included, bytes.data(), offset);
+        } else {
+            *(u_int32_t *) (bytes.data() + offset) = entry.child;
+            offset += 4;
+        }
+    }
+    SlottedPage *page = this->pool.fetch(node.id);
+    RecordView data;
+    if (page->view(1, data)) {
+        memcpy(page->replace(1, size), bytes.data(), size);
+    } else {
+        Dbt record(bytes.data(), size);
+        page->add(&record);
+    }
+    this->pool.unpin(page, true);
+}
+
+/**
+ * Write the tree's root and height into the stat block.
+ */
+void BTreeIndex::save_stat() {
+    u_int32_t stat[2] = {this->root, this->height};
+    Dbt data(stat, sizeof(stat));
+    SlottedPage *page = this->pool.fetch(STAT_BLOCK);
+    RecordView record;
+    if (page->view(1, record))
+        page->put(1, data);
+    else
+        page->add(&data);
+    this->pool.unpin(page, true);
+}
+
+/**
+ * Number of bytes an entry takes in a node.
+ * @param entry    the entry
+ * @param is_leaf  whether it is in a leaf (a leaf's entries also have included values, an interior
+ *                 node's a child)
+ * @return         its size
+ */
+u_int32_t BTreeIndex::entry_size(const Entry &entry, bool is_leaf) const {
+    return 6 + values_size(entry.key) + (is_leaf ? values_size(entry.included) : 4);  // handle, child
+}
+
+/**
+ * Most bytes a node can take: its block, less the block's header and the record's.
+ */
+u_int32_t BTreeIndex::node_capacity() const {
+    return this->file.get_block_size() - 12;
+}
+
+/**
+ * Unmarshal values: each INT is 4 bytes, each TEXT its length (2 bytes) and bytes.
+ * @param bytes   where they are
+ * @param offset  where they start, moved past them
+ * @param types   the type of each value
+ * @param values  set to the values
+ */
+void BTreeIndex::read_values(const char *bytes, uint &offset, const vector<ColumnAttribute::DataType> &types,
+                             KeyValue &values) {
+    values.resize(types.size());
+    for (uint i = 0; i < types.size(); i++) {
+        Value &value = values[i];
+        value.data_type = types[i];
+        if (value.data_type == ColumnAttribute::INT) {
+            value.n = *(int32_t *) (bytes + offset);
+            offset += sizeof(int32_t);
+        } else {
+            u16 size = *(u16 *) (bytes + offset);
+            offset += sizeof(u16);
+            value.s.assign(bytes + offset, size);
+            offset += size;
+        }
+    }
+}
+
+/**
+ * Marshal values (see read_values).
+ * @param values  the values
+ * @param bytes   where to put them
+ * @param offset  where they start, moved past them
+ */
+void BTreeIndex::write_values(const KeyValue &values, char *bytes, uint &offset) {
+    for (auto const &value: values) {
+        if (value.data_type == ColumnAttribute::INT) {
+            *(int32_t *) (bytes + offset) = value.n;
+            offset += sizeof(int32_t);
+        } else {
+            *(u16 *) (bytes + offset) = (u16) value.s.length();
+            offset += sizeof(u16);
+            memcpy(bytes + offset, value.s.data(), value.s.length());
+            offset += (uint) value.s.length();
+        }
+    }
+}
+
+/**
+ * Number of bytes values take marshaled (see read_values).
+ */
+u_int32_t BTreeIndex::values_size(const KeyValue &values) {
+    u_int32_t size = 0;
+    for (auto const &value: values)
+        size += value.data_type == ColumnAttribute::INT ? sizeof(int32_t) : sizeof(u16) + (u_int32_t) value.s.length();
+    return size;
+}
+
+/**
+ * Order a key against a bound, over the bound's length.
+ * @param key     the key
+ * @param other   the bound (or another key)
+ * @param length  how many leading values to compare
+ * @return        negative, zero or positive as the key comes before, matches or comes after the bound
+ */
+int BTreeIndex::compare(const KeyValue &key, const KeyValue &other, size_t length) {
+    for (size_t i = 0; i < length && i < key.size(); i++) {
+        if (key[i] < other[i])
+            return -1;
+        if (other[i] < key[i])
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Order entries by key, then by handle.
+ */
+int BTreeIndex::compare(const Entry &entry, const Entry &other) {
+    int order = compare(entry.key, other.key, entry.key.size());
+    if (order != 0)
+        return order;
+    return entry.handle < other.handle ? -1 : other.handle < entry.handle ? 1 : 0;
+}
+
+/**
+ * Testing function for BTreeIndex.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_btree() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_btree_cpp", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i = 0; i < 10000; i++) {
+        row[0] = Value(i % 5000);  // each a twice
+        row[1] = Value(string(20, (char) ('a' + i % 26)));
+        rows.push_back(row);
+    }
+    Handles *handles = table.insert_many(&rows);
+
+    BTreeIndex index(table, "ix", {"a"}, false);
+    index.create();
+    table.attach(&index);
+    if (index.get_height() < 2 || index.get_height() > 3)
+        return assertion_failure("btree height", index.get_height());
+    u_long reads = index.get_node_reads();
+    Handles *found = index.lookup(KeyValue{Value(1234)});
+    if (found->size() != 2 || (*found)[0] != (*handles)[1234] || (*found)[1] != (*handles)[6234])
+        return assertion_failure("btree lookup", (double) found->size());
+    if (index.get_node_reads() - reads > index.get_height() + 1)
+        return assertion_failure("btree lookup reads", index.get_node_reads() - reads);
+    delete found;
+    found = index.range(KeyValue{Value(100)}, KeyValue{Value(149)});
+    if (found->size() != 100)
+        return assertion_failure("btree range", (double) found->size());
+    delete found;
+    found = index.range(KeyValue(), KeyValue{Value(-1)});
+    if (!found->empty())
+        return assertion_failure("btree empty range");
+    delete found;
+
+    // the table keeps it up to date and uses it for equality and range predicates
+    ValueDict where;
+    where["a"] = Value(4321);
+    reads = index.get_node_reads();
+    u_long scanned = table.get_blocks_scanned();
+    found = table.select(&where);
+    if (found->size() != 2 || table.get_blocks_scanned() != scanned || index.get_node_reads() == reads)
+        return assertion_failure("select by index", (double) found->size());
+    table.del(found->front());
+    delete found;
+    ValueDict new_values;
+    new_values["a"] = Value(-7);
+    table.update((*handles)[4321 + 5000], &new_values);
+    found = table.select(&where);
+    bool ok = found->empty();
+    delete found;
+    found = index.lookup(KeyValue{Value(-7)});
+    ok = ok && found->size() == 1 && found->front() == (*handles)[4321 + 5000];
+    delete found;
+    row[0] = Value(-7);
+    Handle added = table.insert(&row);
+    found = index.lookup(&new_values);
+    ok = ok && found->size() == 2 && found->back() == added;
+    delete found;
+    if (!ok)
+        return assertion_failure("index maintenance");
+
+    // a where clause that an index narrows down is still checked in full
+    where.clear();
+    where["a"] = Value(2);
+    where["b"] = Value(string(20, 'c'));
+    found = table.select(&where);
+    if (found->size() != 1 || found->front() != (*handles)[2])
+        return assertion_failure("select by index and rest of where clause", (double) found->size());
+    delete found;
+
+    // a unique index turns away duplicates
+    index.close();
+    BTreeIndex unique(table, "ux", {"b", "a"}, true);
+    unique.create();
+    table.attach(&unique);
+    try {
+        table.insert(&row);
+        return assertion_failure("duplicate key in unique index");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    found = unique.lookup(KeyValue{Value(row[1].s), Value(-7)});
+    ok = found->size() == 1 && found->front() == added;
+    delete found;
+    ValueDict duplicate;
+    duplicate["a"] = Value(-7);
+    try {
+        table.update((*handles)[0], &duplicate);
+        duplicate["b"] = Value(row[1].s);
+        table.update((*handles)[0], &duplicate);
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    ValueDict *values = table.project((*handles)[0]);
+    ok = ok && (*values)["a"] == Value(-7) && (*values)["b"] == Value(string(20, 'a'));
+    delete values;
+    BTreeIndex copy(table, "cx", {"b"}, true);
+    try {
+        copy.create();
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    if (!ok)
+        return assertion_failure("unique index");
+    table.detach(&unique);
+
+    // an index with included columns answers selects and scans from its own entries
+    BTreeIndex covering(table, "cv", {"a"}, false, {"b"});
+    covering.create();
+    table.attach(&covering);
+    where.clear();
+    where["a"] = Value(2);
+    where["b"] = Value(string(20, 'c'));
+    const BufferPool &pool = table.get_buffer_pool();
+    u_long fetches = pool.get_hits() + pool.get_misses();
+    scanned = table.get_blocks_scanned();
+    found = table.select(&where);
+    ok = found->size() == 1 && found->front() == (*handles)[2];
+    delete found;
+    Predicate b_is_c(&where, column_names, column_attributes);
+    ColumnNames b_only = {"b"};
+    DbRelationScan *scan = table.scan(&b_only, b_is_c);
+    Batch batch;
+    ok = ok && dynamic_cast<DbIndexScan *>(scan) != nullptr && scan->next(batch) && batch.size() == 1
+         && batch.handles[0] == (*handles)[2] && !scan->next(batch);
+    delete scan;
+    if (!ok || pool.get_hits() + pool.get_misses() != fetches || table.get_blocks_scanned() != scanned)
+        return assertion_failure("index-only select and scan");
+    new_values.clear();
+    new_values["b"] = Value(string("changed"));
+    table.update((*handles)[2], &new_values);
+    found = table.select(&where);
+    ok = found->empty();
+    delete found;
+    Rows covered;
+    found = covering.lookup(KeyValue{Value(2)}, &covered);
+    ok = ok && found->size() == 2 && covered.size() == 2;
+    for (uint i = 0; ok && i < found->size(); i++)
+        ok = covered[i][1] == Value((*found)[i] == (*handles)[2] ? string("changed") : string(20, 'a' + 5002 % 26));
+    delete found;
+    if (!ok)
+        return assertion_failure("included column maintenance");
+
+    table.detach(&index);
+    table.detach(&covering);
+    index.drop();
+    unique.drop();
+    covering.drop();
+    table.drop();
+    delete handles;
+
+    // any relation can have an index
+    ColumnTable columns("_test_btree_column_cpp", column_names, column_attributes);
+    columns.create();
+    for (int i = 0; i < 3000; i++) {
+        row[0] = Value(i);
+        row[1] = Value(string(10, (char) ('a' + i % 26)));
+        columns.insert(&row);
+    }
+    BTreeIndex column_index(columns, "ix", {"a"}, true);
+    column_index.create();
+    columns.attach(&column_index);
+    where.clear();
+    where["a"] = Value(2500);
+    reads = column_index.get_node_reads();
+    found = columns.select(&where);
+    ok = found->size() == 1 && column_index.get_node_reads() > reads;
+    if (ok) {
+        values = columns.project(found->front());
+        ok = (*values)["a"] == Value(2500);
+        delete values;
+    }
+    new_values.clear();
+    new_values["a"] = Value(-1);
+    columns.update(found->front(), &new_values);
+    columns.del(found->front());
+    delete found;
+    found = column_index.lookup(&new_values);
+    ok = ok && found->empty();
+    delete found;
+    columns.detach(&column_index);
+    column_index.drop();
+    columns.drop();
+    if (!ok)
+        return assertion_failure("index of a column table");
+    return true;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file BTree.h - B+tree implementation of DbIndex.
+ * BTreeIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "HeapFile.h"
+#include "BufferPool.h"
+
+/**
+ * @class BTreeIndex - B+tree index of a relation (implementation of DbIndex)
+ *
+ * The tree's nodes are the blocks of a HeapFile of their own (<table>-<index>.db), read and written
+ * through a BufferPool. Block 1 holds the tree's stats (its root and height); every other block is a node,
+ * kept as the one record of its SlottedPage and rewritten whole when it changes. A leaf holds entries of
+ * (key, handle) in order, each followed by its row's included values, and the id of the next leaf. An
+ * interior node holds the subtree of the entries before its first boundary, then boundaries, each a key
+ * and handle and the subtree of the entries from it on.
+ *
+ * Entries are ordered by key and then by handle, so every entry is distinct even in a non-unique index, and
+ * an insert or delete goes straight to the one leaf the entry belongs in. A node that outgrows its block is
+ * split in half and the new right half's boundary goes up to its parent; a root that splits gets a new
+ * root above it. Deletes just take entries out of their leaves (nodes are never merged), so a tree that has
+ * shrunk a lot should be dropped and created again.
+ *
+ * A lookup reads one node per level plus the leaves its entries are in, so it reads O(log N) blocks.
+ */
+class BTreeIndex : public DbIndex {
+public:
+    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+               ColumnNames include_columns = ColumnNames());
+
+    virtual ~BTreeIndex() {}
+
+    BTreeIndex(const BTreeIndex &other) = delete;
+
+    BTreeIndex(BTreeIndex &&temp) = delete;
+
+    BTreeIndex &operator=(const BTreeIndex &other) = delete;
+
+    BTreeIndex &operator=(BTreeIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const KeyValue &key, Rows *rows);
+
+    using DbIndex::lookup;
+
+    virtual Handles *range(const KeyValue &min_key, const KeyValue &max_key, Rows *rows);
+
+    using DbIndex::range;
+
+    virtual void insert(Handle handle);
+
+    virtual void del(Handle handle);
+
+    virtual bool is_ordered() const { return true; }
+
+    /**
+     * Number of levels in the tree (1 while the root is a leaf).
+     */
+    virtual uint get_height() {
+        open();
+        return height;
+    }
+
+    /**
+     * Number of nodes read since the index was constructed (e.g., to see that a lookup reads O(log N)).
+     */
+    virtual u_long get_node_reads() const { return node_reads; }
+
+protected:
+    /**
+     * A leaf's entry, or an interior node's boundary and the subtree of the entries from it on.
+     */
+    struct Entry {
+        KeyValue key;
+        Handle handle;
+        BlockID child;
+        KeyValue included;  // leaf only
+    };
+
+    /**
+     * A node, as read out of its block.
+     */
+    struct Node {
+        BlockID id;
+        bool is_leaf;
+        BlockID link;                // leaf: next leaf (0 for none); interior: subtree before the first boundary
+        std::vector<Entry> entries;
+    };
+
+    static const BlockID STAT_BLOCK = 1;
+    static const uint NODE_HEADER_SZ = 8;   // leaf flag, padding, number of entries, link
+
+    HeapFile file;
+    BufferPool pool;
+    bool closed;
+    BlockID root;
+    uint height;
+    std::vector<ColumnAttribute::DataType> key_types;
+    std::vector<ColumnAttribute::DataType> include_types;
+    u_long node_reads;
+
+    virtual bool insert(BlockID node_id, const Entry &entry, Entry &split);
+
+    virtual BlockID find_leaf(const Entry &entry, bool by_prefix);
+
+    virtual void read(BlockID node_id, Node &node);
+
+    virtual void write(const Node &node);
+
+    virtual void save_stat();
+
+    virtual u_int32_t entry_size(const Entry &entry, bool is_leaf) const;
+
+    virtual u_int32_t node_capacity() const;
+
+    static void read_values(const char *bytes, uint &offset, const std::vector<ColumnAttribute::DataType> &types,
+                            KeyValue &values);
+
+    static void write_values(const KeyValue &values, char *bytes, uint &offset);
+
+    static u_int32_t values_size(const KeyValue &values);
+
+    static int compare(const KeyValue &key, const KeyValue &other, size_t length);
+
+    static int compare(const Entry &entry, const Entry &other);
+};
+
+bool test_btree();
@@ -0,0 +1,364 @@
+/**
+ * @file BloomFilter.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "BloomFilter.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param relation     the relation to filter
+ * @param name         the filter's name (its file is <table>-<name>.db)
+ * @param key_columns  the relation's columns the key is made of, in order
+ */
+BloomFilter::BloomFilter(DbRelation &relation, Identifier name, ColumnNames key_columns)
+        : DbIndex(relation, name, key_columns, false), file(relation.get_table_name() + "-" + name), pool(file),
+          closed(true), bits(0), capacity(0), keys(0), deletes(0), bits_set(0), key_types(), probes(0),
+          negatives(0), rebuilds(0) {
+    for (uint i = 0; i < this->ordinals.size(); i++) {
+        if (this->ordinals[i] < 0)
+            throw DbRelationError("table '" + relation.get_table_name() + "' has no column '" + this->key_columns[i] + "'");
+        ColumnAttribute ca = relation.get_column_attributes()[this->ordinals[i]];
+        this->key_types.push_back(ca.get_data_type());
+    }
+}
+
+/**
+ * Create the filter's file, then size its bits for the relation's rows and add their keys.
+ */
+void BloomFilter::create() {
+    this->file.create();
+    this->closed = false;
+    Handles *handles = this->relation.select();
+    try {
+        build((u_int32_t) handles->size());
+        for (auto const &handle: *handles)
+            insert(handle);
+    } catch (...) {
+        delete handles;
+        drop();
+        throw;
+    }
+    delete handles;
+}
+
+/**
+ * Remove the filter's file.
+ */
+void BloomFilter::drop() {
+    open();
+    this->pool.discard();
+    this->file.drop();
+    this->closed = true;
+}
+
+/**
+ * Open the filter's file and read its stats.
+ */
+void BloomFilter::open() {
+    if (!this->closed)
+        return;
+    this->file.open();
+    this->closed = false;
+    SlottedPage *stat = this->pool.fetch(STAT_BLOCK);
+    RecordView data;
+    if (stat->view(1, data)) {
+        const u_int32_t *fields = (const u_int32_t *) data.data;
+        this->bits = fields[0];
+        this->capacity = fields[1];
+        this->keys = fields[2];
+        this->deletes = fields[3];
+        this->bits_set = fields[4];
+    }
+    this->pool.unpin(stat);
+}
+
+/**
+ * Write back the changed blocks and close the filter's file.
+ */
+void BloomFilter::close() {
+    if (this->closed)
+        return;
+    this->pool.clear();
+    this->file.close();
+    this->closed = true;
+}
+
+/**
+ * A filter can't find rows.
+ * @throws DbRelationError  always
+ */
+Handles *BloomFilter::lookup(const KeyValue &key, Rows *rows) {
+    throw DbRelationError("bloom filter '" + this->name + "' can't look rows up");
+}
+
+/**
+ * Add a row's key: set each of its bits.
+ * @param handle  the row (stored in the relation)
+ */
+void BloomFilter::insert(Handle handle) {
+    open();
+    u_int32_t h1, h2;
+    hash(project(handle, this->key_columns), h1, h2);
+    u_int32_t per_block = bits_per_block();
+    for (uint i = 0; i < HASHES; i++) {
+        u_int32_t bit = (u_int32_t) ((h1 + (u_int64_t) i * h2) % this->bits);
+        SlottedPage *page = this->pool.fetch(FIRST_BITS + bit / per_block);
+        RecordView data;
+        page->view(1, data);
+        char *bytes = (char *) page->replace(1, data.size);  // same size, so in place
+        char mask = (char) (1 << (bit % per_block % 8));
+        bool dirty = (bytes[bit % per_block / 8] & mask) == 0;
+        if (dirty) {
+            bytes[bit % per_block / 8] |= mask;
+            this->bits_set++;
+        }
+        this->pool.unpin(page, dirty);
+    }
+    this->keys++;
+    save_stat();
+}
+
+/**
+ * Count a row's key as gone (its bits stay set, since other keys may share them).
+ * @param handle  the row (still stored in the relation)
+ */
+void BloomFilter::del(Handle handle) {
+    open();
+    this->deletes++;
+    save_stat();
+}
+
+/**
+ * Check a key's bits, building the filter again first if it has gone stale.
+ * @param key  a value for each key column, in order
+ * @return     false if no row has the key; true if one might
+ */
+bool BloomFilter::may_contain(const KeyValue &key) {
+    if (is_stale())
+        rebuild();
+    this->probes++;
+    u_int32_t h1, h2;
+    hash(key, h1, h2);
+    u_int32_t per_block = bits_per_block();
+    for (uint i = 0; i < HASHES; i++) {
+        u_int32_t bit = (u_int32_t) ((h1 + (u_int64_t) i * h2) % this->bits);
+        SlottedPage *page = this->pool.fetch(FIRST_BITS + bit / per_block);
+        RecordView data;
+        page->view(1, data);
+        bool set = (data.data[bit % per_block / 8] & (1 << (bit % per_block % 8))) != 0;
+        this->pool.unpin(page);
+        if (!set) {
+            this->negatives++;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Clear the bits (resized for the relation's rows) and add every row's key again.
+ */
+void BloomFilter::rebuild() {
+    open();
+    Handles *handles = this->relation.select();
+    build((u_int32_t) handles->size());
+    for (auto const &handle: *handles)
+        insert(handle);
+    delete handles;
+    this->rebuilds++;
+}
+
+/**
+ * Stale once the deletes come to half of the keys, or the keys outgrow what the bits were sized for.
+ */
+bool BloomFilter::is_stale() {
+    open();
+    return this->deletes * 2 > this->keys || this->keys > this->capacity;
+}
+
+/**
+ * Estimated false-positive rate, from the fraction of bits set.
+ */
+double BloomFilter::get_false_positive_rate() {
+    open();
+    return pow((double) this->bits_set / this->bits, (double) HASHES);
+}
+
+/**
+ * Size the bits for twice the given number of keys (at least MIN_KEYS), in whole blocks, and clear them.
+ * @param rows  how many rows the relation has
+ */
+void BloomFilter::build(u_int32_t rows) {
+    u_int32_t per_block = bits_per_block();
+    this->capacity = max(rows * 2, MIN_KEYS);
+    u_int32_t blocks = (this->capacity * BITS_PER_KEY + per_block - 1) / per_block;
+    this->bits = blocks * per_block;
+    this->keys = 0;
+    this->deletes = 0;
+    this->bits_set = 0;
+    save_stat();
+    vector<char> zeros(per_block / 8, 0);
+    Dbt data(zeros.data(), (u_int32_t) zeros.size());
+    for (BlockID block_id = FIRST_BITS; block_id < FIRST_BITS + blocks; block_id++) {
+        SlottedPage *page = block_id <= this->file.get_last_block_id() ? this->pool.fetch(block_id)
+                                                                       : this->pool.fetch_new();
+        RecordView record;
+        if (page->view(1, record))
+            page->put(1, data);
+        else
+            page->add(&data);
+        this->pool.unpin(page, true);
+    }
+}
+
+/**
+ * Two hashes of a key, for double hashing: FNV-1a of the key's bytes (each INT as 4 bytes, each TEXT as
+ * its length and bytes), mixed two ways.
+ * @param key  a value for each key column
+ * @param h1   set to the first hash
+ * @param h2   set to the second (odd, so that the probes don't repeat early)
+ */
+void BloomFilter::hash(const KeyValue &key, u_int32_t &h1, u_int32_t &h2) const {
+    if (key.size() != this->key_types.size())
+        throw DbRelationError("wrong number of key values for bloom filter '" + this->name + "'");
+    u_int32_t h = 2166136261U;
+    for (uint i = 0; i < key.size(); i++) {
+        const Value &value = key[i];
+        if (value.data_type != this->key_types[i])
+            throw DbRelationError("wrong type of key value for bloom filter '" + this->name + "'");
+        string bytes;
+        if (value.data_type == ColumnAttribute::INT) {
+            bytes.assign((const char *) &value.n, sizeof(int32_t));
+        } else {
+            u_int16_t size = (u_int16_t) value.s.length();
+            bytes.assign((const char *) &size, sizeof(u_int16_t));
+            bytes += value.s;
+        }
+        for (char c: bytes) {
+            h ^= (u_char) c;
+            h *= 16777619U;
+        }
+    }
+    h1 = h ^ (h >> 16);
+    h1 *= 0x85ebca6bU;
+    h1 ^= h1 >> 13;
+    h2 = h ^ (h >> 15);
+    h2 *= 0xc2b2ae35U;
+    h2 ^= h2 >> 16;
+    h2 |= 1;
+}
+
+/**
+ * Write the filter's stats into the stat block: bits, capacity, keys, deletes, bits set.
+ */
+void BloomFilter::save_stat() {
+    u_int32_t stat[5] = {this->bits, this->capacity, this->keys, this->deletes, this->bits_set};
+    Dbt data(stat, sizeof(stat));
+    SlottedPage *page = this->pool.fetch(STAT_BLOCK);
+    RecordView record;
+    if (page->view(1, record))
+        page->put(1, data);
+    else
+        page->add(&data);
+    this->pool.unpin(page, true);
+}
+
+/**
+ * Number of bits a block holds: its block, less the block's and the record's headers, in whole bytes.
+ */
+u_int32_t BloomFilter::bits_per_block() const {
+    return (this->file.get_block_size() - 16) * 8;
+}
+
+/**
+ * Testing function for BloomFilter.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_bloom_filter() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_bloom_filter_cpp", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i = 0; i < 5000; i++) {
+        row[0] = Value(i * 2);  // evens only
+        row[1] = Value(string(20, (char) ('a' + i % 26)));
+        rows.push_back(row);
+    }
+    Handles *handles = table.insert_many(&rows);
+
+    BloomFilter filter(table, "bf", {"a"});
+    filter.create();
+    table.attach(&filter);
+    bool ok = true;
+    for (int a = 0; a < 10000 && ok; a += 2)
+        ok = filter.may_contain(KeyValue{Value(a)});
+    if (!ok)
+        return assertion_failure("bloom filter false negative");
+    u_long negatives = filter.get_negatives();
+    for (int a = 1; a < 10000; a += 2)
+        filter.may_contain(KeyValue{Value(a)});
+    double measured = 1.0 - (double) (filter.get_negatives() - negatives) / 5000;
+    if (measured > 0.03 || filter.get_false_positive_rate() > 0.03 || filter.get_false_positive_rate() <= 0.0)
+        return assertion_failure("bloom filter false positives", measured);
+    try {
+        delete filter.lookup(KeyValue{Value(2)});
+        return assertion_failure("bloom filter lookup");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+
+    // a select for a missing key stops at the filter; one for a present key scans as usual
+    ValueDict where;
+    where["a"] = Value(-1);
+    u_long scanned = table.get_blocks_scanned();
+    Handles *found = table.select(&where);
+    ok = found->empty() && table.get_blocks_scanned() == scanned;
+    delete found;
+    where["a"] = Value(4000);
+    found = table.select(&where);
+    ok = ok && found->size() == 1 && found->front() == (*handles)[2000] && table.get_blocks_scanned() > scanned;
+    delete found;
+    if (!ok)
+        return assertion_failure("select with a bloom filter");
+
+    // kept up to date: an inserted key is found, and heavy deletes make it rebuild without their keys
+    row[0] = Value(-3);
+    table.insert(&row);
+    where["a"] = Value(-3);
+    found = table.select(&where);
+    ok = found->size() == 1 && filter.may_contain(KeyValue{Value(-3)});
+    delete found;
+    for (uint i = 0; i < 3000; i++)
+        table.del((*handles)[i]);
+    if (!ok || !filter.is_stale())
+        return assertion_failure("bloom filter maintenance");
+    negatives = filter.get_negatives();
+    uint gone = 0;
+    for (int a = 0; a < 6000; a += 2)
+        gone += filter.may_contain(KeyValue{Value(a)}) ? 0 : 1;
+    if (filter.get_rebuilds() != 1 || gone < 2900 || !filter.may_contain(KeyValue{Value(-3)})
+        || !filter.may_contain(KeyValue{Value(6000)}))
+        return assertion_failure("bloom filter rebuild", gone);
+
+    // it lasts
+    double rate = filter.get_false_positive_rate();
+    filter.close();
+    BloomFilter reopened(table, "bf", {"a"});
+    ok = !reopened.is_stale() && reopened.get_false_positive_rate() == rate
+         && reopened.may_contain(KeyValue{Value(9998)});
+    table.detach(&filter);
+    reopened.drop();
+    table.drop();
+    delete handles;
+    if (!ok)
+        return assertion_failure("reopened bloom filter");
+    return true;
+}
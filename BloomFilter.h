@@ -0,0 +1,130 @@
+/**
+ * @file BloomFilter.h - Bloom filter implementation of DbIndex.
+ * BloomFilter: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "HeapFile.h"
+#include "BufferPool.h"
+
+/**
+ * @class BloomFilter - Bloom filter on some columns of a relation (implementation of DbIndex), for telling
+ * quickly that no row has a key
+ *
+ * The filter is an array of bits kept in the blocks of a HeapFile of its own (<table>-<index>.db): block 1
+ * holds the filter's stats and the bits follow from block 2 on, each block's as the one record of its
+ * SlottedPage. A row's key sets a few bits picked by hashing it (double hashing of one hash), so a key whose
+ * bits aren't all set is certainly not in the relation (see may_contain()), while one whose bits are might
+ * be, or might just share them with others (a false positive).
+ *
+ * The bits are sized when the filter is built for twice as many keys as there are rows, at BITS_PER_KEY bits
+ * each, so that even once it holds that many, only about one probe in a hundred for a missing key is a false
+ * positive. Bits can't be taken back out, so a delete only counts the key as gone; once the deletes come to
+ * half the keys, or the keys outgrow what the bits were sized for, the filter goes stale and is built again
+ * from the relation's rows before the next probe. The estimated false-positive rate (see
+ * get_false_positive_rate()) is kept from how many of the bits are set.
+ *
+ * A filter doesn't find rows, only rules keys out, so it is never picked to answer a select by itself and
+ * it has no included columns.
+ */
+class BloomFilter : public DbIndex {
+public:
+    static const uint BITS_PER_KEY = 10;
+    static const uint HASHES = 7;           // about BITS_PER_KEY * ln 2
+    static const u_int32_t MIN_KEYS = 1024;
+
+    BloomFilter(DbRelation &relation, Identifier name, ColumnNames key_columns);
+
+    virtual ~BloomFilter() {}
+
+    BloomFilter(const BloomFilter &other) = delete;
+
+    BloomFilter(BloomFilter &&temp) = delete;
+
+    BloomFilter &operator=(const BloomFilter &other) = delete;
+
+    BloomFilter &operator=(BloomFilter &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const KeyValue &key, Rows *rows);
+
+    using DbIndex::lookup;
+
+    virtual void insert(Handle handle);
+
+    virtual void del(Handle handle);
+
+    virtual bool finds_rows() const { return false; }
+
+    virtual bool may_contain(const KeyValue &key);
+
+    /**
+     * Build the filter again from the relation's rows (e.g., after many deletes), sized for their number.
+     */
+    virtual void rebuild();
+
+    /**
+     * Whether enough keys have been deleted or added since the filter was built that it will be built again
+     * before the next probe.
+     */
+    virtual bool is_stale();
+
+    /**
+     * Estimated chance that a probe for a key no row has is not ruled out: the fraction of bits set, to the
+     * power of the number of hashes.
+     */
+    virtual double get_false_positive_rate();
+
+    /**
+     * Number of probes (may_contain() calls) since the filter was constructed.
+     */
+    virtual u_long get_probes() const { return probes; }
+
+    /**
+     * Number of those probes that ruled their key out.
+     */
+    virtual u_long get_negatives() const { return negatives; }
+
+    /**
+     * Number of times the filter has been built again since it was constructed.
+     */
+    virtual u_long get_rebuilds() const { return rebuilds; }
+
+protected:
+    static const BlockID STAT_BLOCK = 1;
+    static const BlockID FIRST_BITS = 2;
+
+    HeapFile file;
+    BufferPool pool;
+    bool closed;
+    u_int32_t bits;                        // number of bits
+    u_int32_t capacity;                    // keys the bits were sized for
+    u_int32_t keys;                        // keys added since the filter was built
+    u_int32_t deletes;                     // keys deleted since the filter was built
+    u_int32_t bits_set;
+    std::vector<ColumnAttribute::DataType> key_types;
+    u_long probes;
+    u_long negatives;
+    u_long rebuilds;
+
+    virtual void build(u_int32_t rows);
+
+    virtual void hash(const KeyValue &key, u_int32_t &h1, u_int32_t &h2) const;
+
+    virtual void save_stat();
+
+    virtual u_int32_t bits_per_block() const;
+};
+
+bool test_bloom_filter();
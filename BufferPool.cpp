@@ -0,0 +1,306 @@
+/**
+ * @file BufferPool.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "BufferPool.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param file      the heap file whose blocks are cached (must outlive the pool)
+ * @param capacity  maximum number of frames
+ */
+BufferPool::BufferPool(HeapFile &file, uint capacity) : file(file), capacity(capacity), frames(), page_table(),
+                                                        clock_hand(0), hits(0), misses(0), writes(0) {
+    if (capacity == 0)
+        throw DbRelationError("buffer pool must have at least one frame");
+}
+
+/**
+ * Destructor - dirty pages are written back before the frames are freed.
+ */
+BufferPool::~BufferPool() {
+    clear();
+}
+
+/**
+ * Pin a block, reading it from the file on a miss.
+ * @param block_id  which block to get
+ * @return          the pinned page (release with unpin())
+ */
+SlottedPage *BufferPool::fetch(BlockID block_id) {
+    auto found = this->page_table.find(block_id);
+    if (found != this->page_table.end()) {
+        Frame &frame = this->frames[found->second];
+        frame.pin_count++;
+        frame.referenced = true;
+        this->hits++;
+        return frame.page;
+    }
+
+    this->misses++;
+    uint index = victim();
+    Frame &frame = this->frames[index];
+    bool stored = this->file.get(block_id, frame.data);
+    load(frame, block_id, !stored);  // a block that was allocated but never written is an empty page
+    this->page_table[block_id] = index;
+    return frame.page;
+}
+
+/**
+ * Allocate a new block at the end of the file and pin it. The page is initialized in its frame
+ * and reaches the file only when it is written back, so it costs a single write.
+ * @return  the pinned empty page (release with unpin())
+ */
+SlottedPage *BufferPool::fetch_new() {
+    uint index = victim();
+    Frame &frame = this->frames[index];
+    BlockID block_id = this->file.allocate();
+    load(frame, block_id, true);
+    this->page_table[block_id] = index;
+    return frame.page;
+}
+
+/**
+ * Allocate a given block and pin it, initialized in its frame like fetch_new()'s.
+ * @param block_id  the block (not in use)
+ * @return          the pinned empty page (release with unpin())
+ */
+SlottedPage *BufferPool::fetch_new(BlockID block_id) {
+    if (this->page_table.find(block_id) != this->page_table.end())
+        throw DbRelationError("block " + std::to_string(block_id) + " is already in use");
+    uint index = victim();
+    Frame &frame = this->frames[index];
+    this->file.allocate(block_id);
+    load(frame, block_id, true);
+    this->page_table[block_id] = index;
+    return frame.page;
+}
+
+/**
+ * Set up a frame's page, pinned once.
+ * @param frame     an empty frame whose data holds the block (unless is_new)
+ * @param block_id  the block in the frame
+ * @param is_new    true to initialize an empty page (which is dirty until written)
+ */
+void BufferPool::load(Frame &frame, BlockID block_id, bool is_new) {
+    if (is_new)
+        memset(frame.data, 0, this->file.get_block_size());
+    Dbt block(frame.data, this->file.get_block_size());
+    frame.page = new SlottedPage(block, block_id, is_new);
+    frame.pin_count = 1;
+    frame.dirty = is_new;
+    frame.referenced = true;
+}
+
+/**
+ * Release a pin on a page.
+ * @param page   page gotten from fetch() or fetch_new()
+ * @param dirty  true if the page was changed while pinned
+ */
+void BufferPool::unpin(SlottedPage *page, bool dirty) {
+    auto found = this->page_table.find(page->get_block_id());
+    if (found == this->page_table.end() || this->frames[found->second].pin_count == 0)
+        throw DbRelationError("unpin of a page that is not pinned");
+    Frame &frame = this->frames[found->second];
+    frame.dirty = frame.dirty || dirty;
+    frame.pin_count--;
+}
+
+/**
+ * Write all dirty pages back to the file.
+ */
+void BufferPool::flush() {
+    for (auto &frame: this->frames)
+        if (frame.page != nullptr)
+            write_back(frame);
+}
+
+/**
+ * Write back all dirty pages and release all the frames.
+ */
+void BufferPool::clear() {
+    flush();
+    discard();
+}
+
+/**
+ * Release all the frames without writing anything back.
+ */
+void BufferPool::discard() {
+    for (auto &frame: this->frames) {
+        delete frame.page;
+        delete[] frame.data;
+    }
+    this->frames.clear();
+    this->page_table.clear();
+    this->clock_hand = 0;
+}
+
+/**
+ * The ids of the cached blocks.
+ * @return  the block ids, sorted
+ */
+BlockIDs BufferPool::resident() const {
+    BlockIDs block_ids;
+    for (auto const &entry: this->page_table)
+        block_ids.push_back(entry.first);
+    sort(block_ids.begin(), block_ids.end());
+    return block_ids;
+}
+
+/**
+ * Find an empty frame, growing the pool if it is not yet at capacity, otherwise evicting
+ * an unpinned page chosen by the CLOCK policy.
+ * @return  index of the empty frame
+ * @throws  DbRelationError if every frame is pinned
+ */
+uint BufferPool::victim() {
+    if (this->frames.size() < this->capacity) {
+        Frame frame = {new char[this->file.get_block_size()], nullptr, 0, false, false};
+        this->frames.push_back(frame);
+        return (uint) this->frames.size() - 1;
+    }
+
+    // two sweeps are enough: the first clears every reference bit it passes
+    for (uint i = 0; i < 2 * this->capacity; i++) {
+        uint index = this->clock_hand;
+        this->clock_hand = (this->clock_hand + 1) % this->capacity;
+        Frame &frame = this->frames[index];
+        if (frame.page == nullptr)
+            return index;
+        if (frame.pin_count > 0)
+            continue;
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        evict(frame);
+        return index;
+    }
+    throw DbRelationError("buffer pool exhausted: all frames are pinned");
+}
+
+/**
+ * Write the frame's page to the file if it has been changed.
+ * @param frame  frame holding the page
+ */
+void BufferPool::write_back(Frame &frame) {
+    if (!frame.dirty)
+        return;
+    this->file.put(frame.page);
+    frame.dirty = false;
+    this->writes++;
+}
+
+/**
+ * Write back and remove the page from the frame, leaving the frame empty.
+ * @param frame  unpinned frame to empty
+ */
+void BufferPool::evict(Frame &frame) {
+    write_back(frame);
+    this->page_table.erase(frame.page->get_block_id());
+    delete frame.page;
+    frame.page = nullptr;
+}
+
+/**
+ * Testing function for BufferPool.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_buffer_pool() {
+    HeapFile file("_test_buffer_pool_cpp");
+    file.create();
+    BufferPool pool(file, 2);
+
+    // fill three pages through a two-frame pool so the first one must be written back on eviction
+    char rec[] = "hello";
+    Dbt rec_dbt(rec, sizeof(rec));
+    SlottedPage *page = pool.fetch(1);
+    page->add(&rec_dbt);
+    pool.unpin(page, true);
+    for (int i = 0; i < 2; i++) {
+        page = pool.fetch_new();
+        page->add(&rec_dbt);
+        pool.unpin(page, true);
+    }
+    if (pool.frames.size() != 2 || pool.page_table.find(1) != pool.page_table.end())
+        return assertion_failure("block 1 not evicted from full pool");
+
+    // miss reads back what eviction wrote, then a hit finds it in memory
+    page = pool.fetch(1);
+    Dbt *record = page->get(1);
+    bool same = record != nullptr && memcmp(record->get_data(), rec, sizeof(rec)) == 0;
+    delete record;
+    pool.unpin(page);
+    if (!same)
+        return assertion_failure("dirty page lost on eviction");
+    page = pool.fetch(1);
+    pool.unpin(page);
+    if (pool.get_hits() != 1 || pool.get_misses() != 2)
+        return assertion_failure("hit/miss counts", pool.get_hits(), pool.get_misses());
+
+    // with every frame pinned there is nothing to evict
+    SlottedPage *pinned1 = pool.fetch(1);
+    SlottedPage *pinned2 = pool.fetch(2);
+    try {
+        pool.fetch(3);
+        return assertion_failure("fetch with all frames pinned did not throw");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    pool.unpin(pinned1);
+    pool.unpin(pinned2);
+    try {
+        pool.unpin(pinned1);
+        return assertion_failure("unpin of unpinned page did not throw");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+
+    // reopening goes on from the last block handed out without counting blocks; if the file wasn't closed,
+    // from the end of the reserved extent, whose unwritten blocks are empty
+    pool.clear();
+    file.close();
+    file.open();
+    if (file.get_last_block_id() != 3)
+        return assertion_failure("last block after reopen", file.get_last_block_id());
+    HeapFile unclosed("_test_buffer_pool_cpp");
+    unclosed.open();
+    BlockID skipped = unclosed.get_last_block_id();
+    unclosed.close();
+    if (skipped != HeapFile::EXTENT_BLOCKS)
+        return assertion_failure("high-water mark after reopen of an unclosed file", skipped);
+    page = pool.fetch(HeapFile::EXTENT_BLOCKS);
+    RecordIDs *ids = page->ids();
+    bool empty = ids->empty();
+    delete ids;
+    pool.unpin(page);
+    if (!empty)
+        return assertion_failure("reserved block is not empty");
+    page = pool.fetch(3);
+    ids = page->ids();
+    same = ids->size() == 1;
+    delete ids;
+    pool.unpin(page);
+    if (!same)
+        return assertion_failure("block written back before close");
+
+    // a file from before the high-water mark was kept goes on from its highest block, past any never written
+    page = pool.fetch_new(HeapFile::EXTENT_BLOCKS + 5);
+    pool.unpin(page, true);
+    pool.clear();
+    file.close();
+    FreeSpaceMap("_test_buffer_pool_cpp").drop();
+    file.open();
+    BlockID highest = file.get_last_block_id();
+    if (highest != HeapFile::EXTENT_BLOCKS + 5)
+        return assertion_failure("last block of a file without a high-water mark", highest);
+
+    pool.discard();
+    file.drop();
+    return true;
+}
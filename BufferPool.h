@@ -0,0 +1,141 @@
+/**
+ * @file BufferPool.h - Buffer pool of pinned pages sitting in front of a HeapFile.
+ * BufferPool
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "SlottedPage.h"
+#include "HeapFile.h"
+
+/**
+ * @class BufferPool - fixed-size frame table caching the blocks of one HeapFile
+ *
+ * Pages are pinned with fetch() or fetch_new() and must be released with unpin(). A pinned
+ * page is never evicted. Frames are allocated lazily up to the pool's capacity; once the pool is
+ * full a victim is chosen with the CLOCK (second chance) policy among the unpinned frames.
+ * Dirty pages are written back to the HeapFile when their frame is evicted or on flush()
+ * (checkpoint), so a scan can read the blocks that aren't resident() straight from the file. Hit, miss
+ * and write counters are kept so the pool can be sized for a workload.
+ */
+class BufferPool {
+public:
+    /**
+     * number of frames in a pool unless told otherwise
+     */
+    static const uint DEFAULT_FRAMES = 64;
+
+    BufferPool(HeapFile &file, uint capacity = DEFAULT_FRAMES);
+
+    virtual ~BufferPool();
+
+    BufferPool(const BufferPool &other) = delete;
+
+    BufferPool(BufferPool &&temp) = delete;
+
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    BufferPool &operator=(BufferPool &&temp) = delete;
+
+    /**
+     * Pin a block of the file, reading it from the file only if it is not already in the pool.
+     * @param block_id  which block to get
+     * @returns         the pinned page (owned by the pool; release with unpin())
+     */
+    virtual SlottedPage *fetch(BlockID block_id);
+
+    /**
+     * Allocate a new block at the end of the file and pin it.
+     * @returns  the pinned, empty page (owned by the pool; release with unpin())
+     */
+    virtual SlottedPage *fetch_new();
+
+    /**
+     * Allocate a given block (see HeapFile::allocate(BlockID)) and pin it, empty.
+     * @param block_id  the block, which must not be in use
+     * @returns         the pinned, empty page (owned by the pool; release with unpin())
+     */
+    virtual SlottedPage *fetch_new(BlockID block_id);
+
+    /**
+     * Release one pin on a page gotten from fetch() or fetch_new().
+     * @param page   the page to release
+     * @param dirty  true if the caller changed the page
+     */
+    virtual void unpin(SlottedPage *page, bool dirty = false);
+
+    /**
+     * Checkpoint: write every dirty page back to the file. Pages stay cached.
+     */
+    virtual void flush();
+
+    /**
+     * Write back every dirty page and then forget all the cached pages (e.g., before closing the file).
+     */
+    virtual void clear();
+
+    /**
+     * Forget all the cached pages without writing anything back (e.g., before dropping the file).
+     */
+    virtual void discard();
+
+    /**
+     * The blocks cached in the pool, in order. Any other block is as it is in the file, since a page is
+     * written back before it leaves the pool.
+     * @returns  their block ids
+     */
+    virtual BlockIDs resident() const;
+
+    /**
+     * Number of fetch() calls answered from memory.
+     */
+    u_long get_hits() const { return hits; }
+
+    /**
+     * Number of fetch() calls that had to read the block from the file.
+     */
+    u_long get_misses() const { return misses; }
+
+    /**
+     * Number of pages written back to the file.
+     */
+    u_long get_writes() const { return writes; }
+
+    /**
+     * Maximum number of frames in the pool.
+     */
+    uint get_capacity() const { return capacity; }
+
+protected:
+    struct Frame {
+        char *data;
+        SlottedPage *page;  // nullptr if frame is empty
+        uint pin_count;
+        bool dirty;
+        bool referenced;
+    };
+
+    HeapFile &file;
+    uint capacity;
+    std::vector<Frame> frames;
+    std::unordered_map<BlockID, uint> page_table;  // block id -> index into frames
+    uint clock_hand;
+    u_long hits;
+    u_long misses;
+    u_long writes;
+
+    virtual uint victim();
+
+    virtual void write_back(Frame &frame);
+
+    virtual void evict(Frame &frame);
+
+    virtual void load(Frame &frame, BlockID block_id, bool is_new);
+
+    friend bool test_buffer_pool();
+};
+
+bool test_buffer_pool();
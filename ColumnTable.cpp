@@ -0,0 +1,879 @@
+/**
+ * @file ColumnTable.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "ColumnTable.h"
+
+using namespace std;
+
+/*
+ * ********************************
+ * SegmentFile class implementation
+ * ********************************
+ */
+
+/**
+ * Constructor
+ * @param name          name of the file (without the .db)
+ * @param segment_size  size of the segments if the file gets created
+ */
+SegmentFile::SegmentFile(string name, u_int32_t segment_size) : dbfilename(name + ".db"), segment_size(segment_size),
+                                                                 closed(true), db(_DB_ENV, 0), reads(0) {
+}
+
+/**
+ * Create the physical file.
+ */
+void SegmentFile::create() {
+    db_open(DB_CREATE | DB_EXCL);
+}
+
+/**
+ * Delete the physical file.
+ */
+void SegmentFile::drop() {
+    close();
+    Db db(_DB_ENV, 0);
+    db.remove(this->dbfilename.c_str(), nullptr, 0);
+}
+
+/**
+ * Open the physical file.
+ */
+void SegmentFile::open() {
+    db_open();
+}
+
+/**
+ * Close the physical file.
+ */
+void SegmentFile::close() {
+    if (this->closed)
+        return;
+    this->db.close(0);
+    this->closed = true;
+}
+
+/**
+ * Read a segment into memory the caller owns.
+ * @param segment_id  the segment
+ * @param buffer      where to put it
+ * @return            false if the segment has never been written (buffer is left alone)
+ */
+bool SegmentFile::get(BlockID segment_id, void *buffer) {
+    Dbt key(&segment_id, sizeof(segment_id));
+    Dbt data(buffer, this->segment_size);
+    data.set_ulen(this->segment_size);
+    data.set_flags(DB_DBT_USERMEM);
+    this->reads++;
+    return this->db.get(nullptr, &key, &data, 0) == 0;
+}
+
+/**
+ * Write a segment.
+ * @param segment_id  the segment
+ * @param buffer      its bytes
+ */
+void SegmentFile::put(BlockID segment_id, const void *buffer) {
+    Dbt key(&segment_id, sizeof(segment_id));
+    Dbt data((void *) buffer, this->segment_size);
+    this->db.put(nullptr, &key, &data, 0);
+}
+
+/**
+ * Ask BerkDb how many segments are in the file.
+ * @return number of segments
+ */
+u_int32_t SegmentFile::get_segment_count() {
+    DB_BTREE_STAT *stat;
+    this->db.stat(nullptr, &stat, DB_FAST_STAT);
+    u_int32_t bt_ndata = stat->bt_ndata;
+    free(stat);
+    return bt_ndata;
+}
+
+/**
+ * Wrapper for Berkeley DB open, which does both open and creation.
+ * @param flags BerkDb flags
+ */
+void SegmentFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    this->db.set_re_len(this->segment_size); // record length - will be ignored if file already exists
+    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    this->db.get_re_len(&this->segment_size);
+    this->closed = false;
+}
+
+
+/*
+ * ********************************
+ * ColumnTable class implementation
+ * ********************************
+ */
+
+/**
+ * Constructor
+ * @param table_name
+ * @param column_names
+ * @param column_attributes
+ * @param segment_size       size of each column's segments (the table's page size)
+ */
+ColumnTable::ColumnTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                         uint segment_size)
+        : DbRelation(table_name, column_names, column_attributes), segment_size(segment_size), column_types(),
+          files(), group_file(table_name + ".rows", GROUP_MAP_SZ), group_maps(), dirty_groups(), last_group(0),
+          last_group_dirty(false), last_segments(), segments(), loaded(), closed(true) {
+    if (segment_size < DbBlock::BLOCK_SZ || segment_size > DbBlock::MAX_BLOCK_SZ ||
+        (segment_size & (segment_size - 1)) != 0)
+        throw DbRelationError("unsupported segment size " + to_string(segment_size));
+    for (uint ordinal = 0; ordinal < this->column_names.size(); ordinal++) {
+        this->column_types.push_back(this->column_attributes[ordinal].get_data_type());
+        this->files.push_back(new SegmentFile(table_name + "." + this->column_names[ordinal] + ".col", segment_size));
+    }
+    this->last_segments.resize(this->files.size());
+    this->segments.resize(this->files.size());
+    this->loaded.assign(this->files.size(), 0);
+}
+
+ColumnTable::~ColumnTable() {
+    for (auto file: this->files)
+        delete file;
+}
+
+/**
+ * Execute: CREATE TABLE <table_name> ( <columns> )
+ * Is not responsible for metadata storage or validation.
+ */
+void ColumnTable::create() {
+    for (auto file: this->files)
+        file->create();
+    this->group_file.create();
+    this->segment_size = this->files.empty() ? this->segment_size : this->files.front()->get_segment_size();
+    this->group_maps.clear();
+    this->dirty_groups.clear();
+    this->last_group = 0;
+    this->last_group_dirty = false;
+    this->loaded.assign(this->files.size(), 0);
+    this->closed = false;
+}
+
+/**
+ * Execute: CREATE TABLE IF NOT EXISTS <table_name> ( <columns> )
+ * Is not responsible for metadata storage or validation.
+ */
+void ColumnTable::create_if_not_exists() {
+    try {
+        open();
+    } catch (DbException &e) {
+        for (auto file: this->files)
+            file->close();
+        this->group_file.close();
+        create();
+    }
+}
+
+/**
+ * Execute: DROP TABLE <table_name>
+ */
+void ColumnTable::drop() {
+    this->last_group_dirty = false;  // no point in writing it
+    this->dirty_groups.assign(this->dirty_groups.size(), false);
+    close();
+    for (auto file: this->files)
+        file->drop();
+    this->group_file.drop();
+}
+
+/**
+ * Open existing table: the group maps are read in, as is the last group, which inserts go on filling.
+ */
+void ColumnTable::open() {
+    if (!this->closed)
+        return;
+    for (auto file: this->files)
+        file->open();
+    this->group_file.open();
+    this->closed = false;
+    if (!this->files.empty())
+        this->segment_size = this->files.front()->get_segment_size();
+
+    u_int32_t groups = this->group_file.get_segment_count();
+    this->group_maps.assign(groups * GROUP_MAP_SZ, 0);
+    this->dirty_groups.assign(groups, false);
+    for (BlockID group_id = 1; group_id <= groups; group_id++)
+        this->group_file.get(group_id, &this->group_maps[(group_id - 1) * GROUP_MAP_SZ]);
+    this->last_group = groups;
+    this->last_group_dirty = false;
+    this->loaded.assign(this->files.size(), 0);
+    for (uint ordinal = 0; ordinal < this->files.size() && groups > 0; ordinal++) {
+        this->last_segments[ordinal].assign(this->segment_size, 0);
+        this->files[ordinal]->get(groups, this->last_segments[ordinal].data());
+    }
+}
+
+/**
+ * Closes the table, writing back the last group and the changed group maps.
+ */
+void ColumnTable::close() {
+    if (this->closed)
+        return;
+    flush();
+    for (auto file: this->files)
+        file->close();
+    this->group_file.close();
+    this->closed = true;
+}
+
+/**
+ * Write back the last group's segments (if they changed) and the group maps that changed.
+ */
+void ColumnTable::flush() {
+    if (this->last_group_dirty) {
+        for (uint ordinal = 0; ordinal < this->files.size(); ordinal++)
+            this->files[ordinal]->put(this->last_group, this->last_segments[ordinal].data());
+        this->last_group_dirty = false;
+    }
+    for (BlockID group_id = 1; group_id <= this->dirty_groups.size(); group_id++) {
+        if (this->dirty_groups[group_id - 1]) {
+            this->group_file.put(group_id, &this->group_maps[(group_id - 1) * GROUP_MAP_SZ]);
+            this->dirty_groups[group_id - 1] = false;
+        }
+    }
+}
+
+/**
+ * Expect row to be a dictionary with column name keys.
+ * @param row  the new row
+ * @return     the handle of the new row
+ */
+Handle ColumnTable::insert(const ValueDict *row) {
+    Row full_row(&this->column_names);
+    if (!full_row.from_dict(row))
+        throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
+    return insert(&full_row);
+}
+
+/**
+ * Append a row to the last row group, starting a new group if it doesn't fit.
+ * @param row  the new row, in column order
+ * @return     the handle of the new row
+ * @throws DbRelationError if a value has the wrong type or the row doesn't fit even in an empty group
+ */
+Handle ColumnTable::insert(const Row *row) {
+    open();
+    for (uint ordinal = 0; ordinal < this->column_types.size(); ordinal++)
+        if ((*row)[ordinal].data_type != this->column_types[ordinal])
+            throw DbRelationError("wrong type for column '" + this->column_names[ordinal] + "'");
+    if (!this->indices.empty())
+        index_check(Rows(1, *row));
+    if (this->last_group == 0 || !fits(row)) {
+        start_group();
+        if (!fits(row))
+            throw DbRelationError("row too big for a segment of table '" + this->table_name + "'");
+    }
+    u_int16_t &rows = group_rows(this->last_group);
+    for (uint ordinal = 0; ordinal < this->column_types.size(); ordinal++) {
+        const Value &value = (*row)[ordinal];
+        if (this->column_types[ordinal] == ColumnAttribute::INT) {
+            ((int32_t *) this->last_segments[ordinal].data())[rows] = value.n;
+        } else {
+            Dbt segment_dbt(this->last_segments[ordinal].data(), this->segment_size);
+            SlottedPage segment(segment_dbt, this->last_group);
+            Dbt data((void *) value.s.data(), (u_int32_t) value.s.length());
+            segment.add(&data);
+        }
+    }
+    rows++;
+    this->dirty_groups[this->last_group - 1] = true;
+    this->last_group_dirty = true;
+    Handle handle(this->last_group, rows);
+    try {
+        index_insert(handle);
+    } catch (...) {
+        erase(handle);
+        throw;
+    }
+    return handle;
+}
+
+/**
+ * Change some of a row's values, in place in its segments, along with the indices whose keys change.
+ * @param handle      the row to update
+ * @param new_values  a dictionary with column name keys
+ * @throws DbRelationError if there is no such row or column, or a value doesn't fit
+ */
+void ColumnTable::update(const Handle handle, const ValueDict *new_values) {
+    check(handle);
+    bool reindex = index_update(handle, new_values);
+    try {
+        rewrite(handle, new_values);
+    } catch (...) {
+        if (reindex)
+            index_insert(handle, new_values);
+        throw;
+    }
+    if (reindex)
+        index_insert(handle, new_values);
+}
+
+/**
+ * Change some of a row's values, in place in its segments. Nothing is changed if a new TEXT value
+ * won't fit in its segment.
+ * @param handle      the row to update (which exists)
+ * @param new_values  a dictionary with column name keys
+ * @throws DbRelationError if there is no such column, or a value doesn't fit
+ */
+void ColumnTable::rewrite(const Handle handle, const ValueDict *new_values) {
+    vector<pair<uint, const Value *>> changes;
+    for (auto const &new_value: *new_values) {
+        int ordinal = Row::index(this->column_names, new_value.first);
+        if (ordinal < 0)
+            throw DbRelationError("table does not have column named '" + new_value.first + "'");
+        if (new_value.second.data_type != this->column_types[ordinal])
+            throw DbRelationError("wrong type for column '" + new_value.first + "'");
+        if (this->column_types[ordinal] == ColumnAttribute::TEXT) {
+            Dbt segment_dbt(segment(ordinal, handle.first), this->segment_size);
+            SlottedPage page(segment_dbt, handle.first);
+            RecordView data;
+            page.view(handle.second, data);
+            if (new_value.second.s.length() > SlottedPage::MAX_RECORD_SZ ||
+                new_value.second.s.length() > data.size + page.free_space())
+                throw DbRelationError("new value for '" + new_value.first + "' does not fit in its segment");
+        }
+        changes.push_back(make_pair((uint) ordinal, &new_value.second));
+    }
+    for (auto const &change: changes) {
+        char *bytes = segment(change.first, handle.first);
+        if (this->column_types[change.first] == ColumnAttribute::INT) {
+            ((int32_t *) bytes)[handle.second - 1] = change.second->n;
+        } else {
+            Dbt segment_dbt(bytes, this->segment_size);
+            SlottedPage page(segment_dbt, handle.first);
+            Dbt data((void *) change.second->s.data(), (u_int32_t) change.second->s.length());
+            page.put(handle.second, data);
+        }
+        put_segment(change.first, handle.first);
+    }
+}
+
+/**
+ * Delete a row: it is marked in its group's bitmap (its values stay in the segments).
+ * @param handle  the row to delete
+ */
+void ColumnTable::del(const Handle handle) {
+    check(handle);
+    index_del(handle);
+    erase(handle);
+}
+
+/**
+ * Mark a row deleted (the indices are the caller's to take care of).
+ * @param handle  the row
+ */
+void ColumnTable::erase(const Handle handle) {
+    uint position = handle.second - 1;
+    this->group_maps[(handle.first - 1) * GROUP_MAP_SZ + 4 + position / 8] |= (u_char) (1 << (position % 8));
+    this->dirty_groups[handle.first - 1] = true;
+}
+
+/**
+ * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE 1
+ * Only the group maps are looked at.
+ * @return a pointer to a list of handles for qualifying rows (freed by caller)
+ */
+Handles *ColumnTable::select() {
+    open();
+    Handles *handles = new Handles();
+    for (BlockID group_id = 1; group_id <= this->last_group; group_id++)
+        for (uint position = 0; position < group_rows(group_id); position++)
+            if (!is_deleted(group_id, position))
+                handles->push_back(Handle(group_id, (RecordID) (position + 1)));
+    return handles;
+}
+
+/**
+ * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+ * @param where  equality conditions the rows must meet
+ * @return       list of handles of the selected rows
+ */
+Handles *ColumnTable::select(const ValueDict *where) {
+    return select(Predicate(where, this->column_names, this->column_attributes));
+}
+
+/**
+ * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+ * Just the rows an attached index finds are checked, if one narrows the where clause down (from the index's
+ * own entries, if it has every column the where clause reads). Otherwise
+ * reads only the columns the where clause uses and evaluates it a row group at a time.
+ * @param where  where clause the rows must meet
+ * @return       list of handles of the selected rows
+ */
+Handles *ColumnTable::select(const Predicate &where) {
+    if (where.is_true())
+        return select();
+    open();
+    vector<bool> used(this->column_names.size(), false);
+    where.uses(used);
+    Rows rows;
+    Handles *candidates = index_select(where, &used, &rows);
+    if (candidates != nullptr) {
+        try {
+            Row row(&this->column_names);
+            auto kept = candidates->begin();
+            for (uint i = 0; i < candidates->size(); i++) {
+                Handle handle = (*candidates)[i];
+                if (rows.size() != candidates->size()) {
+                    ValueDict *values = project(handle);
+                    row.from_dict(values);
+                    delete values;
+                }
+                if (where.evaluate(rows.size() == candidates->size() ? rows[i] : row))
+                    *kept++ = handle;
+            }
+            candidates->erase(kept, candidates->end());
+        } catch (...) {
+            delete candidates;
+            throw;
+        }
+        return candidates;
+    }
+    vector<uint> ordinals;
+    vector<ColumnVector> columns;
+    for (uint ordinal = 0; ordinal < used.size(); ordinal++) {
+        columns.push_back(ColumnVector(this->column_types[ordinal]));
+        if (used[ordinal])
+            ordinals.push_back(ordinal);
+    }
+    Handles *handles = new Handles();
+    Selection selection;
+    for (BlockID group_id = 1; group_id <= this->last_group; group_id++) {
+        uint size = load(group_id, ordinals, columns);
+        where.evaluate(columns, size, selection);
+        live(group_id, selection);
+        for (u_int16_t i: selection)
+            handles->push_back(Handle(group_id, (RecordID) (i + 1)));
+    }
+    return handles;
+}
+
+/**
+ * Project all columns from a given row.
+ * @param handle  row to be projected
+ * @return        a sequence of all values for handle
+ */
+ValueDict *ColumnTable::project(Handle handle) {
+    return project(handle, &this->column_names);
+}
+
+/**
+ * Project given columns from a given row, reading just their segments.
+ * @param handle        row to be projected
+ * @param column_names  of columns to be included in the result (all of them if empty)
+ * @return              a sequence of values for handle given by column_names
+ */
+ValueDict *ColumnTable::project(Handle handle, const ColumnNames *column_names) {
+    check(handle);
+    if (column_names->empty())
+        column_names = &this->column_names;
+    ValueDict *result = new ValueDict();
+    for (auto const &column_name: *column_names) {
+        int ordinal = Row::index(this->column_names, column_name);
+        if (ordinal < 0) {
+            delete result;
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        }
+        char *bytes = segment(ordinal, handle.first);
+        if (this->column_types[ordinal] == ColumnAttribute::INT) {
+            (*result)[column_name] = Value(((int32_t *) bytes)[handle.second - 1]);
+        } else {
+            Dbt segment_dbt(bytes, this->segment_size);
+            SlottedPage page(segment_dbt, handle.first);
+            RecordView data;
+            page.view(handle.second, data);
+            (*result)[column_name] = Value(string(data.data, data.size));
+        }
+    }
+    return result;
+}
+
+/**
+ * Vectorized scan of the table, or an index-only scan if an attached index that narrows the where clause
+ * down has every column the scan reads (see DbRelation::index_scan).
+ * @param column_names  columns to project (all of them if empty)
+ * @param where         where clause the rows must meet
+ * @return              the scan (freed by caller)
+ */
+DbRelationScan *ColumnTable::scan(const ColumnNames *column_names, const Predicate &where) {
+    open();
+    DbRelationScan *index_only = index_scan(column_names, where);
+    if (index_only != nullptr)
+        return index_only;
+    return new ColumnTableScan(*this, column_names, where);
+}
+
+/**
+ * Number of segments of a column read from its file.
+ * @param column_name  the column
+ * @return             segments read since the table was constructed
+ */
+u_long ColumnTable::get_segment_reads(const Identifier &column_name) const {
+    int ordinal = Row::index(this->column_names, column_name);
+    if (ordinal < 0)
+        throw DbRelationError("table does not have column named '" + column_name + "'");
+    return this->files[ordinal]->get_reads();
+}
+
+/**
+ * Get a column's segment for a row group: the last group's is in memory, and the most recently read
+ * other segment of each column is kept, so consecutive rows of a group cost one read.
+ * @param ordinal   the column
+ * @param group_id  the row group
+ * @return          the segment's bytes (valid until the next call for the same column)
+ */
+char *ColumnTable::segment(uint ordinal, BlockID group_id) {
+    if (group_id == this->last_group)
+        return this->last_segments[ordinal].data();
+    vector<char> &bytes = this->segments[ordinal];
+    if (this->loaded[ordinal] != group_id) {
+        bytes.resize(this->segment_size);
+        this->loaded[ordinal] = 0;
+        if (!this->files[ordinal]->get(group_id, bytes.data()))
+            throw DbRelationError("missing segment " + to_string(group_id) + " of column '" +
+                                  this->column_names[ordinal] + "'");
+        this->loaded[ordinal] = group_id;
+    }
+    return bytes.data();
+}
+
+/**
+ * Write back a column's segment for a row group after it was changed through segment().
+ * The last group's segments are written when the group is closed (or the table is flushed).
+ * @param ordinal   the column
+ * @param group_id  the row group
+ */
+void ColumnTable::put_segment(uint ordinal, BlockID group_id) {
+    if (group_id == this->last_group)
+        this->last_group_dirty = true;
+    else
+        this->files[ordinal]->put(group_id, this->segments[ordinal].data());
+}
+
+/**
+ * Close the last row group (writing it back) and start a new, empty one.
+ */
+void ColumnTable::start_group() {
+    flush();
+    this->last_group++;
+    this->group_maps.resize(this->last_group * GROUP_MAP_SZ, 0);
+    this->dirty_groups.push_back(true);
+    for (uint ordinal = 0; ordinal < this->files.size(); ordinal++) {
+        this->last_segments[ordinal].assign(this->segment_size, 0);
+        if (this->column_types[ordinal] == ColumnAttribute::TEXT) {
+            Dbt segment_dbt(this->last_segments[ordinal].data(), this->segment_size);
+            SlottedPage segment(segment_dbt, this->last_group, true);
+        }
+    }
+    this->last_group_dirty = true;
+}
+
+/**
+ * Check if a row fits in the last row group. Every value is checked before any segment is touched.
+ * @param row  the row
+ * @return     true if the group has fewer than GROUP_ROWS rows and room for each of its TEXT values
+ *             (with 1/UPDATE_SLACK of each TEXT segment still to spare)
+ * @throws DbRelationError if a TEXT value is too long to be a record in any segment
+ */
+bool ColumnTable::fits(const Row *row) {
+    for (uint ordinal = 0; ordinal < this->column_types.size(); ordinal++)
+        if (this->column_types[ordinal] == ColumnAttribute::TEXT &&
+            (*row)[ordinal].s.length() > SlottedPage::MAX_RECORD_SZ)
+            throw DbRelationError("value for '" + this->column_names[ordinal] + "' too long for a segment of table '" +
+                                  this->table_name + "'");
+    if (group_rows(this->last_group) >= GROUP_ROWS)
+        return false;
+    for (uint ordinal = 0; ordinal < this->column_types.size(); ordinal++) {
+        if (this->column_types[ordinal] == ColumnAttribute::TEXT) {
+            Dbt segment_dbt(this->last_segments[ordinal].data(), this->segment_size);
+            SlottedPage segment(segment_dbt, this->last_group);
+            // the value plus its record header, leaving the slack for updates
+            if ((*row)[ordinal].s.length() + 4 + this->segment_size / UPDATE_SLACK > segment.free_space())
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Number of rows in a row group (including deleted ones).
+ * @param group_id  the row group
+ * @return          a reference to the count in the group's map
+ */
+u_int16_t &ColumnTable::group_rows(BlockID group_id) {
+    return *(u_int16_t *) &this->group_maps[(group_id - 1) * GROUP_MAP_SZ];
+}
+
+/**
+ * Check a row group's bitmap of deleted rows.
+ * @param group_id  the row group
+ * @param position  the row's position in the group (from 0)
+ * @return          true if the row has been deleted
+ */
+bool ColumnTable::is_deleted(BlockID group_id, uint position) const {
+    return (this->group_maps[(group_id - 1) * GROUP_MAP_SZ + 4 + position / 8] >> (position % 8)) & 1;
+}
+
+/**
+ * Make sure a handle is to a row in the table (opening the table if need be).
+ * @param handle  the row
+ * @throws DbRelationError if there is no such row
+ */
+void ColumnTable::check(Handle handle) {
+    open();
+    if (handle.first == 0 || handle.first > this->last_group || handle.second == 0 ||
+        handle.second > group_rows(handle.first) ||
+        is_deleted(handle.first, handle.second - 1u))
+        throw DbRelationError("no such row in table '" + this->table_name + "'");
+}
+
+/**
+ * Read the given columns of a row group into column vectors. An INT segment is copied as is.
+ * @param group_id  the row group
+ * @param ordinals  the columns to read
+ * @param columns   the vectors, by column ordinal
+ * @return          number of rows in the group (deleted ones included)
+ */
+uint ColumnTable::load(BlockID group_id, const vector<uint> &ordinals, vector<ColumnVector> &columns) {
+    uint size = group_rows(group_id);
+    for (uint ordinal: ordinals) {
+        ColumnVector &column = columns[ordinal];
+        column.clear();
+        char *bytes = segment(ordinal, group_id);
+        if (column.data_type == ColumnAttribute::INT) {
+            column.ints.assign((const int32_t *) bytes, (const int32_t *) bytes + size);
+        } else {
+            Dbt segment_dbt(bytes, this->segment_size);
+            SlottedPage page(segment_dbt, group_id);
+            RecordView data;
+            ValueView value;
+            value.data_type = ColumnAttribute::TEXT;
+            for (uint position = 1; position <= size; position++) {
+                page.view((RecordID) position, data);
+                value.s = data.data;
+                value.length = (u_int16_t) data.size;
+                column.append(value);
+            }
+        }
+    }
+    return size;
+}
+
+/**
+ * Drop the deleted rows from a selection of a row group's rows.
+ * @param group_id   the row group
+ * @param selection  positions (from 0) of rows in the group
+ */
+void ColumnTable::live(BlockID group_id, Selection &selection) const {
+    const u_char *deleted = &this->group_maps[(group_id - 1) * GROUP_MAP_SZ + 4];
+    size_t kept = 0;
+    for (u_int16_t i: selection)
+        if (!((deleted[i / 8] >> (i % 8)) & 1))
+            selection[kept++] = i;
+    selection.resize(kept);
+}
+
+
+/*
+ * ************************************
+ * ColumnTableScan class implementation
+ * ************************************
+ */
+
+/**
+ * Start a vectorized scan of an open table.
+ * @param table         the table to scan
+ * @param column_names  columns to project (all of them if empty)
+ * @param where         where clause the rows must meet
+ * @throws DbRelationError if the table has no such column
+ */
+ColumnTableScan::ColumnTableScan(ColumnTable &table, const ColumnNames *column_names, const Predicate &where)
+        : table(table), column_names(*column_names), ordinals(), decoded(), where(where), next_group(1), columns(),
+          selection() {
+    if (this->column_names.empty())
+        this->column_names = table.column_names;
+    vector<bool> used(table.column_names.size(), false);
+    for (auto const &column_name: this->column_names) {
+        int ordinal = Row::index(table.column_names, column_name);
+        if (ordinal < 0)
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        this->ordinals.push_back((uint) ordinal);
+        used[ordinal] = true;
+    }
+    where.uses(used);
+    for (uint ordinal = 0; ordinal < used.size(); ordinal++) {
+        this->columns.push_back(ColumnVector(table.column_types[ordinal]));
+        if (used[ordinal])
+            this->decoded.push_back(ordinal);
+    }
+    this->selection.reserve(Batch::CAPACITY);
+}
+
+/**
+ * Get the live rows of the next row group that has any that qualify.
+ * @param batch  refilled with the projected columns of the rows
+ * @return       false when the table is exhausted
+ */
+bool ColumnTableScan::next(Batch &batch) {
+    if (batch.column_names != this->column_names) {
+        batch.column_names = this->column_names;
+        batch.columns.clear();
+        for (uint ordinal: this->ordinals)
+            batch.columns.push_back(ColumnVector(this->table.column_types[ordinal]));
+    }
+    batch.clear();
+    while (this->next_group <= this->table.last_group) {
+        BlockID group_id = this->next_group++;
+        uint size = this->table.load(group_id, this->decoded, this->columns);
+        this->where.evaluate(this->columns, size, this->selection);
+        this->table.live(group_id, this->selection);
+        if (this->selection.empty())
+            continue;
+        for (uint j = 0; j < this->ordinals.size(); j++)
+            batch.columns[j].gather(this->columns[this->ordinals[j]], this->selection);
+        for (u_int16_t i: this->selection)
+            batch.handles.push_back(Handle(group_id, (RecordID) (i + 1)));
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Testing function for ColumnTable.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_column_table() {
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT)};
+    string texts[] = {"", "x", "Four score and seven years ago"};
+    Handles handles;
+    {
+        ColumnTable table("_test_column_table_cpp", column_names, column_attributes);
+        table.create();
+        ValueDict row;
+        for (int i = 0; i < 3000; i++) {
+            row["a"] = Value(i);
+            row["b"] = Value(texts[i % 3]);
+            row["c"] = Value(i % 10);
+            handles.push_back(table.insert(&row));
+        }
+        if (handles.front() != Handle(1, 1) || handles.back().first < 3)
+            return assertion_failure("row groups", handles.back().first, handles.back().second);
+        table.close();
+    }
+
+    ColumnTable table("_test_column_table_cpp", column_names, column_attributes);
+    ValueDict *result = table.project(handles[1501]);
+    bool ok = (*result)["a"].n == 1501 && (*result)["b"].s == texts[1501 % 3] && (*result)["c"].n == 1;
+    delete result;
+    if (!ok)
+        return assertion_failure("project after reopening");
+
+    // a query touches only the columns it uses
+    u_long a_reads = table.get_segment_reads("a"), b_reads = table.get_segment_reads("b");
+    ValueDict where;
+    where["c"] = Value(7);
+    Handles *selected = table.select(&where);
+    ok = selected->size() == 300 && selected->front() == handles[7];
+    delete selected;
+    if (!ok || table.get_segment_reads("a") != a_reads || table.get_segment_reads("b") != b_reads)
+        return assertion_failure("select where");
+    ColumnNames a_only = {"a"};
+    Predicate c_is_7(&where, column_names, column_attributes);
+    DbRelationScan *scan = table.scan(&a_only, c_is_7);
+    Batch batch;
+    int next_a = 7;
+    while (scan->next(batch))
+        for (uint i = 0; ok && i < batch.size(); i++, next_a += 10)
+            ok = batch.columns.size() == 1 && batch.columns[0].ints[i] == next_a;
+    delete scan;
+    if (!ok || next_a != 3007 || table.get_segment_reads("b") != b_reads)
+        return assertion_failure("scan", next_a);
+
+    // updates in place and deletes by bitmap, with stable handles
+    ValueDict new_values;
+    new_values["b"] = Value(string("changed"));
+    new_values["c"] = Value(-1);
+    table.update(handles[7], &new_values);
+    table.update(handles[2999], &new_values);
+    table.del(handles[17]);
+    selected = table.select(&where);
+    ok = selected->size() == 298 && selected->front() == handles[27];
+    delete selected;
+    result = table.project(handles[2999]);
+    ok = ok && (*result)["b"].s == "changed" && (*result)["c"].n == -1 && (*result)["a"].n == 2999;
+    delete result;
+    new_values["b"] = Value(string(DbBlock::BLOCK_SZ, 'X'));
+    try {
+        table.update(handles[8], &new_values);
+        ok = false;
+    } catch (DbRelationError &e) {
+        result = table.project(handles[8]);
+        ok = ok && (*result)["c"].n == 8;  // unchanged
+        delete result;
+    }
+    try {
+        table.project(handles[17]);
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    table.close();
+    selected = table.select();
+    ok = ok && selected->size() == 2999;
+    delete selected;
+    table.drop();
+    if (!ok)
+        return assertion_failure("update and delete");
+
+    // a value too long to be a record is refused before any of the row goes into its group
+    ColumnNames wide_names = {"a", "b", "d"};
+    ColumnAttributes wide_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                        ColumnAttribute(ColumnAttribute::TEXT)};
+    ColumnTable wide("_test_column_table_cpp", wide_names, wide_attributes, DbBlock::MAX_BLOCK_SZ);
+    wide.create();
+    ValueDict row;
+    row["a"] = Value(1);
+    row["b"] = Value(string("x"));
+    row["d"] = Value(string("x"));
+    Handle first = wide.insert(&row);
+    row["d"] = Value(string(SlottedPage::MAX_RECORD_SZ + 1, 'X'));
+    try {
+        wide.insert(&row);
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    try {
+        wide.update(first, &row);
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    row["a"] = Value(2);
+    row["b"] = Value(string("y"));
+    row["d"] = Value(string("y"));
+    Handle second = wide.insert(&row);
+    result = wide.project(first);
+    ok = ok && second == Handle(1, 2) && (*result)["a"].n == 1 && (*result)["d"].s == "x";
+    delete result;
+    result = wide.project(second);
+    ok = ok && (*result)["a"].n == 2 && (*result)["b"].s == "y" && (*result)["d"].s == "y";
+    delete result;
+    wide.drop();
+    if (!ok)
+        return assertion_failure("value too long for a segment");
+    return true;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file ColumnTable.h - Column-oriented implementation of storage_engine.
+ * SegmentFile
+ * ColumnTable: DbRelation
+ * ColumnTableScan: DbRelationScan
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+#include "SlottedPage.h"
+#include "Predicate.h"
+
+/**
+ * @class SegmentFile - a Berkeley DB RecNo file of fixed-size segments, each read and written whole
+ */
+class SegmentFile {
+public:
+    SegmentFile(std::string name, u_int32_t segment_size);
+
+    virtual ~SegmentFile() {}
+
+    SegmentFile(const SegmentFile &other) = delete;
+
+    SegmentFile(SegmentFile &&temp) = delete;
+
+    SegmentFile &operator=(const SegmentFile &other) = delete;
+
+    SegmentFile &operator=(SegmentFile &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    /**
+     * Read a segment.
+     * @param segment_id  which segment (numbered from 1)
+     * @param buffer      where to put it (get_segment_size() bytes)
+     * @returns           false if the segment has never been written
+     */
+    virtual bool get(BlockID segment_id, void *buffer);
+
+    /**
+     * Write a segment.
+     * @param segment_id  which segment (numbered from 1)
+     * @param buffer      its bytes (get_segment_size() of them)
+     */
+    virtual void put(BlockID segment_id, const void *buffer);
+
+    /**
+     * Ask Berkeley DB how many segments have been written.
+     * @returns  number of segments
+     */
+    virtual u_int32_t get_segment_count();
+
+    /**
+     * Get the size of the segments. Once the file is open, this is the size it was created with.
+     * @returns  segment size in bytes
+     */
+    virtual u_int32_t get_segment_size() const { return segment_size; }
+
+    /**
+     * Number of segments read from the file since it was constructed.
+     */
+    virtual u_long get_reads() const { return reads; }
+
+protected:
+    std::string dbfilename;
+    u_int32_t segment_size;
+    bool closed;
+    Db db;
+    u_long reads;
+
+    virtual void db_open(uint flags = 0);
+};
+
+
+/**
+ * @class ColumnTable - Column storage engine (implementation of DbRelation)
+ *
+ * Each column is kept in a file of its own (<table>.<column>.col.db) so that a query reads only the
+ * columns it uses. The rows are split into row groups of up to GROUP_ROWS rows, and row group g is
+ * segment g of every column file. An INT segment is a plain int32_t array; a TEXT segment is a
+ * SlottedPage with the values as its records, in row order. A group is closed when it has GROUP_ROWS
+ * rows or one of its TEXT segments is full, so the segments are fixed-size blocks (the table's page size).
+ *
+ * A handle is (row group, position in the group, from 1). Deleting a row only marks it in the group's
+ * bitmap of deleted rows, and updates rewrite values in place, so handles are stable (a TEXT segment is
+ * only filled to within 1/UPDATE_SLACK of full, which is all a group's updates can grow into). The groups' row
+ * counts and bitmaps are kept in memory and in one more file (<table>.rows.db), like a FreeSpaceMap.
+ * The last group is filled in memory and written back when it is closed, when the table is closed,
+ * and before anything reads the files directly. Other segments are written through as they change.
+ */
+class ColumnTable : public DbRelation {
+public:
+    /**
+     * most rows in a row group (one Batch's worth)
+     */
+    static const uint GROUP_ROWS = Batch::CAPACITY;
+
+    ColumnTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                uint segment_size = DbBlock::BLOCK_SZ);
+
+    virtual ~ColumnTable();
+
+    ColumnTable(const ColumnTable &other) = delete;
+
+    ColumnTable(ColumnTable &&temp) = delete;
+
+    ColumnTable &operator=(const ColumnTable &other) = delete;
+
+    ColumnTable &operator=(ColumnTable &&temp) = delete;
+
+    virtual void create();
+
+    virtual void create_if_not_exists();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handle insert(const ValueDict *row);
+
+    /**
+     * Insert a row that already has a value for every column, in column order.
+     * @param row  the new row (its schema must be this table's columns)
+     * @returns    a handle to the new row
+     */
+    virtual Handle insert(const Row *row);
+
+    virtual void update(const Handle handle, const ValueDict *new_values);
+
+    virtual void del(const Handle handle);
+
+    virtual Handles *select();
+
+    virtual Handles *select(const ValueDict *where);
+
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+     * @param where  compiled where clause (see Predicate)
+     * @returns      a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const Predicate &where);
+
+    virtual ValueDict *project(Handle handle);
+
+    virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
+
+    using DbRelation::project;
+
+    virtual DbRelationScan *scan(const ColumnNames *column_names, const Predicate &where);
+
+    /**
+     * Number of segments of a column read from its file (e.g., to check that a query left it alone).
+     * @param column_name  the column
+     * @returns            segments read since the table was constructed
+     */
+    virtual u_long get_segment_reads(const Identifier &column_name) const;
+
+protected:
+    static const uint GROUP_MAP_SZ = 4 + GROUP_ROWS / 8;  // row count, padding, bitmap of deleted rows
+    static const uint UPDATE_SLACK = 8;                   // 1/8 of each TEXT segment is kept free for updates
+
+    u_int32_t segment_size;
+    std::vector<ColumnAttribute::DataType> column_types;
+    std::vector<SegmentFile *> files;          // one per column
+    SegmentFile group_file;                    // the group maps
+    std::vector<u_char> group_maps;            // GROUP_MAP_SZ bytes for each row group
+    std::vector<bool> dirty_groups;            // dirty_groups[g - 1]: group g's map needs writing back
+    BlockID last_group;                        // the group being filled in (0 if there are none yet)
+    bool last_group_dirty;
+    std::vector<std::vector<char>> last_segments;  // the last group's segments, one per column
+    std::vector<std::vector<char>> segments;       // another segment of each column, as last read
+    std::vector<BlockID> loaded;                   // which group's segment is in segments (0 for none)
+    bool closed;
+
+    virtual void flush();
+
+    virtual char *segment(uint ordinal, BlockID group_id);
+
+    virtual void put_segment(uint ordinal, BlockID group_id);
+
+    virtual void start_group();
+
+    virtual bool fits(const Row *row);
+
+    u_int16_t &group_rows(BlockID group_id);
+
+    bool is_deleted(BlockID group_id, uint position) const;
+
+    virtual void check(Handle handle);
+
+    virtual void rewrite(const Handle handle, const ValueDict *new_values);
+
+    virtual void erase(const Handle handle);
+
+    virtual uint load(BlockID group_id, const std::vector<uint> &ordinals, std::vector<ColumnVector> &columns);
+
+    virtual void live(BlockID group_id, Selection &selection) const;
+
+    friend class ColumnTableScan;
+};
+
+/**
+ * @class ColumnTableScan - vectorized scan of a ColumnTable (see DbRelation::scan)
+ *
+ * A row group at a time: reads the segments of just the columns that are projected or that the where
+ * clause uses, turns them into column vectors (an INT segment is copied as is), evaluates the where
+ * clause over the vectors, drops the deleted rows, and gathers the rest into the caller's Batch.
+ */
+class ColumnTableScan : public DbRelationScan {
+public:
+    ColumnTableScan(ColumnTable &table, const ColumnNames *column_names, const Predicate &where);
+
+    virtual ~ColumnTableScan() {}
+
+    ColumnTableScan(const ColumnTableScan &other) = delete;
+
+    ColumnTableScan(ColumnTableScan &&temp) = delete;
+
+    ColumnTableScan &operator=(const ColumnTableScan &other) = delete;
+
+    ColumnTableScan &operator=(ColumnTableScan &&temp) = delete;
+
+    virtual bool next(Batch &batch);
+
+protected:
+    ColumnTable &table;
+    ColumnNames column_names;
+    std::vector<uint> ordinals;         // table ordinal of each projected column
+    std::vector<uint> decoded;          // table ordinals of the columns to read
+    Predicate where;
+    BlockID next_group;
+    std::vector<ColumnVector> columns;  // the group's values, one vector per table ordinal
+    Selection selection;
+};
+
+bool test_column_table();
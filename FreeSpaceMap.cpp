@@ -0,0 +1,201 @@
+/**
+ * @file FreeSpaceMap.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "FreeSpaceMap.h"
+#include "SlottedPage.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name  name of the heap file the map is for
+ */
+FreeSpaceMap::FreeSpaceMap(string name) : dbfilename(name + ".fsm.db"), block_size(DbBlock::BLOCK_SZ), closed(true),
+                                          db(_DB_ENV, 0), classes(), candidates(CLASSES), dirty(), high_water(0),
+                                          last(0) {
+}
+
+/**
+ * Open (or create) the map's file and read in the classes of all the blocks.
+ * @param block_size  size of the heap file's blocks
+ */
+void FreeSpaceMap::open(uint block_size) {
+    if (!this->closed)
+        return;
+    this->block_size = block_size;
+    this->db.set_re_len(DbBlock::BLOCK_SZ);
+    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, DB_CREATE, 0644);
+    this->closed = false;
+
+    this->classes.clear();
+    this->candidates.assign(CLASSES, BlockIDs());
+    this->dirty.clear();
+    this->high_water = 0;
+    this->last = 0;
+    u_char buffer[DbBlock::BLOCK_SZ];
+    for (db_recno_t record = 1;; record++) {
+        Dbt key(&record, sizeof(record));
+        Dbt data(buffer, sizeof(buffer));
+        data.set_ulen(sizeof(buffer));
+        data.set_flags(DB_DBT_USERMEM);
+        if (this->db.get(nullptr, &key, &data, 0) != 0)
+            break;
+        if (record == 1) {
+            this->high_water = *(BlockID *) buffer;
+            this->last = *(BlockID *) (buffer + sizeof(BlockID));
+            continue;
+        }
+        for (uint i = 0; i < BLOCKS_PER_RECORD; i++)
+            this->classes.push_back((u_char) ((buffer[i / 2] >> (4 * (i % 2))) & 0x0f));
+        this->dirty.push_back(false);
+    }
+    for (BlockID block_id = 1; block_id <= this->classes.size(); block_id++)
+        if (this->classes[block_id - 1] > 0)
+            this->candidates[this->classes[block_id - 1]].push_back(block_id);
+}
+
+/**
+ * Write back and close the map's file.
+ */
+void FreeSpaceMap::close() {
+    if (this->closed)
+        return;
+    flush();
+    this->db.close(0);
+    this->closed = true;
+}
+
+/**
+ * Delete the map's file.
+ */
+void FreeSpaceMap::drop() {
+    close();
+    Db db(_DB_ENV, 0);
+    db.remove(this->dbfilename.c_str(), nullptr, 0);
+}
+
+/**
+ * Write back every record of the map that has a changed class in it.
+ */
+void FreeSpaceMap::flush() {
+    u_char buffer[DbBlock::BLOCK_SZ];
+    for (uint i = 0; i < this->dirty.size(); i++) {
+        if (!this->dirty[i])
+            continue;
+        memset(buffer, 0, sizeof(buffer));
+        uint first = i * BLOCKS_PER_RECORD;
+        for (uint j = 0; j < BLOCKS_PER_RECORD && first + j < this->classes.size(); j++)
+            buffer[j / 2] |= (u_char) (this->classes[first + j] << (4 * (j % 2)));
+        db_recno_t record = i + 2;  // after the header
+        Dbt key(&record, sizeof(record));
+        Dbt data(buffer, sizeof(buffer));
+        this->db.put(nullptr, &key, &data, 0);
+        this->dirty[i] = false;
+    }
+}
+
+/**
+ * Write the heap file's high-water mark into the header record right away.
+ * @param block_id  last block id reserved
+ * @param last      last block id handed out (0 if not known)
+ */
+void FreeSpaceMap::set_high_water(BlockID block_id, BlockID last) {
+    u_char buffer[DbBlock::BLOCK_SZ];
+    memset(buffer, 0, sizeof(buffer));
+    *(BlockID *) buffer = block_id;
+    *(BlockID *) (buffer + sizeof(BlockID)) = last;
+    db_recno_t record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data(buffer, sizeof(buffer));
+    this->db.put(nullptr, &key, &data, 0);
+    this->high_water = block_id;
+    this->last = last;
+}
+
+/**
+ * Record how much free space a block has.
+ * @param block_id    the block
+ * @param free_bytes  its free space, in bytes
+ */
+void FreeSpaceMap::set(BlockID block_id, u_int32_t free_bytes) {
+    uint free_class = this->free_class(free_bytes);
+    uint i = block_id - 1;
+    if (i >= this->classes.size())
+        this->classes.resize(i + 1, 0);
+    if (this->classes[i] == free_class)
+        return;
+    this->classes[i] = (u_char) free_class;
+    uint record = i / BLOCKS_PER_RECORD;
+    if (record >= this->dirty.size())
+        this->dirty.resize(record + 1, false);
+    this->dirty[record] = true;
+    if (free_class > 0)
+        this->candidates[free_class].push_back(block_id);
+}
+
+/**
+ * Find a block in the fullest class that is sure to have the room.
+ * @param needed  bytes needed
+ * @return        the block's id, or 0 if there is none
+ */
+BlockID FreeSpaceMap::find(u_int32_t needed) {
+    uint least = (uint) (((u_int64_t) needed * CLASSES + this->block_size - 1) / this->block_size);
+    for (uint free_class = least > 0 ? least : 1; free_class < CLASSES; free_class++) {
+        BlockIDs &stack = this->candidates[free_class];
+        while (!stack.empty()) {
+            BlockID block_id = stack.back();
+            if (this->classes[block_id - 1] == free_class)
+                return block_id;
+            stack.pop_back();  // stale: the block has moved to another class since
+        }
+    }
+    return 0;
+}
+
+/**
+ * The class for a given amount of free space: the number of whole sixteenths of the block that are free.
+ * @param free_bytes  free space in a block
+ * @return            its class
+ */
+uint FreeSpaceMap::free_class(u_int32_t free_bytes) const {
+    uint free_class = (uint) ((u_int64_t) free_bytes * CLASSES / this->block_size);
+    return free_class < CLASSES ? free_class : CLASSES - 1;
+}
+
+/**
+ * Testing function for FreeSpaceMap.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_free_space_map() {
+    FreeSpaceMap fsm("_test_free_space_map_cpp");
+    fsm.open(DbBlock::BLOCK_SZ);
+    fsm.set(1, 100);
+    fsm.set(2, 2000);
+    fsm.set(3, 4000);
+    if (fsm.find(1000) != 2)
+        return assertion_failure("find picks fullest block with room", fsm.find(1000));
+    if (fsm.find(3000) != 3)
+        return assertion_failure("find picks only block with room", fsm.find(3000));
+    if (fsm.find(DbBlock::BLOCK_SZ - 10) != 0)
+        return assertion_failure("find when no block has room", fsm.find(DbBlock::BLOCK_SZ - 10));
+    fsm.set(2, 10);
+    if (fsm.find(1000) != 3)
+        return assertion_failure("find after block filled up", fsm.find(1000));
+
+    // classes persist, including those of blocks in the second record of the map, and so does the high-water mark
+    fsm.set(2 * DbBlock::BLOCK_SZ + 1, 4000);
+    fsm.set_high_water(2 * DbBlock::BLOCK_SZ + 16, 2 * DbBlock::BLOCK_SZ + 3);
+    fsm.close();
+    fsm.open(DbBlock::BLOCK_SZ);
+    if (fsm.get_high_water() != 2 * DbBlock::BLOCK_SZ + 16 || fsm.get_last() != 2 * DbBlock::BLOCK_SZ + 3)
+        return assertion_failure("reopened high-water mark", fsm.get_high_water(), fsm.get_last());
+    if (fsm.find(3000) != 2 * DbBlock::BLOCK_SZ + 1 || fsm.find(1000) != 2 * DbBlock::BLOCK_SZ + 1)
+        return assertion_failure("reopened map", fsm.find(3000));
+    fsm.set(2 * DbBlock::BLOCK_SZ + 1, 0);
+    if (fsm.find(1000) != 3)
+        return assertion_failure("reopened map after change", fsm.find(1000));
+    fsm.drop();
+    return true;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file FreeSpaceMap.h - Persistent map of the free space in each block of a HeapFile.
+ * FreeSpaceMap
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class FreeSpaceMap - free space class of every block in a heap file
+ *
+ * Each block is summarized by a 4-bit free space class: a block in class c has at least
+ * c/CLASSES of the block size free. The classes are kept in memory and written back, two per byte,
+ * to their own Berkeley DB RecNo file (<heap file>.fsm.db) when the map is flushed or closed.
+ * The classes are only a hint -- if they were not flushed (or the file is missing) blocks just look full
+ * or get corrected the first time an insert finds they don't have the space.
+ *
+ * The first record of the map's file is a header holding the heap file's high-water mark: the last
+ * block id its allocator has reserved, and the last one it has handed out as of when the file was closed
+ * (0 while it is open, since ids past it may be in use by then). Unlike the classes, it is written through
+ * as soon as it changes.
+ *
+ * find() gives a block with enough room in O(1) amortized: for each class there is a stack of
+ * candidate blocks, and stale entries (blocks whose class has since changed) are dropped lazily.
+ */
+class FreeSpaceMap {
+public:
+    /**
+     * number of free space classes (4 bits per block)
+     */
+    static const uint CLASSES = 16;
+
+    FreeSpaceMap(std::string name);
+
+    virtual ~FreeSpaceMap() {}
+
+    FreeSpaceMap(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap(FreeSpaceMap &&temp) = delete;
+
+    FreeSpaceMap &operator=(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap &operator=(FreeSpaceMap &&temp) = delete;
+
+    /**
+     * Open the map, creating its file if it doesn't exist yet.
+     * @param block_size  size of the heap file's blocks
+     */
+    virtual void open(uint block_size);
+
+    /**
+     * Write back the map and close its file.
+     */
+    virtual void close();
+
+    /**
+     * Remove the map's file.
+     */
+    virtual void drop();
+
+    /**
+     * Write back the classes that have changed since the last flush.
+     */
+    virtual void flush();
+
+    /**
+     * Record how much free space a block has.
+     * @param block_id    the block
+     * @param free_bytes  its free space, in bytes
+     */
+    virtual void set(BlockID block_id, u_int32_t free_bytes);
+
+    /**
+     * Find a block that is known to have at least the given amount of free space. Picks from the
+     * fullest class that is sure to be big enough.
+     * @param needed  bytes needed
+     * @returns       a block id, or 0 if no block is known to have the room
+     */
+    virtual BlockID find(u_int32_t needed);
+
+    /**
+     * Get the heap file's high-water mark as of the last set_high_water().
+     * @returns  last block id reserved, or 0 if it has never been set
+     */
+    virtual BlockID get_high_water() const { return high_water; }
+
+    /**
+     * Get the last block id the heap file handed out, as of the last set_high_water().
+     * @returns  last block id handed out, or 0 if it isn't known (e.g., the file wasn't closed)
+     */
+    virtual BlockID get_last() const { return last; }
+
+    /**
+     * Durably record the heap file's high-water mark.
+     * @param block_id  last block id reserved
+     * @param last      last block id handed out, or 0 if more may be handed out before this is next called
+     */
+    virtual void set_high_water(BlockID block_id, BlockID last = 0);
+
+protected:
+    static const uint BLOCKS_PER_RECORD = 2 * DbBlock::BLOCK_SZ;
+
+    std::string dbfilename;
+    uint block_size;
+    bool closed;
+    Db db;
+    std::vector<u_char> classes;             // classes[block_id - 1]
+    std::vector<BlockIDs> candidates;        // candidates[class]: blocks that were in class
+    std::vector<bool> dirty;                 // dirty[i]: i-th record of classes needs writing back
+    BlockID high_water;
+    BlockID last;
+
+    uint free_class(u_int32_t free_bytes) const;
+
+    friend bool test_free_space_map();
+};
+
+bool test_free_space_map();
@@ -0,0 +1,635 @@
+/**
+ * @file HashIndex.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "SQLParser.h"
+#include "HashIndex.h"
+#include "HeapTable.h"
+
+using namespace std;
+using namespace hsql;
+typedef uint16_t u16;
+
+/**
+ * Constructor
+ * @param relation         the relation to index
+ * @param name             the index's name (its files are <table>-<name>.db and <table>-<name>-overflow.db)
+ * @param key_columns      the relation's columns the key is made of, in order
+ * @param unique           whether two rows can't have the same key
+ * @param include_columns  more of the relation's columns whose values the entries carry
+ */
+HashIndex::HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+                     ColumnNames include_columns)
+        : DbIndex(relation, name, key_columns, unique, include_columns), file(relation.get_table_name() + "-" + name),
+          overflow_file(relation.get_table_name() + "-" + name + "-overflow"), pool(file), overflow_pool(overflow_file),
+          closed(true), buckets(0), level(0), used(0), free_overflow(0), key_types(), include_types(), page_reads(0) {
+    for (uint i = 0; i < this->ordinals.size(); i++) {
+        Identifier column_name = i < this->key_columns.size() ? this->key_columns[i]
+                                                              : this->include_columns[i - this->key_columns.size()];
+        if (this->ordinals[i] < 0)
+            throw DbRelationError("table '" + relation.get_table_name() + "' has no column '" + column_name + "'");
+        ColumnAttribute ca = relation.get_column_attributes()[this->ordinals[i]];
+        (i < this->key_columns.size() ? this->key_types : this->include_types).push_back(ca.get_data_type());
+    }
+}
+
+/**
+ * Create the index's files with one empty bucket, then add the relation's rows to it.
+ */
+void HashIndex::create() {
+    this->file.create();
+    this->overflow_file.create();
+    this->closed = false;
+    SlottedPage *page = this->pool.fetch_new(FIRST_BUCKET);
+    set_link(page, 0);
+    this->pool.unpin(page, true);
+    this->buckets = 1;
+    this->level = 0;
+    this->used = 0;
+    this->free_overflow = 0;
+    save_stat();
+
+    Handles *handles = this->relation.select();
+    try {
+        for (auto const &handle: *handles)
+            insert(handle);
+    } catch (...) {
+        delete handles;
+        drop();
+        throw;
+    }
+    delete handles;
+}
+
+/**
+ * Remove the index's files.
+ */
+void HashIndex::drop() {
+    open();
+    this->pool.discard();
+    this->overflow_pool.discard();
+    this->file.drop();
+    this->overflow_file.drop();
+    this->closed = true;
+}
+
+/**
+ * Open the index's files and read its stats.
+ */
+void HashIndex::open() {
+    if (!this->closed)
+        return;
+    this->file.open();
+    this->overflow_file.open();
+    this->closed = false;
+    SlottedPage *stat = this->pool.fetch(STAT_BLOCK);
+    RecordView data;
+    if (stat->view(1, data)) {
+        const u_int32_t *fields = (const u_int32_t *) data.data;
+        this->buckets = fields[0];
+        this->level = fields[1];
+        this->used = fields[2];
+        this->free_overflow = fields[3];
+    }
+    this->pool.unpin(stat);
+}
+
+/**
+ * Write back the changed blocks and close the index's files.
+ */
+void HashIndex::close() {
+    if (this->closed)
+        return;
+    this->pool.clear();
+    this->overflow_pool.clear();
+    this->file.close();
+    this->overflow_file.close();
+    this->closed = true;
+}
+
+/**
+ * Find the rows with a given key: read the key's bucket and its overflow blocks, if any.
+ * @param key   a value for each key column
+ * @param rows  if not nullptr, gets the rows' values from their entries
+ * @return      the rows' handles
+ */
+Handles *HashIndex::lookup(const KeyValue &key, Rows *rows) {
+    open();
+    vector<char> bytes;
+    encode(key, this->key_types, bytes);
+    Handles *handles = new Handles();
+    BlockID block_id = FIRST_BUCKET + bucket_of(bytes);
+    bool is_overflow = false;
+    while (block_id != 0) {
+        SlottedPage *page = fetch(block_id, is_overflow);
+        RecordView data;
+        for (RecordID record_id: page->records()) {
+            if (record_id == 1 || !page->view(record_id, data) || data.size < bytes.size() + HANDLE_SZ
+                || memcmp(data.data, bytes.data(), bytes.size()) != 0)
+                continue;  // keys are self-delimiting, so the same leading bytes are the same key
+            const char *handle = data.data + bytes.size();
+            handles->push_back(Handle(*(u_int32_t *) handle, *(u16 *) (handle + 4)));
+            if (rows != nullptr) {
+                KeyValue values(key), included;
+                uint offset = (uint) bytes.size() + HANDLE_SZ;
+                decode(data.data, offset, this->include_types, included);
+                values.insert(values.end(), included.begin(), included.end());
+                rows->push_back(make_row(values));
+            }
+        }
+        BlockID next = get_link(page);
+        unpin(page, is_overflow);
+        block_id = next;
+        is_overflow = true;
+    }
+    return handles;
+}
+
+/**
+ * Add a row to the index, splitting the next bucket in turn if the buckets are getting full.
+ * @param handle  the row (stored in the relation)
+ * @throws DbRelationError  if the index is unique and already has the row's key
+ */
+void HashIndex::insert(Handle handle) {
+    open();
+    KeyValue key = project(handle, this->key_columns);
+    if (this->unique) {
+        Handles *handles = lookup(key);
+        bool duplicate = !handles->empty();
+        delete handles;
+        if (duplicate)
+            throw DbRelationError("duplicate key for unique index '" + this->name + "'");
+    }
+    vector<char> entry;
+    encode(key, this->key_types, entry);
+    uint bucket = bucket_of(entry);
+    entry.resize(entry.size() + HANDLE_SZ);
+    *(u_int32_t *) (entry.data() + entry.size() - HANDLE_SZ) = handle.first;
+    *(u16 *) (entry.data() + entry.size() - 2) = handle.second;
+    if (!this->include_columns.empty())
+        encode(project(handle, this->include_columns), this->include_types, entry);
+    if (entry.size() > bucket_capacity() / 4)
+        throw DbRelationError("key too long for index '" + this->name + "'");
+    add(bucket, entry);
+    this->used += (u_int32_t) entry.size() + 4;
+    if (this->used > (u_long) this->buckets * bucket_capacity() / 4 * 3)
+        split();
+    save_stat();
+}
+
+/**
+ * Remove a row from the index.
+ * @param handle  the row (still stored in the relation)
+ * @throws DbRelationError  if the row isn't in the index
+ */
+void HashIndex::del(Handle handle) {
+    open();
+    vector<char> entry;
+    encode(project(handle, this->key_columns), this->key_types, entry);
+    BlockID block_id = FIRST_BUCKET + bucket_of(entry);
+    entry.resize(entry.size() + HANDLE_SZ);
+    *(u_int32_t *) (entry.data() + entry.size() - HANDLE_SZ) = handle.first;
+    *(u16 *) (entry.data() + entry.size() - 2) = handle.second;
+    bool is_overflow = false;
+    while (block_id != 0) {
+        SlottedPage *page = fetch(block_id, is_overflow);
+        RecordView data;
+        for (RecordID record_id: page->records()) {
+            if (record_id != 1 && page->view(record_id, data) && data.size >= entry.size()
+                && memcmp(data.data, entry.data(), entry.size()) == 0) {
+                this->used -= data.size + 4;
+                page->del(record_id);
+                unpin(page, is_overflow, true);
+                save_stat();
+                return;
+            }
+        }
+        BlockID next = get_link(page);
+        unpin(page, is_overflow);
+        block_id = next;
+        is_overflow = true;
+    }
+    throw DbRelationError("row not found in index '" + this->name + "'");
+}
+
+/**
+ * Marshal values the way they are in an entry: each INT as 4 bytes, each TEXT as its length (2 bytes) and
+ * bytes.
+ * @param values  the values (e.g., a key)
+ * @param types   the type each should be
+ * @param bytes   their bytes are added to the end
+ */
+void HashIndex::encode(const KeyValue &values, const vector<ColumnAttribute::DataType> &types,
+                       vector<char> &bytes) const {
+    if (values.size() != types.size())
+        throw DbRelationError("wrong number of key values for index '" + this->name + "'");
+    for (uint i = 0; i < values.size(); i++) {
+        const Value &value = values[i];
+        if (value.data_type != types[i])
+            throw DbRelationError("wrong type of key value for index '" + this->name + "'");
+        if (value.data_type == ColumnAttribute::INT) {
+            const char *n = (const char *) &value.n;
+            bytes.insert(bytes.end(), n, n + sizeof(int32_t));
+        } else {
+            u16 size = (u16) value.s.length();
+            const char *length = (const char *) &size;
+            bytes.insert(bytes.end(), length, length + sizeof(u16));
+            bytes.insert(bytes.end(), value.s.begin(), value.s.end());
+        }
+    }
+}
+
+/**
+ * Unmarshal values (see encode).
+ * @param bytes   where they are
+ * @param offset  where they start, moved past them
+ * @param types   the type of each value
+ * @param values  set to the values
+ */
+void HashIndex::decode(const char *bytes, uint &offset, const vector<ColumnAttribute::DataType> &types,
+                       KeyValue &values) {
+    values.resize(types.size());
+    for (uint i = 0; i < types.size(); i++) {
+        Value &value = values[i];
+        value.data_type = types[i];
+        if (value.data_type == ColumnAttribute::INT) {
+            value.n = *(int32_t *) (bytes + offset);
+            offset += sizeof(int32_t);
+        } else {
+            u16 size = *(u16 *) (bytes + offset);
+            offset += sizeof(u16);
+            value.s.assign(bytes + offset, size);
+            offset += size;
+        }
+    }
+}
+
+/**
+ * Number of bytes the key takes at the start of an entry.
+ */
+uint HashIndex::key_size(const char *entry) const {
+    uint offset = 0;
+    for (auto data_type: this->key_types)
+        offset += data_type == ColumnAttribute::INT ? sizeof(int32_t) : sizeof(u16) + *(u16 *) (entry + offset);
+    return offset;
+}
+
+/**
+ * Pick a key's bucket from the low bits of its hash.
+ * @param key  the key's bytes (see encode)
+ * @return     the bucket number
+ */
+uint HashIndex::bucket_of(const vector<char> &key) const {
+    u_int32_t h = hash(key.data(), key.size());
+    uint bucket = h & ((2U << this->level) - 1);
+    if (bucket >= this->buckets)
+        bucket = h & ((1U << this->level) - 1);  // not split yet
+    return bucket;
+}
+
+/**
+ * Pin a bucket or overflow block, counting the read.
+ */
+SlottedPage *HashIndex::fetch(BlockID block_id, bool is_overflow) {
+    this->page_reads++;
+    return (is_overflow ? this->overflow_pool : this->pool).fetch(block_id);
+}
+
+/**
+ * Unpin a block gotten from fetch().
+ */
+void HashIndex::unpin(SlottedPage *page, bool is_overflow, bool dirty) {
+    (is_overflow ? this->overflow_pool : this->pool).unpin(page, dirty);
+}
+
+/**
+ * Get all the entries of a bucket, from its block and its overflow blocks.
+ * @param bucket   the bucket number
+ * @param entries  the entries' bytes are added here
+ */
+void HashIndex::read_bucket(uint bucket, vector<vector<char>> &entries) {
+    BlockID block_id = FIRST_BUCKET + bucket;
+    bool is_overflow = false;
+    while (block_id != 0) {
+        SlottedPage *page = fetch(block_id, is_overflow);
+        RecordView data;
+        for (RecordID record_id: page->records())
+            if (record_id != 1 && page->view(record_id, data))
+                entries.push_back(vector<char>(data.data, data.data + data.size));
+        BlockID next = get_link(page);
+        unpin(page, is_overflow);
+        block_id = next;
+        is_overflow = true;
+    }
+}
+
+/**
+ * Replace all the entries of a bucket. Its overflow blocks are emptied and put on the free list first.
+ * @param bucket   the bucket number
+ * @param entries  the bucket's new entries
+ */
+void HashIndex::write_bucket(uint bucket, const vector<vector<char>> &entries) {
+    BlockID block_id = FIRST_BUCKET + bucket;
+    bool is_overflow = false;
+    while (block_id != 0) {
+        SlottedPage *page = fetch(block_id, is_overflow);
+        RecordIDs *record_ids = page->ids();
+        for (RecordID record_id: *record_ids)
+            if (record_id != 1)
+                page->del(record_id);
+        delete record_ids;
+        BlockID next = get_link(page);
+        if (is_overflow) {
+            set_link(page, this->free_overflow);
+            this->free_overflow = block_id;
+        } else {
+            set_link(page, 0);
+        }
+        unpin(page, is_overflow, true);
+        block_id = next;
+        is_overflow = true;
+    }
+    for (auto const &entry: entries)
+        add(bucket, entry);
+}
+
+/**
+ * Add an entry to the first block of a bucket's chain with room for it, chaining on an overflow block
+ * (a free one, if there is any) when none has.
+ * @param bucket  the bucket number
+ * @param entry   the entry's bytes
+ */
+void HashIndex::add(uint bucket, const vector<char> &entry) {
+    Dbt data((void *) entry.data(), (u_int32_t) entry.size());
+    BlockID block_id = FIRST_BUCKET + bucket;
+    bool is_overflow = false;
+    while (true) {
+        SlottedPage *page = fetch(block_id, is_overflow);
+        try {
+            page->add(&data);
+            unpin(page, is_overflow, true);
+            return;
+        } catch (DbBlockNoRoomError &e) {
+            // on to the next block in the chain
+        }
+        BlockID next = get_link(page);
+        if (next == 0) {
+            SlottedPage *overflow;
+            if (this->free_overflow != 0) {
+                overflow = fetch(this->free_overflow, true);
+                this->free_overflow = get_link(overflow);
+            } else {
+                overflow = this->overflow_pool.fetch_new();
+            }
+            next = overflow->get_block_id();
+            set_link(overflow, 0);
+            overflow->add(&data);
+            this->overflow_pool.unpin(overflow, true);
+            set_link(page, next);
+            unpin(page, is_overflow, true);
+            return;
+        }
+        unpin(page, is_overflow);
+        block_id = next;
+        is_overflow = true;
+    }
+}
+
+/**
+ * Split the bucket at the split pointer: add a bucket at the end, and move into it the entries whose hash
+ * has a 1 in the bit after the level's.
+ */
+void HashIndex::split() {
+    uint bucket = this->buckets - (1U << this->level);
+    vector<vector<char>> entries, staying, moving;
+    read_bucket(bucket, entries);
+    for (auto const &entry: entries) {
+        u_int32_t h = hash(entry.data(), key_size(entry.data()));
+        ((h >> this->level) & 1 ? moving : staying).push_back(entry);
+    }
+
+    // the new bucket's block is allocated by its number, not as whichever id the file would hand out next
+    SlottedPage *page = this->pool.fetch_new(FIRST_BUCKET + this->buckets);
+    set_link(page, 0);
+    this->pool.unpin(page, true);
+    this->buckets++;
+    if (this->buckets == 2U << this->level)
+        this->level++;
+    write_bucket(bucket, staying);
+    write_bucket(this->buckets - 1, moving);
+}
+
+/**
+ * Write the index's stats into the stat block: buckets, level, bytes used, first free overflow block.
+ */
+void HashIndex::save_stat() {
+    u_int32_t stat[4] = {this->buckets, this->level, this->used, this->free_overflow};
+    Dbt data(stat, sizeof(stat));
+    SlottedPage *page = this->pool.fetch(STAT_BLOCK);
+    RecordView record;
+    if (page->view(1, record))
+        page->put(1, data);
+    else
+        page->add(&data);
+    this->pool.unpin(page, true);
+}
+
+/**
+ * Most bytes of entries (with their record headers) a block can take: its block, less the block's header
+ * and the link record.
+ */
+u_int32_t HashIndex::bucket_capacity() const {
+    return this->file.get_block_size() - 16;
+}
+
+/**
+ * FNV-1a hash of some bytes, with a final mix so that the low bits depend on all of them.
+ * @param bytes   the bytes
+ * @param length  how many
+ * @return        the hash
+ */
+u_int32_t HashIndex::hash(const char *bytes, size_t length) {
+    u_int32_t h = 2166136261U;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (u_char) bytes[i];
+        h *= 16777619U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h;
+}
+
+/**
+ * The next block in a bucket's chain (0 for none).
+ */
+BlockID HashIndex::get_link(const SlottedPage *page) {
+    RecordView data;
+    if (!page->view(1, data))
+        return 0;
+    return *(const u_int32_t *) data.data;
+}
+
+/**
+ * Chain a block to the next one (0 for none).
+ */
+void HashIndex::set_link(SlottedPage *page, BlockID link) {
+    Dbt data(&link, sizeof(link));
+    RecordView record;
+    if (page->view(1, record))
+        page->put(1, data);
+    else
+        page->add(&data);
+}
+
+/**
+ * Testing function for HashIndex.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_hash_index() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_hash_index_cpp", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i = 0; i < 10000; i++) {
+        row[0] = Value(i % 5000);  // each a twice
+        row[1] = Value(string(20, (char) ('a' + i % 26)));
+        rows.push_back(row);
+    }
+    Handles *handles = table.insert_many(&rows);
+
+    HashIndex index(table, "hx", {"a"}, false, {"b"});
+    index.create();
+    table.attach(&index);
+    if (index.get_bucket_count() < 16)
+        return assertion_failure("hash index buckets", index.get_bucket_count());
+    u_long reads = index.get_page_reads();
+    Handles *found = index.lookup(KeyValue{Value(1234)});
+    sort(found->begin(), found->end());
+    if (found->size() != 2 || (*found)[0] != (*handles)[1234] || (*found)[1] != (*handles)[6234])
+        return assertion_failure("hash index lookup", (double) found->size());
+    if (index.get_page_reads() - reads > 2)
+        return assertion_failure("hash index lookup reads", index.get_page_reads() - reads);
+    delete found;
+    bool ok = true;
+    for (int a = 0; a < 5000 && ok; a += 7) {
+        found = index.lookup(KeyValue{Value(a)});
+        ok = found->size() == 2;
+        delete found;
+    }
+    if (!ok)
+        return assertion_failure("hash index lookups");
+    try {
+        delete index.range(KeyValue{Value(1)}, KeyValue{Value(2)});
+        return assertion_failure("hash index range");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+
+    // the table keeps it up to date and uses it for equality predicates only
+    ValueDict where;
+    where["a"] = Value(4321);
+    reads = index.get_page_reads();
+    u_long scanned = table.get_blocks_scanned();
+    found = table.select(&where);
+    if (found->size() != 2 || table.get_blocks_scanned() != scanned || index.get_page_reads() == reads)
+        return assertion_failure("select by hash index", (double) found->size());
+    table.del(found->front());
+    delete found;
+    ValueDict new_values;
+    new_values["a"] = Value(-7);
+    table.update((*handles)[4321 + 5000], &new_values);
+    found = table.select(&where);
+    ok = found->empty();
+    delete found;
+    found = index.lookup(&new_values);
+    ok = ok && found->size() == 1 && found->front() == (*handles)[4321 + 5000];
+    delete found;
+    if (!ok)
+        return assertion_failure("hash index maintenance");
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE a < 3");
+    Predicate less(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names, column_attributes);
+    delete parse;
+    reads = index.get_page_reads();
+    found = table.select(less);
+    if (found->size() != 7 || index.get_page_reads() != reads)  // 0, 1 and 2 twice, and -7
+        return assertion_failure("range select with a hash index", (double) found->size());
+    delete found;
+
+    // it lasts, and a unique one turns away duplicates
+    index.close();
+    HashIndex reopened(table, "hx", {"a"}, false, {"b"});
+    Rows covered;
+    found = reopened.lookup(KeyValue{Value(-7)}, &covered);
+    ok = found->size() == 1 && reopened.get_bucket_count() == index.get_bucket_count() && covered.size() == 1
+         && covered[0][0] == Value(-7) && covered[0][1] == Value(string(20, (char) ('a' + (4321 + 5000) % 26)));
+    delete found;
+    table.detach(&index);
+    table.attach(&reopened);
+    HashIndex unique(table, "ux", {"b", "a"}, true);
+    unique.create();
+    table.attach(&unique);
+    row[0] = Value(-7);
+    row[1] = Value(string(20, (char) ('a' + (4321 + 5000) % 26)));
+    try {
+        table.insert(&row);
+        ok = false;
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    found = reopened.lookup(KeyValue{Value(-7)});
+    ok = ok && found->size() == 1;
+    delete found;
+    if (!ok)
+        return assertion_failure("unique hash index");
+
+    table.detach(&reopened);
+    table.detach(&unique);
+    reopened.drop();
+    unique.drop();
+    table.drop();
+    delete handles;
+
+    // a reopened index goes on splitting into the blocks its buckets are numbered by, even if its file
+    // wasn't closed the last time (and so hands out ids past the end of its reserved extent)
+    HeapTable grown("_test_hash_grow_cpp", column_names, column_attributes);
+    grown.create();
+    HashIndex small(grown, "hg", {"a"}, true);
+    small.create();
+    grown.attach(&small);
+    for (int i = 0; i < 10; i++) {
+        row[0] = Value(i);
+        row[1] = Value("x");
+        grown.insert(&row);
+    }
+    grown.detach(&small);
+    small.close();
+    HeapFile unclosed("_test_hash_grow_cpp-hg");
+    unclosed.open();
+    HashIndex growing(grown, "hg", {"a"}, true);
+    grown.attach(&growing);
+    for (int i = 10; i < 3000; i++) {
+        row[0] = Value(i);
+        row[1] = Value("x");
+        grown.insert(&row);
+    }
+    uint bucket_count = growing.get_bucket_count();
+    ok = bucket_count > 1;
+    for (int i = 0; i < 3000 && ok; i += 37) {
+        found = growing.lookup(KeyValue{Value(i)});
+        ok = found->size() == 1;
+        delete found;
+    }
+    grown.detach(&growing);
+    growing.close();
+    unclosed.close();
+    growing.drop();
+    grown.drop();
+    if (!ok)
+        return assertion_failure("reopened hash index growth", bucket_count);
+    return true;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file HashIndex.h - Linear hashing implementation of DbIndex.
+ * HashIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "HeapFile.h"
+#include "BufferPool.h"
+
+/**
+ * @class HashIndex - linear hashing index of a relation (implementation of DbIndex), for equality lookups
+ *
+ * The index's buckets are the blocks of a HeapFile of their own (<table>-<index>.db): block 1 holds the
+ * index's stats and bucket i is block i + 2, so a key's bucket is found without reading anything else.
+ * A bucket that fills up is chained to overflow blocks, which are kept in a second HeapFile
+ * (<table>-<index>-overflow.db). Each bucket or overflow block is a SlottedPage whose record 1 is the id of
+ * the next overflow block in the chain (0 for none) and whose other records are entries: the key, then the
+ * row's handle, then the row's included values.
+ *
+ * A key's bucket is picked by the low bits of its hash: level + 1 of them, or just level if that names a
+ * bucket that hasn't been made yet. Whenever the entries come to fill more than three quarters of the
+ * buckets' room, the next bucket in turn (the split pointer, buckets - 2^level) is split, moving the
+ * entries whose next bit of hash is set into a new bucket at the end. So the buckets grow one at a time
+ * with the index, chains stay short, and a lookup reads one or two blocks however big the relation is.
+ * Deletes just take entries out (buckets are never merged); emptied overflow blocks are reused.
+ *
+ * Keys aren't kept in order, so the index can't find ranges of them, nor keys by their leading values.
+ */
+class HashIndex : public DbIndex {
+public:
+    HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+              ColumnNames include_columns = ColumnNames());
+
+    virtual ~HashIndex() {}
+
+    HashIndex(const HashIndex &other) = delete;
+
+    HashIndex(HashIndex &&temp) = delete;
+
+    HashIndex &operator=(const HashIndex &other) = delete;
+
+    HashIndex &operator=(HashIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const KeyValue &key, Rows *rows);
+
+    using DbIndex::lookup;
+
+    virtual void insert(Handle handle);
+
+    virtual void del(Handle handle);
+
+    virtual bool is_ordered() const { return false; }
+
+    /**
+     * Number of buckets (not counting their overflow blocks).
+     */
+    virtual uint get_bucket_count() {
+        open();
+        return buckets;
+    }
+
+    /**
+     * Number of bucket and overflow blocks read since the index was constructed (e.g., to see that a lookup
+     * reads one or two).
+     */
+    virtual u_long get_page_reads() const { return page_reads; }
+
+protected:
+    static const BlockID STAT_BLOCK = 1;
+    static const BlockID FIRST_BUCKET = 2;
+    static const uint HANDLE_SZ = 6;       // block id, record id
+
+    HeapFile file;
+    HeapFile overflow_file;
+    BufferPool pool;
+    BufferPool overflow_pool;
+    bool closed;
+    uint buckets;
+    uint level;
+    u_int32_t used;                        // bytes the entries take in their blocks
+    BlockID free_overflow;                 // first of the overflow blocks no bucket is using (0 for none)
+    std::vector<ColumnAttribute::DataType> key_types;
+    std::vector<ColumnAttribute::DataType> include_types;
+    u_long page_reads;
+
+    virtual void encode(const KeyValue &values, const std::vector<ColumnAttribute::DataType> &types,
+                        std::vector<char> &bytes) const;
+
+    virtual uint key_size(const char *entry) const;
+
+    virtual uint bucket_of(const std::vector<char> &key) const;
+
+    virtual SlottedPage *fetch(BlockID block_id, bool is_overflow);
+
+    virtual void unpin(SlottedPage *page, bool is_overflow, bool dirty = false);
+
+    virtual void read_bucket(uint bucket, std::vector<std::vector<char>> &entries);
+
+    virtual void write_bucket(uint bucket, const std::vector<std::vector<char>> &entries);
+
+    virtual void add(uint bucket, const std::vector<char> &entry);
+
+    virtual void split();
+
+    virtual void save_stat();
+
+    virtual u_int32_t bucket_capacity() const;
+
+    static void decode(const char *bytes, uint &offset, const std::vector<ColumnAttribute::DataType> &types,
+                       KeyValue &values);
+
+    static u_int32_t hash(const char *bytes, size_t length);
+
+    static BlockID get_link(const SlottedPage *page);
+
+    static void set_link(SlottedPage *page, BlockID link);
+};
+
+bool test_hash_index();
@@ -3,6 +3,7 @@
  * @author K Lundeen
  * @see Seattle University, CPSC5300
  */
+#include <algorithm>
 #include <cstring>
 #include "db_cxx.h"
 #include "HeapFile.h"
@@ -13,8 +14,14 @@ typedef uint16_t u16;
 /**
  * Constructor
  * @param name
+ * @param block_size  size of the blocks if the file gets created: a power of two from
+ *                    DbBlock::BLOCK_SZ to DbBlock::MAX_BLOCK_SZ
  */
-HeapFile::HeapFile(string name) : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0) {
+HeapFile::HeapFile(string name, uint block_size) : DbFile(name), dbfilename(""), block_size(block_size), last(0),
+                                                   reserved(0), new_block(), closed(true), db(_DB_ENV, 0), fsm(name),
+                                                   scanned(0), scan_buffer(), scan_buffer_lent(false) {
+    if (block_size < DbBlock::BLOCK_SZ || block_size > DbBlock::MAX_BLOCK_SZ || (block_size & (block_size - 1)) != 0)
+        throw DbRelationError("unsupported block size " + to_string(block_size));
     this->dbfilename = this->name + ".db";
 }
 
@@ -34,6 +41,7 @@ void HeapFile::drop(void) {
     close();
     Db db(_DB_ENV, 0);
     db.remove(this->dbfilename.c_str(), nullptr, 0);
+    this->fsm.drop();
 }
 
 /**
@@ -47,42 +55,94 @@ void HeapFile::open(void) {
  * Close the physical file.
  */
 void HeapFile::close(void) {
+    if (this->closed)
+        return;
+    if (this->reserved > 0)
+        this->fsm.set_high_water(this->reserved, this->last);
+    this->fsm.close();
     this->db.close(0);
     this->closed = true;
+    if (!this->scan_buffer_lent)
+        vector<char>().swap(this->scan_buffer);
 }
 
 /**
- * Allocate a new block for the database file.
+ * Allocate a new block for the database file and write it out once, initialized.
+ * The page's memory is this file's, and is reused by the next get_new() or get() of a never-written block.
  * @return the new empty DbBlock that is managing the records in this block and its block id.
  */
 SlottedPage *HeapFile::get_new(void) {
-    char block[DbBlock::BLOCK_SZ];
-    memset(block, 0, sizeof(block));
-    Dbt data(block, sizeof(block));
+    BlockID block_id = allocate();
+    Dbt data(empty_block(), this->block_size);
+    SlottedPage *page = new SlottedPage(data, block_id, true);
+    put(page);
+    return page;
+}
 
-    int block_id = ++this->last;
-    Dbt key(&block_id, sizeof(block_id));
+/**
+ * Hand out the next block id, reserving (and durably recording) a new extent of ids if needed.
+ * @return the new block's id
+ */
+BlockID HeapFile::allocate() {
+    if (this->last == this->reserved) {
+        this->reserved = this->last + EXTENT_BLOCKS;
+        this->fsm.set_high_water(this->reserved);
+    }
+    return ++this->last;
+}
 
-    // write out an empty block and read it back in so Berkeley DB is managing the memory
-    SlottedPage *page = new SlottedPage(data, this->last, true);
-    this->db.put(nullptr, &key, &data, 0); // write it out with initialization done to it
-    delete page;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, this->last);
+/**
+ * Hand out a given block id, reserving (and durably recording) extents through it if needed.
+ * @param block_id  the block id (not in use)
+ * @return          the block id
+ */
+BlockID HeapFile::allocate(BlockID block_id) {
+    if (block_id > this->reserved) {
+        this->reserved = block_id + EXTENT_BLOCKS - 1;
+        this->fsm.set_high_water(this->reserved);
+    }
+    this->last = std::max(this->last, block_id);
+    return block_id;
 }
 
 /**
  * Get a block from the database file.
  * @param block_id
- * @return          the given slotted page (freed by caller)
+ * @return          the given slotted page (freed by caller), empty if the block was never written
  */
 SlottedPage *HeapFile::get(BlockID block_id) {
     Dbt key(&block_id, sizeof(block_id));
     Dbt data;
-    this->db.get(nullptr, &key, &data, 0);
+    if (this->db.get(nullptr, &key, &data, 0) != 0) {
+        Dbt empty(empty_block(), this->block_size);
+        return new SlottedPage(empty, block_id, true);
+    }
     return new SlottedPage(data, block_id, false);
 }
 
+/**
+ * Read a block from the database file into memory the caller owns (e.g., a buffer pool frame).
+ * @param block_id
+ * @param buffer    where to put the block (at least get_block_size() bytes)
+ * @return          false if the block has never been written (buffer is left alone)
+ */
+bool HeapFile::get(BlockID block_id, void *buffer) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt data(buffer, this->block_size);
+    data.set_ulen(this->block_size);
+    data.set_flags(DB_DBT_USERMEM);
+    return this->db.get(nullptr, &key, &data, 0) == 0;
+}
+
+/**
+ * This file's scratch memory for a new block, zeroed.
+ * @return  get_block_size() bytes
+ */
+void *HeapFile::empty_block() {
+    this->new_block.assign(this->block_size, 0);
+    return this->new_block.data();
+}
+
 /**
  * Write a block back to the database file.
  * @param block
@@ -95,13 +155,10 @@ void HeapFile::put(DbBlock *block) {
 
 /**
  * Sequence of all block ids.
- * @return block ids
+ * @return block ids 1 through the last block
  */
-BlockIDs *HeapFile::block_ids() const {
-    BlockIDs *vec = new BlockIDs();
-    for (BlockID block_id = 1; block_id <= this->last; block_id++)
-        vec->push_back(block_id);
-    return vec;
+BlockIDRange HeapFile::blocks() const {
+    return BlockIDRange(1, this->last);
 }
 
 /**
@@ -116,6 +173,142 @@ uint32_t HeapFile::get_block_count() {
     return bt_ndata;
 }
 
+/**
+ * Ask BerkDb for the highest block id written to the file (which the number of blocks falls short of when
+ * some of the ids handed out were never written).
+ * @return the block id, or 0 if nothing has been written
+ */
+BlockID HeapFile::get_highest_block_id() {
+    Dbc *cursor;
+    this->db.cursor(nullptr, &cursor, 0);
+    db_recno_t recno = 0;
+    Dbt key(&recno, sizeof(recno));
+    key.set_ulen(sizeof(recno));
+    key.set_flags(DB_DBT_USERMEM);
+    Dbt data;
+    data.set_flags(DB_DBT_PARTIAL);  // just the key
+    data.set_dlen(0);
+    int status = cursor->get(&key, &data, DB_LAST);
+    cursor->close();
+    return status == 0 ? recno : 0;
+}
+
+/**
+ * Start a scan of the whole file.
+ * @param file         the (open) file to scan
+ * @param bulk_blocks  size of the bulk read buffer, in blocks
+ * @param wanted       the blocks the scan is wanted for (nullptr for all of them)
+ */
+HeapFileScan::HeapFileScan(HeapFile &file, uint bulk_blocks, const vector<bool> *wanted)
+        : cursor(nullptr), buffer(nullptr), bulk(), records(nullptr), done(false), borrowed(false), file(file),
+          wanted(wanted), position(0), positioned(false) {
+    file.db.cursor(nullptr, &this->cursor, 0);
+    u_int32_t buffer_size = bulk_blocks * file.get_block_size(); // block sizes are multiples of 1024, as DB requires
+    if (file.scan_buffer_lent) {
+        this->buffer = new char[buffer_size];
+    } else {
+        if (file.scan_buffer.size() < buffer_size)
+            file.scan_buffer.resize(buffer_size);
+        file.scan_buffer_lent = this->borrowed = true;
+        this->buffer = file.scan_buffer.data();
+    }
+    this->bulk.set_data(this->buffer);
+    this->bulk.set_ulen(buffer_size);
+    this->bulk.set_flags(DB_DBT_USERMEM);
+}
+
+/**
+ * Close the cursor and give back (or free) the buffer.
+ */
+HeapFileScan::~HeapFileScan() {
+    delete this->records;
+    if (this->cursor != nullptr)
+        this->cursor->close();
+    if (this->borrowed)
+        this->file.scan_buffer_lent = false;
+    else
+        delete[] this->buffer;
+}
+
+/**
+ * Get the next wanted block, doing another bulk read when the blocks from the last one are used up.
+ * @param block_id  set to the next block's id
+ * @param block     set to the next block's bytes
+ * @return          false at the end of the file
+ */
+bool HeapFileScan::next(BlockID &block_id, Dbt &block) {
+    db_recno_t recno;
+    while (!this->done) {
+        if (this->records != nullptr && this->records->next(recno, block)) {
+            if (!is_wanted(recno))
+                continue;
+            block_id = recno;
+            return true;
+        }
+        delete this->records;
+        this->records = nullptr;
+        if (read(this->bulk))
+            this->records = new DbMultipleRecnoDataIterator(this->bulk);
+    }
+    return false;
+}
+
+/**
+ * Read the next run of blocks with one bulk read into the caller's buffer.
+ * @param morsel  the buffer to fill
+ * @return        false at the end of the file
+ */
+bool HeapFileScan::next_morsel(Dbt &morsel) {
+    return !this->done && read(morsel);
+}
+
+/**
+ * Do the next bulk read: from the first wanted block after the last one read, for as many blocks as are
+ * wanted in a row (the last block of a read has to share the buffer with the read's bookkeeping, so one
+ * more block's worth of room is asked for). A wanted block that was never written is passed over.
+ * @param buffer  a DB_DBT_USERMEM buffer, whose ulen is the most to read
+ * @return        false (and the scan is done) at the end of the file
+ */
+bool HeapFileScan::read(Dbt &buffer) {
+    u_int32_t capacity = buffer.get_ulen();
+    u_int32_t block_size = this->file.get_block_size();
+    while (true) {
+        BlockID start = this->position + 1;
+        while (start <= this->file.get_last_block_id() && !is_wanted(start))
+            start++;
+        if (start > this->file.get_last_block_id() && this->wanted != nullptr) {
+            this->done = true;
+            return false;
+        }
+        BlockID end = start;
+        while (end - start < capacity / block_size && is_wanted(end))
+            end++;
+        bool in_sequence = this->positioned ? start == this->position + 1 : start == 1;
+        u_int32_t flags = DB_MULTIPLE_KEY | (in_sequence ? DB_NEXT : DB_SET);
+        db_recno_t recno = start;
+        Dbt key(&recno, sizeof(recno));
+        buffer.set_ulen(min(capacity, (end - start + 1) * block_size));
+        int status = this->cursor->get(&key, &buffer, flags);
+        buffer.set_ulen(capacity);
+        if (status == 0) {
+            DbMultipleRecnoDataIterator blocks(buffer);
+            Dbt block;
+            while (blocks.next(recno, block)) {
+                this->position = recno;
+                this->file.scanned++;
+            }
+            this->positioned = true;
+            return true;
+        }
+        if (in_sequence) {
+            this->done = true;
+            return false;
+        }
+        this->position = start;  // a hole: nothing there, so go on from the next wanted block
+        this->positioned = false;
+    }
+}
+
 /**
  * Wrapper for Berkeley DB open, which does both open and creation.
  * @param flags BerkDb flags
@@ -123,9 +316,21 @@ uint32_t HeapFile::get_block_count() {
 void HeapFile::db_open(uint flags) {
     if (!this->closed)
         return;
-    this->db.set_re_len(DbBlock::BLOCK_SZ); // record length - will be ignored if file already exists
+    this->db.set_re_len(this->block_size); // record length - will be ignored if file already exists
     this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    this->db.get_re_len(&this->block_size); // an existing file keeps the block size it was created with
 
-    this->last = flags ? 0 : get_block_count();
     this->closed = false;
+    this->fsm.open(this->block_size);
+
+    // the high-water mark is the last block reserved; files from before it was kept go on from their highest block
+    this->reserved = this->fsm.get_high_water();
+    if (this->reserved == 0 && !flags)
+        this->reserved = get_highest_block_id();
+    // go on from the last block handed out if the file was closed, otherwise skip the rest of the extent
+    this->last = this->fsm.get_last();
+    if (this->last == 0 || this->last > this->reserved)
+        this->last = this->reserved;
+    else if (this->last < this->reserved)
+        this->fsm.set_high_water(this->reserved);  // not known again until closed
 }
\ No newline at end of file
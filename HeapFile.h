@@ -9,6 +9,7 @@
 
 #include "db_cxx.h"
 #include "SlottedPage.h"
+#include "FreeSpaceMap.h"
 
 
 /**
@@ -18,10 +19,22 @@
         database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
         for buffer management and file management.
         Uses SlottedPage for storing records within blocks.
+        Keeps a FreeSpaceMap of its blocks (in a file of its own) so inserts can reuse space freed by deletes.
+
+        New block ids are handed out from extents of EXTENT_BLOCKS ids. Only reserving an extent touches
+        the disk (the new high-water mark is written to the free space map's header); a new block itself
+        is first written whenever its page is. A block id that was handed out but never written reads as
+        an empty page. The last id handed out is recorded when the file is closed, so the next session goes
+        on from it; if the file wasn't closed, it goes on from the end of the reserved extent instead.
  */
 class HeapFile : public DbFile {
 public:
-    HeapFile(std::string name);
+    /**
+     * number of block ids reserved at a time
+     */
+    static const uint EXTENT_BLOCKS = 16;
+
+    HeapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ);
 
     virtual ~HeapFile() {}
 
@@ -45,9 +58,26 @@ public:
 
     virtual SlottedPage *get(BlockID block_id);
 
+    virtual bool get(BlockID block_id, void *buffer);
+
     virtual void put(DbBlock *block);
 
-    virtual BlockIDs *block_ids() const;
+    virtual BlockIDRange blocks() const;
+
+    /**
+     * Hand out the next block id without writing anything to the file (other than to reserve
+     * a new extent when the current one is used up).
+     * @return the new block's id
+     */
+    virtual BlockID allocate();
+
+    /**
+     * Hand out a given block id, which the caller knows isn't in use (e.g., one it numbers its blocks by),
+     * reserving extents through it if it is past the last one handed out.
+     * @param block_id  the block id
+     * @return          the block id
+     */
+    virtual BlockID allocate(BlockID block_id);
 
     /**
      * Get the id of the current final block in the heap file.
@@ -55,13 +85,138 @@ public:
      */
     virtual uint32_t get_last_block_id() { return last; }
 
+    /**
+     * Get the size of the blocks in this file. Once the file is open, this is the size it was created with.
+     * @return block size in bytes
+     */
+    virtual uint get_block_size() const { return block_size; }
+
+    /**
+     * Note how much free space a block has, after records were added to it or removed from it.
+     * @param block_id    the block
+     * @param free_bytes  its free space in bytes
+     */
+    virtual void set_free_space(BlockID block_id, u_int32_t free_bytes) { fsm.set(block_id, free_bytes); }
+
+    /**
+     * Number of blocks read by the scans of this file (see HeapFileScan) since it was constructed.
+     * @return  blocks read, including any a scan read without needing them
+     */
+    virtual u_long get_blocks_scanned() const { return scanned; }
+
+    /**
+     * Find a block that is known to have enough free space for a new record.
+     * @param needed  bytes needed (including the record's header)
+     * @return        a block id, or 0 if there is no such block
+     */
+    virtual BlockID find_free_space(u_int32_t needed) { return fsm.find(needed); }
+
 protected:
     std::string dbfilename;
+    u_int32_t block_size;
     uint32_t last;
+    uint32_t reserved;
+    std::vector<char> new_block;
     bool closed;
     Db db;
+    FreeSpaceMap fsm;
+    u_long scanned;
+    std::vector<char> scan_buffer;  // bulk read buffer, lent to one HeapFileScan at a time
+    bool scan_buffer_lent;
 
     virtual void db_open(uint flags = 0);
 
     virtual uint32_t get_block_count();
+
+    virtual BlockID get_highest_block_id();
+
+    void *empty_block();
+
+    friend class HeapFileScan;
+};
+
+
+/**
+ * @class HeapFileScan - sequential scan of all the blocks in a HeapFile
+ *
+ * Uses a Berkeley DB cursor with DB_MULTIPLE_KEY bulk retrieval, so each call into Berkeley DB pulls many
+ * blocks at once into one large buffer. The blocks handed out by next() point into that buffer, so they
+ * are only valid until the following call to next(). The file keeps the buffer from scan to scan and lends
+ * it to one scan at a time (one started while another is going on gets a buffer of its own). The scan
+ * reads the file as it is on disk: blocks cached in a BufferPool are to be read from there instead (see
+ * BufferPool::resident) and left out of the blocks the scan is wanted for.
+ *
+ * A scan can be told which blocks it is wanted for (e.g., those a ZoneMap can't rule out). It then skips
+ * over runs of unwanted blocks by positioning its cursor at the next wanted one, and sizes each bulk read
+ * to the run of wanted blocks it starts, so unwanted blocks are mostly not read at all; any that are
+ * read anyway are not handed out by next().
+ *
+ * A parallel scan shares one HeapFileScan among its workers and has each of them pull whole bulk reads
+ * ("morsels") into a buffer of its own with next_morsel(), taking turns (the Db handle is not opened
+ * for concurrent use). The two ways of reading are not to be mixed in one scan.
+ */
+class HeapFileScan {
+public:
+    /**
+     * number of blocks' worth of buffer space for each bulk read
+     */
+    static const uint DEFAULT_BULK_BLOCKS = 64;
+
+    /**
+     * Start a scan of the whole file.
+     * @param file         the (open) file to scan
+     * @param bulk_blocks  size of the bulk read buffer, in blocks
+     * @param wanted       if not null, (*wanted)[block_id - 1] is false for blocks the scan may skip
+     *                     (blocks past its end are wanted); must outlive the scan
+     */
+    HeapFileScan(HeapFile &file, uint bulk_blocks = DEFAULT_BULK_BLOCKS, const std::vector<bool> *wanted = nullptr);
+
+    virtual ~HeapFileScan();
+
+    HeapFileScan(const HeapFileScan &other) = delete;
+
+    HeapFileScan(HeapFileScan &&temp) = delete;
+
+    HeapFileScan &operator=(const HeapFileScan &other) = delete;
+
+    HeapFileScan &operator=(HeapFileScan &&temp) = delete;
+
+    /**
+     * Get the next block in the file.
+     * @param block_id  returned by reference: the block's id
+     * @param block     returned by reference: the block's bytes (within the scan's buffer)
+     * @returns         false if there are no more blocks
+     */
+    virtual bool next(BlockID &block_id, Dbt &block);
+
+    /**
+     * Get the next run of blocks in the file, as many as fit in the caller's buffer.
+     * @param morsel  the buffer (a DB_DBT_USERMEM Dbt at least one block long); read its blocks with a
+     *                DbMultipleRecnoDataIterator
+     * @returns       false if there are no more blocks
+     */
+    virtual bool next_morsel(Dbt &morsel);
+
+    /**
+     * Whether a block is one the scan is wanted for (the blocks of a morsel may include some that aren't).
+     * @param block_id  the block
+     * @returns         false if the block can be skipped
+     */
+    bool is_wanted(BlockID block_id) const {
+        return this->wanted == nullptr || block_id > this->wanted->size() || (*this->wanted)[block_id - 1];
+    }
+
+protected:
+    Dbc *cursor;
+    char *buffer;
+    Dbt bulk;
+    DbMultipleRecnoDataIterator *records;
+    bool done;
+    bool borrowed;       // buffer is the file's
+    HeapFile &file;
+    const std::vector<bool> *wanted;
+    BlockID position;    // the last block read (0 before the first read)
+    bool positioned;     // the cursor is at position
+
+    virtual bool read(Dbt &buffer);
 };
@@ -4,7 +4,15 @@
  * @see Seattle University, CPSC5300
  */
 #include <cstring>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "HeapTable.h"
+#include "ColumnTable.h"
+#include "BTree.h"
+#include "HashIndex.h"
+#include "BloomFilter.h"
 
 using namespace std;
 typedef uint16_t u16;
@@ -14,9 +22,24 @@ typedef uint16_t u16;
  * @param table_name
  * @param column_names
  * @param column_attributes
+ * @param block_size         page size to create the table's file with
  */
-HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes) : DbRelation(
-        table_name, column_names, column_attributes), file(table_name) {
+HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                     uint block_size) : DbRelation(table_name, column_names, column_attributes),
+                                        file(table_name, block_size), pool(file),
+                                        zones(table_name, this->column_attributes), column_types(),
+                                        column_offsets(), first_text(0), pooled_scanned(0) {
+    int offset = 0;
+    for (auto ca: this->column_attributes) {
+        this->column_types.push_back(ca.get_data_type());
+        this->column_offsets.push_back(offset);
+        if (offset >= 0 && ca.get_data_type() == ColumnAttribute::INT)
+            offset += sizeof(int32_t);
+        else
+            offset = -1;
+        if (offset >= 0)
+            this->first_text++;
+    }
 }
 
 /**
@@ -25,6 +48,7 @@ HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttr
  */
 void HeapTable::create() {
     file.create();
+    zones.create();
 }
 
 /**
@@ -43,6 +67,8 @@ void HeapTable::create_if_not_exists() {
  * Execute: DROP TABLE <table_name>
  */
 void HeapTable::drop() {
+    pool.discard();
+    zones.drop();
     file.drop();
 }
 
@@ -51,12 +77,15 @@ void HeapTable::drop() {
  */
 void HeapTable::open() {
     file.open();
+    zones.open(file.get_last_block_id());
 }
 
 /**
  * Closes the table. Disables: insert, update, delete, select, project
  */
 void HeapTable::close() {
+    pool.clear();
+    zones.close();
     file.close();
 }
 
@@ -66,13 +95,107 @@ void HeapTable::close() {
  * @return the handle of the inserted row
  */
 Handle HeapTable::insert(const ValueDict *row) {
+    Row full_row(&this->column_names);
+    validate(row, full_row);
+    return insert(&full_row);
+}
+
+/**
+ * Execute: INSERT INTO <table_name> VALUES (<row_values>)
+ * @param row the values of every column, in column order
+ * @return the handle of the inserted row
+ */
+Handle HeapTable::insert(const Row *row) {
     open();
-    ValueDict *full_row = validate(row);
-    Handle handle = append(full_row);
-    delete full_row;
+    if (row->size() != this->column_names.size())
+        throw DbRelationError("row does not have the columns of table '" + this->table_name + "'");
+    if (this->indices.empty())
+        return append(row);
+    index_check(Rows(1, *row));
+    Handle handle = append(row);
+    try {
+        index_insert(handle);
+    } catch (...) {
+        erase(handle);
+        throw;
+    }
     return handle;
 }
 
+/**
+ * Bulk load rows given as dictionaries.
+ * @param rows dictionaries with column name keys
+ * @return the handles of the inserted rows
+ */
+Handles *HeapTable::insert_many(const ValueDicts *rows) {
+    Rows full_rows(rows->size(), Row(&this->column_names));
+    for (size_t i = 0; i < rows->size(); i++)
+        validate((*rows)[i], full_rows[i]);
+    return insert_many(&full_rows);
+}
+
+/**
+ * Bulk load rows. Each block is filled in memory while it is pinned once and then left to the buffer
+ * pool, so it is written once; the free space map is consulted not at all and updated once per block.
+ * @param rows the values of every column of each row, in column order
+ * @return the handles of the inserted rows
+ */
+Handles *HeapTable::insert_many(const Rows *rows) {
+    open();
+    vector<u_int32_t> sizes;
+    sizes.reserve(rows->size());
+    for (auto const &row: *rows) {
+        if (row.size() != this->column_names.size())
+            throw DbRelationError("row does not have the columns of table '" + this->table_name + "'");
+        sizes.push_back(marshaled_size(&row));
+    }
+    index_check(*rows);
+
+    Handles *handles = new Handles();
+    handles->reserve(rows->size());
+    SlottedPage *block = nullptr;
+    try {
+        block = this->pool.fetch(this->file.get_last_block_id());
+        for (size_t i = 0; i < rows->size(); i++) {
+            RecordID record_id;
+            try {
+                marshal(&(*rows)[i], block->reserve(sizes[i], record_id));
+            } catch (DbBlockNoRoomError &e) {
+                this->file.set_free_space(block->get_block_id(), block->free_space());
+                this->pool.unpin(block, true);
+                block = nullptr;
+                block = this->pool.fetch_new();
+                marshal(&(*rows)[i], block->reserve(sizes[i], record_id));
+            }
+            handles->push_back(Handle(block->get_block_id(), record_id));
+            this->zones.add(block->get_block_id(), RowFieldReader((*rows)[i]));
+        }
+    } catch (...) {
+        if (block != nullptr) {
+            this->file.set_free_space(block->get_block_id(), block->free_space());
+            this->pool.unpin(block, true);
+        }
+        delete handles;
+        throw;
+    }
+    this->file.set_free_space(block->get_block_id(), block->free_space());
+    this->pool.unpin(block, true);
+    for (size_t i = 0; i < handles->size() && !this->indices.empty(); i++) {
+        try {
+            index_insert((*handles)[i]);
+        } catch (...) {
+            for (size_t j = 0; j < handles->size(); j++) {
+                if (j < i)
+                    index_del((*handles)[j]);
+                erase((*handles)[j]);
+            }
+            delete handles;
+            throw;
+        }
+    }
+    return handles;
+}
+
 /**
  * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
  * where handle is sufficient to identify one specific record (e.g., returned from an insert
@@ -81,7 +204,154 @@ Handle HeapTable::insert(const ValueDict *row) {
  * @param new_values a dictionary with column name keys
  */
 void HeapTable::update(const Handle handle, const ValueDict *new_values) {
-    throw DbRelationError("Not implemented");
+    open();
+    SlottedPage *home = this->pool.fetch(handle.first);
+    try {
+        update(home, handle.second, new_values);
+    } catch (...) {
+        this->file.set_free_space(handle.first, home->free_space());
+        this->pool.unpin(home, true);
+        throw;
+    }
+    this->file.set_free_space(handle.first, home->free_space());
+    this->pool.unpin(home, true);
+}
+
+/**
+ * Conceptually, execute: UPDATE <table_name> SET <new_values> WHERE <where>
+ * The selected rows come in block order, so all those in one block are updated while it is pinned once
+ * and the block is written back once.
+ * @param where the rows to be updated
+ * @param new_values a dictionary with column name keys
+ * @return the number of rows updated
+ */
+u_long HeapTable::update(const Predicate &where, const ValueDict *new_values) {
+    Handles *handles = select(where);
+    SlottedPage *home = nullptr;
+    try {
+        for (auto const &handle: *handles) {
+            if (home != nullptr && home->get_block_id() != handle.first) {
+                this->file.set_free_space(home->get_block_id(), home->free_space());
+                this->pool.unpin(home, true);
+                home = nullptr;
+            }
+            if (home == nullptr)
+                home = this->pool.fetch(handle.first);
+            update(home, handle.second, new_values);
+        }
+    } catch (...) {
+        if (home != nullptr) {
+            this->file.set_free_space(home->get_block_id(), home->free_space());
+            this->pool.unpin(home, true);
+        }
+        delete handles;
+        throw;
+    }
+    if (home != nullptr) {
+        this->file.set_free_space(home->get_block_id(), home->free_space());
+        this->pool.unpin(home, true);
+    }
+    u_long count = handles->size();
+    delete handles;
+    return count;
+}
+
+/**
+ * Update one row whose home block is pinned (and whose free space the caller records), along with the
+ * indices whose keys the update changes.
+ * @param home       the row's home block
+ * @param record_id  the row's record id in its home block
+ * @param new_values a dictionary with column name keys
+ */
+void HeapTable::update(SlottedPage *home, RecordID record_id, const ValueDict *new_values) {
+    Handle handle(home->get_block_id(), record_id);
+    bool reindex = index_update(handle, new_values);
+    try {
+        rewrite(home, record_id, new_values);
+    } catch (...) {
+        if (reindex)
+            index_insert(handle, new_values);
+        throw;
+    }
+    if (reindex)
+        index_insert(handle, new_values);
+}
+
+/**
+ * Rewrite one row whose home block is pinned (and whose free space the caller records).
+ * The row is rewritten in place if it still fits where it is. Otherwise a moved row goes back home if
+ * it now fits there, and a row that fits nowhere it has been is moved to another block, leaving (or
+ * repointing) a forwarding stub at home so its handle stays the same. Stubs never point at stubs.
+ * The row's new place is taken before its old one is given up, so a row that can't be rewritten is left as it was.
+ * @param home       the row's home block
+ * @param record_id  the row's record id in its home block
+ * @param new_values a dictionary with column name keys
+ */
+void HeapTable::rewrite(SlottedPage *home, RecordID record_id, const ValueDict *new_values) {
+    Handle target;
+    bool is_forwarded = home->forwarded(record_id, target);
+    SlottedPage *block = is_forwarded ? this->pool.fetch(target.first) : home;
+    RecordID id = is_forwarded ? target.second : record_id;
+    Row row(&this->column_names);
+    u_int32_t size = 0;
+    try {
+        RecordView data;
+        if (!block->view(id, data))
+            throw DbRelationError("no such row in table '" + this->table_name + "'");
+        unmarshal(data, row);
+        for (auto const &new_value: *new_values) {
+            int ordinal = Row::index(this->column_names, new_value.first);
+            if (ordinal < 0)
+                throw DbRelationError("table does not have column named '" + new_value.first + "'");
+            if (new_value.second.data_type != this->column_types[ordinal])
+                throw DbRelationError("wrong type of value for column '" + new_value.first + "'");
+            row[ordinal] = new_value.second;
+        }
+        this->zones.add(home->get_block_id(), RowFieldReader(row));
+        size = marshaled_size(&row);
+        marshal(&row, block->replace(id, size));  // in place (same block)
+        if (is_forwarded) {
+            this->file.set_free_space(block->get_block_id(), block->free_space());
+            this->pool.unpin(block, true);
+        }
+        return;
+    } catch (DbBlockNoRoomError &e) {
+        // doesn't fit where it is
+    } catch (...) {
+        if (is_forwarded)
+            this->pool.unpin(block);
+        throw;
+    }
+
+    if (is_forwarded) {
+        try {
+            try {
+                marshal(&row, home->replace(record_id, size));  // back home, replacing the stub
+            } catch (DbBlockNoRoomError &e) {
+                Handle stub(home->get_block_id(), record_id);
+                home->forward(record_id, append(&row, &stub));  // on to another block (a stub is repointed in place)
+            }
+        } catch (...) {
+            this->pool.unpin(block);
+            throw;
+        }
+        block->del(id);  // the old copy goes once the row is somewhere else
+        this->file.set_free_space(block->get_block_id(), block->free_space());
+        this->pool.unpin(block, true);
+        return;
+    }
+    Handle stub(home->get_block_id(), record_id);
+    Handle moved = append(&row, &stub);
+    try {
+        home->forward(record_id, moved);
+    } catch (DbBlockNoRoomError &e) {
+        // no room for the stub (the row was smaller than one): take the moved copy back out
+        SlottedPage *moved_block = this->pool.fetch(moved.first);
+        moved_block->del(moved.second);
+        this->file.set_free_space(moved.first, moved_block->free_space());
+        this->pool.unpin(moved_block, true);
+        throw DbRelationError("no room to move row in table '" + this->table_name + "'");
+    }
 }
 
 /**
@@ -92,12 +362,34 @@ void HeapTable::update(const Handle handle, const ValueDict *new_values) {
  */
 void HeapTable::del(const Handle handle) {
     open();
+    index_del(handle);
+    erase(handle);
+}
+
+/**
+ * Remove a row from the file (the indices are the caller's to take care of).
+ * @param handle the row to be removed
+ */
+void HeapTable::erase(const Handle handle) {
     BlockID block_id = handle.first;
     RecordID record_id = handle.second;
-    SlottedPage *block = this->file.get(block_id);
+    SlottedPage *block = this->pool.fetch(block_id);
+    Handle target;
+    if (block->forwarded(record_id, target)) {
+        SlottedPage *moved = this->pool.fetch(target.first);
+        moved->del(target.second);
+        this->file.set_free_space(target.first, moved->free_space());
+        this->pool.unpin(moved, true);
+    }
     block->del(record_id);
-    this->file.put(block);
-    delete block;
+    this->file.set_free_space(block_id, block->free_space());
+    try {
+        summarize(block);
+    } catch (...) {
+        this->pool.unpin(block, true);
+        throw;
+    }
+    this->pool.unpin(block, true);
 }
 
 /**
@@ -109,29 +401,249 @@ Handles *HeapTable::select() {
 }
 
 /**
- * The select command
- * @param where ignored for now FIXME
+ * The select command with equality conditions
+ * @param where  equality conditions the rows must meet (nullptr for all rows)
  * @return list of handles of the selected rows
  */
 Handles *HeapTable::select(const ValueDict *where) {
+    return select(Predicate(where, this->column_names, this->column_attributes));
+}
+
+/**
+ * The select command
+ * If an attached index narrows the where clause down, just the rows it finds are checked (from the index's own
+ * entries, if it has every column the where clause reads). Otherwise it is a
+ * sequential scan, skipping the blocks whose zones rule out the where clause: those cached in the buffer pool are
+ * read there, and the rest from the file in bulk (see HeapFileScan), in block order.
+ * The compiled where clause is evaluated against each record in place in the scanned block; no row is decoded.
+ * @param where  where clause the rows must meet
+ * @return list of handles of the selected rows
+ */
+Handles *HeapTable::select(const Predicate &where) {
     open();
+    vector<bool> used(this->column_names.size(), false);
+    where.uses(used);
+    Rows rows;
+    Handles *candidates = index_select(where, &used, &rows);
+    if (candidates != nullptr) {
+        try {
+            auto kept = candidates->begin();
+            for (uint i = 0; i < candidates->size(); i++) {
+                Handle handle = (*candidates)[i];
+                bool is_selected;
+                if (rows.size() == candidates->size()) {
+                    is_selected = where.evaluate(rows[i]);  // the index has every column the where clause reads
+                } else {
+                    RecordView data;
+                    SlottedPage *block = fetch(handle, data);
+                    is_selected = selected(data, where);
+                    this->pool.unpin(block);
+                }
+                if (is_selected)
+                    *kept++ = handle;
+            }
+            candidates->erase(kept, candidates->end());
+        } catch (...) {
+            delete candidates;
+            throw;
+        }
+        return candidates;
+    }
+    vector<bool> wanted = this->zones.candidates(where);
+    BlockIDs pooled = pooled_blocks(wanted);
+    auto next_pooled = pooled.begin();
     Handles *handles = new Handles();
-    BlockIDs *block_ids = file.block_ids();
-    for (auto const &block_id: *block_ids) {
-        SlottedPage *block = file.get(block_id);
-        RecordIDs *record_ids = block->ids();
-        for (auto const &record_id: *record_ids) {
-            Handle handle(block_id, record_id);
-            if (selected(handle, where))
-                handles->push_back(Handle(block_id, record_id));
+    try {
+        HeapFileScan scan(file, HeapFileScan::DEFAULT_BULK_BLOCKS, &wanted);
+        BlockID block_id;
+        Dbt block_dbt;
+        bool scanned = scan.next(block_id, block_dbt);
+        while (scanned || next_pooled != pooled.end()) {
+            if (next_pooled != pooled.end() && (!scanned || *next_pooled < block_id)) {
+                SlottedPage *block = this->pool.fetch(*next_pooled++);
+                select_block(*block, where, *handles);
+                this->pool.unpin(block);
+            } else {
+                SlottedPage block(block_dbt, block_id);
+                select_block(block, where, *handles);
+                scanned = scan.next(block_id, block_dbt);
+            }
         }
-        delete record_ids;
-        delete block;
+    } catch (...) {
+        delete handles;
+        throw;
     }
-    delete block_ids;
     return handles;
 }
 
+/**
+ * Take the blocks a scan is wanted for that are cached in the buffer pool out of the ones it is to read from
+ * the file; they are to be read from the pool instead. The rest are as they are in the file.
+ * @param wanted  the blocks the scan is wanted for (see HeapFileScan); the pooled ones are turned off
+ * @return        the pooled blocks, in order
+ */
+BlockIDs HeapTable::pooled_blocks(vector<bool> &wanted) {
+    BlockIDs pooled;
+    for (BlockID block_id: this->pool.resident()) {
+        if (block_id > wanted.size())
+            wanted.resize(block_id, true);  // blocks past the end of wanted are wanted
+        if (wanted[block_id - 1]) {
+            wanted[block_id - 1] = false;
+            pooled.push_back(block_id);
+        }
+    }
+    this->pooled_scanned += pooled.size();
+    return pooled;
+}
+
+/**
+ * Check the where clause against the records in a block, following any forwarding stubs through the buffer pool.
+ * @param block    the block
+ * @param where    where clause the rows must meet
+ * @param handles  the selected rows are appended here
+ */
+void HeapTable::select_block(SlottedPage &block, const Predicate &where, Handles &handles) {
+    RecordView data;
+    Handle target;
+    for (RecordID record_id: block.records()) {
+        if (block.view(record_id, data)) {
+            if (selected(data, where))
+                handles.push_back(Handle(block.get_block_id(), record_id));
+        } else if (block.forwarded(record_id, target)) {
+            SlottedPage *moved = this->pool.fetch(target.first);
+            bool is_selected = moved->view(target.second, data) && selected(data, where);
+            this->pool.unpin(moved);
+            if (is_selected)
+                handles.push_back(Handle(block.get_block_id(), record_id));
+        }
+    }
+}
+
+/**
+ * The select command, run by a pool of worker threads (morsel-driven).
+ * The blocks are read in bulk from one shared scan, a morsel at a time, into each worker's own buffer;
+ * the workers take turns at the scan but check the where clause in parallel. Forwarding stubs need
+ * the buffer pool, which is not shared between threads, so they are set aside and checked once the
+ * workers are done, along with the blocks cached in the pool (which the workers don't read from the file).
+ * Each worker's handles come out in block order, and merging them restores it.
+ * @param where    where clause the rows must meet
+ * @param workers  number of worker threads (0 for one per hardware thread)
+ * @return list of handles of the selected rows
+ */
+Handles *HeapTable::select(const Predicate &where, uint workers) {
+    if (workers == 0)
+        workers = max(thread::hardware_concurrency(), 1U);
+    open();
+    vector<Handles> selected_handles(workers), stubs(workers);
+    vector<bool> wanted = this->zones.candidates(where);
+    BlockIDs pooled = pooled_blocks(wanted);
+    exception_ptr error;
+    {
+        HeapFileScan scan(file, HeapFileScan::DEFAULT_BULK_BLOCKS, &wanted);
+        mutex scan_lock;
+        vector<thread> threads;
+        for (uint worker = 0; worker < workers; worker++) {
+            threads.push_back(thread([&, worker]() {
+                try {
+                    u_int32_t morsel_size = HeapFileScan::DEFAULT_BULK_BLOCKS * this->file.get_block_size();
+                    vector<char> buffer(morsel_size);
+                    Dbt morsel(buffer.data(), 0);
+                    morsel.set_ulen(morsel_size);
+                    morsel.set_flags(DB_DBT_USERMEM);
+                    while (true) {
+                        {
+                            lock_guard<mutex> lock(scan_lock);
+                            if (error || !scan.next_morsel(morsel))
+                                break;
+                        }
+                        select_morsel(morsel, scan, where, selected_handles[worker], stubs[worker]);
+                    }
+                } catch (...) {
+                    lock_guard<mutex> lock(scan_lock);
+                    if (!error)
+                        error = current_exception();
+                }
+            }));
+        }
+        for (auto &worker_thread: threads)
+            worker_thread.join();
+    }
+    if (error)
+        rethrow_exception(error);
+
+    Handles *handles = new Handles();
+    try {
+        for (BlockID block_id: pooled) {
+            SlottedPage *block = this->pool.fetch(block_id);
+            select_block(*block, where, *handles);
+            this->pool.unpin(block);
+        }
+        for (auto const &worker_handles: selected_handles)
+            handles->insert(handles->end(), worker_handles.begin(), worker_handles.end());
+        for (auto const &worker_stubs: stubs) {
+            for (auto const &stub: worker_stubs) {
+                RecordView data;
+                SlottedPage *block = fetch(stub, data);
+                bool is_selected = selected(data, where);
+                this->pool.unpin(block);
+                if (is_selected)
+                    handles->push_back(stub);
+            }
+        }
+        sort(handles->begin(), handles->end());
+    } catch (...) {
+        delete handles;
+        throw;
+    }
+    return handles;
+}
+
+/**
+ * Check the where clause against the records in a morsel of blocks. Runs in a select() worker thread,
+ * so it only reads the morsel and the table's schema.
+ * @param morsel   the blocks from one bulk read
+ * @param scan     the scan it came from (which says what blocks in it can be skipped)
+ * @param where    where clause the rows must meet
+ * @param handles  the selected rows are appended here
+ * @param stubs    forwarding stubs are appended here, to be checked later
+ */
+void HeapTable::select_morsel(Dbt &morsel, const HeapFileScan &scan, const Predicate &where, Handles &handles,
+                              Handles &stubs) const {
+    DbMultipleRecnoDataIterator blocks(morsel);
+    db_recno_t block_id;
+    Dbt block_dbt;
+    while (blocks.next(block_id, block_dbt)) {
+        if (!scan.is_wanted(block_id))
+            continue;
+        SlottedPage block(block_dbt, block_id);
+        RecordView data;
+        Handle target;
+        for (RecordID record_id: block.records()) {
+            if (block.view(record_id, data)) {
+                if (selected(data, where))
+                    handles.push_back(Handle(block_id, record_id));
+            } else if (block.forwarded(record_id, target)) {
+                stubs.push_back(Handle(block_id, record_id));
+            }
+        }
+    }
+}
+
+/**
+ * Vectorized scan of the table, or an index-only scan if an attached index that narrows the where clause
+ * down has every column the scan reads (see DbRelation::index_scan).
+ * @param column_names  columns to project (all of them if empty)
+ * @param where         where clause the rows must meet
+ * @return              the scan (freed by caller)
+ */
+DbRelationScan *HeapTable::scan(const ColumnNames *column_names, const Predicate &where) {
+    open();
+    DbRelationScan *index_only = index_scan(column_names, where);
+    if (index_only != nullptr)
+        return index_only;
+    return new HeapTableScan(*this, column_names, where);
+}
+
 /**
  * Project all columns from a given row.
  * @param handle row to be projected
@@ -148,154 +660,262 @@ ValueDict *HeapTable::project(Handle handle) {
  * @return a sequence of values for handle given by column_names
  */
 ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names) {
-    BlockID block_id = handle.first;
-    RecordID record_id = handle.second;
-    SlottedPage *block = file.get(block_id);
-    Dbt *data = block->get(record_id);
-    ValueDict *row = unmarshal(data);
-    delete data;
-    delete block;
     if (column_names->empty())
-        return row;
-    ValueDict *result = new ValueDict();
+        column_names = &this->column_names;
+    vector<uint> ordinals;
     for (auto const &column_name: *column_names) {
-        if (row->find(column_name) == row->end())
+        int ordinal = Row::index(this->column_names, column_name);
+        if (ordinal < 0)
             throw DbRelationError("table does not have column named '" + column_name + "'");
-        (*result)[column_name] = (*row)[column_name];
+        ordinals.push_back((uint) ordinal);
+    }
+
+    RecordView data;
+    SlottedPage *block = fetch(handle, data);
+    ValueDict *result = new ValueDict();
+    ValueView value;
+    for (uint i = 0; i < ordinals.size(); i++) {
+        view(data, ordinals[i], value);
+        value.materialize((*result)[(*column_names)[i]]);
     }
-    delete row;
+    pool.unpin(block);
     return result;
 }
 
+/**
+ * Project all columns from a given row into a positional Row.
+ * @param handle row to be projected
+ * @param row    where to put the values
+ */
+void HeapTable::project(Handle handle, Row &row) {
+    if (row.get_schema() != &this->column_names)
+        row = Row(&this->column_names);
+    RecordView data;
+    SlottedPage *block = fetch(handle, data);
+    unmarshal(data, row);
+    pool.unpin(block);
+}
+
+/**
+ * Pin the block a row is in, following its forwarding stub if it has moved.
+ * @param handle  the row
+ * @param data    set to the row's record (viewed in the block)
+ * @return        the pinned block holding the record (release with pool.unpin())
+ * @throws DbRelationError if there is no such row
+ */
+SlottedPage *HeapTable::fetch(Handle handle, RecordView &data) {
+    SlottedPage *block = this->pool.fetch(handle.first);
+    if (block->view(handle.second, data))
+        return block;
+    Handle target;
+    bool is_forwarded = block->forwarded(handle.second, target);
+    this->pool.unpin(block);
+    if (is_forwarded) {
+        block = this->pool.fetch(target.first);
+        if (block->view(target.second, data))
+            return block;
+        this->pool.unpin(block);
+    }
+    throw DbRelationError("no such row in table '" + this->table_name + "'");
+}
+
+/**
+ * Summarize a block's rows in its zone again (e.g., after one was deleted, which may narrow it).
+ * The rows that have moved out are read from where they are now.
+ * @param block  the block (pinned)
+ */
+void HeapTable::summarize(SlottedPage *block) {
+    this->zones.clear(block->get_block_id());
+    RecordView data;
+    Handle target;
+    for (RecordID record_id: block->records()) {
+        if (block->view(record_id, data)) {
+            this->zones.add(block->get_block_id(), RecordFieldReader(*this, data));
+        } else if (block->forwarded(record_id, target)) {
+            SlottedPage *moved = this->pool.fetch(target.first);
+            if (moved->view(target.second, data))
+                this->zones.add(block->get_block_id(), RecordFieldReader(*this, data));
+            this->pool.unpin(moved);
+        }
+    }
+}
+
 /**
  * Check if the given row is acceptable to insert.
  * @param row to be validated
- * @return the full row dictionary
+ * @param full_row where to put the row's values, in column order
  * @throws DbRelationError if not valid
  */
-ValueDict *HeapTable::validate(const ValueDict *row) const {
-    ValueDict *full_row = new ValueDict();
-    for (auto const &column_name: this->column_names) {
-        Value value;
-        ValueDict::const_iterator column = row->find(column_name);
-        if (column == row->end())
-            throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
-        else
-            value = column->second;
-        (*full_row)[column_name] = value;
-    }
-    return full_row;
+void HeapTable::validate(const ValueDict *row, Row &full_row) const {
+    if (!full_row.from_dict(row))
+        throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
 }
 
 /**
- * Appends a record to the file.
+ * Appends a record to the file, in a block the free space map says has room for it if there is one,
+ * otherwise in the last block (whose last few bytes the map's coarse classes can't promise), otherwise
+ * in a new block.
  * @param row to be appended
+ * @param home if not null, the row is being moved out of its home block and this is its stub's handle
  * @return handle of newly inserted row
  */
-Handle HeapTable::append(const ValueDict *row) {
-    Dbt *data = marshal(row);
-    SlottedPage *block = this->file.get(this->file.get_last_block_id());
+Handle HeapTable::append(const Row *row, const Handle *home) {
+    u_int32_t size = marshaled_size(row);
+    u_int32_t needed = size + 4;  // record plus its header
+    if (home != nullptr)
+        needed += SlottedPage::FORWARD_SZ;
+    SlottedPage *block = nullptr;
     RecordID record_id;
-    try {
-        record_id = block->add(data);
-    } catch (DbBlockNoRoomError &e) {
+    BlockID block_id;
+    while (block == nullptr && (block_id = this->file.find_free_space(needed)) != 0) {
+        block = this->pool.fetch(block_id);
+        try {
+            marshal(row, block->reserve(size, record_id, home));
+        } catch (DbBlockNoRoomError &e) {
+            // free space map was stale (e.g., not flushed); correct it and look again
+            this->file.set_free_space(block_id, block->free_space());
+            this->pool.unpin(block);
+            block = nullptr;
+        }
+    }
+    if (block == nullptr) {
+        block = this->pool.fetch(this->file.get_last_block_id());
+        try {
+            marshal(row, block->reserve(size, record_id, home));
+        } catch (DbBlockNoRoomError &e) {
+            this->pool.unpin(block);
+            block = nullptr;
+        }
+    }
+    if (block == nullptr) {
         // need a new block
-        delete block;
-        block = this->file.get_new();
-        record_id = block->add(data);
+        block = this->pool.fetch_new();
+        try {
+            marshal(row, block->reserve(size, record_id, home));
+        } catch (DbBlockNoRoomError &e) {
+            this->file.set_free_space(block->get_block_id(), block->free_space());
+            this->pool.unpin(block, true);
+            throw;
+        }
     }
-    this->file.put(block);
-    delete block;
-    delete[] (char *) data->get_data();
-    delete data;
-    return Handle(this->file.get_last_block_id(), record_id);
+    block_id = block->get_block_id();
+    this->file.set_free_space(block_id, block->free_space());
+    this->pool.unpin(block, true);
+    if (home == nullptr)
+        this->zones.add(block_id, RowFieldReader(*row));  // a moved row is in its home block's zone already
+    return Handle(block_id, record_id);
 }
 
 /**
- * Figure out the bits to go into the file.
- * The caller is responsible for freeing the returned Dbt and its enclosed ret->get_data().
+ * Figure out how many bytes the row will take in the file (the first phase of marshaling).
+ * Everything that could make marshal() fail is checked here, before any space is taken for the record.
  * @param row data for the tuple
- * @return bits of the record as it should appear on disk
+ * @return size of the record as it should appear on disk
+ * @throws DbRelationError if the row can't be marshaled or won't fit in a block
  */
-Dbt *HeapTable::marshal(const ValueDict *row) const {
-    char *bytes = new char[DbBlock::BLOCK_SZ]; // more than we need (we insist that one row fits into DbBlock::BLOCK_SZ)
-    uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        ValueDict::const_iterator column = row->find(column_name);
-        Value value = column->second;
+u_int32_t HeapTable::marshaled_size(const Row *row) const {
+    u_int32_t max_size = SlottedPage::max_row_size(this->file.get_block_size());
+    u_long size = 0;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        ColumnAttribute ca = this->column_attributes[col_num];
+        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+            size += sizeof(int32_t);
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
+            u_long length = (*row)[col_num].s.length();
+            if (length > UINT16_MAX)
+                throw DbRelationError("text field too long to marshal");
+            size += sizeof(u16) + length;
+        } else {
+            throw DbRelationError("Only know how to marshal INT and TEXT");
+        }
+        if (size > max_size)
+            throw DbRelationError("row too big to marshal");
+    }
+    return (u_int32_t) size;
+}
 
+/**
+ * Write the bits to go into the file straight into the space reserved for the record.
+ * @param row data for the tuple
+ * @param record where to put the record (marshaled_size(row) bytes)
+ */
+void HeapTable::marshal(const Row *row, void *record) const {
+    char *bytes = (char *) record;
+    uint offset = 0;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        ColumnAttribute ca = this->column_attributes[col_num];
+        const Value &value = (*row)[col_num];
         if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            if (offset + 4 > DbBlock::BLOCK_SZ - 4)
-                throw DbRelationError("row too big to marshal");
             *(int32_t *) (bytes + offset) = value.n;
             offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u_long size = value.s.length();
-            if (size > UINT16_MAX)
-                throw DbRelationError("text field too long to marshal");
-            if (offset + 2 + size > DbBlock::BLOCK_SZ)
-                throw DbRelationError("row too big to marshal");
+        } else {
+            u16 size = (u16) value.s.length();
             *(u16 *) (bytes + offset) = size;
             offset += sizeof(u16);
-            memcpy(bytes + offset, value.s.c_str(), size); // assume ascii for now
+            memcpy(bytes + offset, value.s.data(), size); // assume ascii for now
             offset += size;
-        } else {
-            throw DbRelationError("Only know how to marshal INT and TEXT");
         }
     }
-    char *right_size_bytes = new char[offset];
-    memcpy(right_size_bytes, bytes, offset);
-    delete[] bytes;
-    Dbt *data = new Dbt(right_size_bytes, offset);
-    return data;
 }
 
 /**
  * Figure out the memory data structures from the given bits gotten from the file.
- * @param data file data for the tuple
- * @return row data for the tuple
+ * @param data file data for the tuple (viewed in place in its block)
+ * @param row  where to put the row data for the tuple (its memory is reused)
  */
-ValueDict *HeapTable::unmarshal(Dbt *data) const {
-    ValueDict *row = new ValueDict();
-    Value value;
-    char *bytes = (char *) data->get_data();
+void HeapTable::unmarshal(const RecordView &data, Row &row) const {
+    const char *bytes = data.data;
     uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        value.data_type = ca.get_data_type();
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        Value &value = row[col_num];
+        value.data_type = this->column_types[col_num];
+        if (value.data_type == ColumnAttribute::DataType::INT) {
             value.n = *(int32_t *) (bytes + offset);
             offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
+        } else if (value.data_type == ColumnAttribute::DataType::TEXT) {
             u16 size = *(u16 *) (bytes + offset);
             offset += sizeof(u16);
-            char buffer[DbBlock::BLOCK_SZ];
-            memcpy(buffer, bytes + offset, size);
-            buffer[size] = '\0';
-            value.s = string(buffer);  // assume ascii for now
+            value.s.assign(bytes + offset, size);  // assume ascii for now
             offset += size;
         } else {
             throw DbRelationError("Only know how to unmarshal INT and TEXT");
         }
-        (*row)[column_name] = value;
     }
-    return row;
 }
 
 /**
- * See if the row at the given handle satisfies the given where clause
- * @param handle  row to check
- * @param where   conditions to check
- * @return        true if conditions met, false otherwise
+ * Look at one field of a record in place, without decoding the fields that don't lead up to it.
+ * @param data     the record (viewed in its block)
+ * @param ordinal  which column
+ * @param value    set to the field's value (a TEXT still points into the block)
  */
-bool HeapTable::selected(Handle handle, const ValueDict *where) {
-    if (where == nullptr)
-        return true;
-    ValueDict *row = this->project(handle, where);
-    return *row == *where;
+void HeapTable::view(const RecordView &data, uint ordinal, ValueView &value) const {
+    uint col_num = ordinal < this->first_text ? ordinal : this->first_text;
+    uint offset = (uint) this->column_offsets[col_num];
+    for (; col_num < ordinal; col_num++) {
+        if (this->column_types[col_num] == ColumnAttribute::INT)
+            offset += sizeof(int32_t);
+        else
+            offset += sizeof(u16) + *(u16 *) (data.data + offset);
+    }
+    value.data_type = this->column_types[ordinal];
+    if (value.data_type == ColumnAttribute::INT) {
+        value.n = *(int32_t *) (data.data + offset);
+    } else {
+        value.length = *(u16 *) (data.data + offset);
+        value.s = data.data + offset + sizeof(u16);
+    }
+}
+
+/**
+ * See if the given record satisfies the given where clause. Only the fields in the clause are looked at,
+ * and they are compared in place.
+ * @param data   record to check (viewed in its block)
+ * @param where  compiled where clause
+ * @return       true if conditions met, false otherwise
+ */
+bool HeapTable::selected(const RecordView &data, const Predicate &where) const {
+    return where.is_true() || where.evaluate(RecordFieldReader(*this, data));
 }
 
 /**
@@ -309,6 +929,158 @@ void test_set_row(ValueDict &row, int a, string b) {
     row["b"] = Value(b);
 }
 
+/**
+ * Start a vectorized scan. The table has to be open already (see HeapTable::scan).
+ * @param table         the table to scan
+ * @param column_names  columns to project (all of them if empty)
+ * @param where         where clause the rows must meet
+ * @throws DbRelationError if the table has no such column
+ */
+HeapTableScan::HeapTableScan(HeapTable &table, const ColumnNames *column_names, const Predicate &where)
+        : table(table), column_names(*column_names), ordinals(), decoded(),
+          where(where), wanted(table.zones.candidates(where)), pooled(table.pooled_blocks(this->wanted)),
+          next_pooled(0), file_scan(table.file, HeapFileScan::DEFAULT_BULK_BLOCKS, &this->wanted), scanned_id(0),
+          scanned_block(), scanned(false), block(nullptr), pinned(false), record_ids(), next_record(0), columns(),
+          handles(), selection() {
+    if (this->column_names.empty())
+        this->column_names = table.column_names;
+    vector<bool> used(table.column_names.size(), false);
+    for (auto const &column_name: this->column_names) {
+        int ordinal = Row::index(table.column_names, column_name);
+        if (ordinal < 0)
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        this->ordinals.push_back((uint) ordinal);
+        used[ordinal] = true;
+    }
+    where.uses(used);
+    for (uint ordinal = 0; ordinal < used.size(); ordinal++) {
+        this->columns.push_back(ColumnVector(table.column_types[ordinal]));
+        if (used[ordinal])
+            this->decoded.push_back(ordinal);
+    }
+    this->handles.reserve(Batch::CAPACITY);
+    this->selection.reserve(Batch::CAPACITY);
+}
+
+HeapTableScan::~HeapTableScan() {
+    release_block();
+}
+
+/**
+ * Get the next batch of qualifying rows: decode a batch of records, evaluate the where clause over it,
+ * and gather the selected rows' projected values. Decoded batches with no qualifying rows are skipped.
+ * @param batch  refilled with the projected columns of the next qualifying rows
+ * @return       false when the table is exhausted
+ */
+bool HeapTableScan::next(Batch &batch) {
+    if (batch.column_names != this->column_names) {
+        batch.column_names = this->column_names;
+        batch.columns.clear();
+        for (uint ordinal: this->ordinals)
+            batch.columns.push_back(ColumnVector(this->table.column_types[ordinal]));
+    }
+    batch.clear();
+    while (true) {
+        uint size = fill();
+        if (size == 0)
+            return false;
+        this->where.evaluate(this->columns, size, this->selection);
+        if (this->selection.empty())
+            continue;
+        for (uint j = 0; j < this->ordinals.size(); j++)
+            batch.columns[j].gather(this->columns[this->ordinals[j]], this->selection);
+        for (u_int16_t i: this->selection)
+            batch.handles.push_back(this->handles[i]);
+        return true;
+    }
+}
+
+/**
+ * Decode up to Batch::CAPACITY records into the column vectors, moving on through the file's blocks
+ * as each is used up. A forwarding stub is decoded from the record it points at (through the buffer pool).
+ * @return  number of records decoded (0 at the end of the file)
+ */
+uint HeapTableScan::fill() {
+    for (auto ordinal: this->decoded)
+        this->columns[ordinal].clear();
+    this->handles.clear();
+    RecordView data;
+    Handle target;
+    while (this->handles.size() < Batch::CAPACITY) {
+        if (this->block == nullptr || this->next_record == this->record_ids.size()) {
+            if (!next_block())
+                break;
+            continue;
+        }
+        RecordID record_id = this->record_ids[this->next_record++];
+        if (this->block->view(record_id, data)) {
+            decode(data);
+        } else if (this->block->forwarded(record_id, target)) {
+            SlottedPage *moved = this->table.pool.fetch(target.first);
+            bool found = moved->view(target.second, data);
+            if (found)
+                decode(data);
+            this->table.pool.unpin(moved);
+            if (!found)
+                continue;
+        } else {
+            continue;
+        }
+        this->handles.push_back(Handle(this->block->get_block_id(), record_id));
+    }
+    return (uint) this->handles.size();
+}
+
+/**
+ * Move on to the next block: whichever comes first of the next one cached in the buffer pool and the next one
+ * the file scan reads.
+ * @return  false at the end of the table
+ */
+bool HeapTableScan::next_block() {
+    release_block();
+    if (!this->scanned)
+        this->scanned = this->file_scan.next(this->scanned_id, this->scanned_block);
+    if (this->next_pooled < this->pooled.size()
+        && (!this->scanned || this->pooled[this->next_pooled] < this->scanned_id)) {
+        this->block = this->table.pool.fetch(this->pooled[this->next_pooled++]);
+        this->pinned = true;
+    } else if (this->scanned) {
+        this->block = new SlottedPage(this->scanned_block, this->scanned_id);
+        this->scanned = false;
+    } else {
+        return false;
+    }
+    this->record_ids.clear();
+    for (RecordID record_id: this->block->records())
+        this->record_ids.push_back(record_id);
+    this->next_record = 0;
+    return true;
+}
+
+/**
+ * Let go of the block being decoded, if any.
+ */
+void HeapTableScan::release_block() {
+    if (this->pinned)
+        this->table.pool.unpin(this->block);
+    else
+        delete this->block;
+    this->block = nullptr;
+    this->pinned = false;
+}
+
+/**
+ * Append a record's values to the column vectors being decoded.
+ * @param data  the record
+ */
+void HeapTableScan::decode(const RecordView &data) {
+    ValueView value;
+    for (auto ordinal: this->decoded) {
+        this->table.view(data, ordinal, value);
+        this->columns[ordinal].append(value);
+    }
+}
+
 /**
  * Test helper. Compares row to expected values for columns a and b.
  * @param table    relation where row is
@@ -338,6 +1110,36 @@ bool test_heap_storage() {
         return assertion_failure("slotted page tests failed");
     cout << endl << "slotted page tests ok" << endl;
 
+    if (!test_buffer_pool())
+        return assertion_failure("buffer pool tests failed");
+    cout << "buffer pool tests ok" << endl;
+
+    if (!test_free_space_map())
+        return assertion_failure("free space map tests failed");
+    cout << "free space map tests ok" << endl;
+
+    if (!test_zone_map())
+        return assertion_failure("zone map tests failed");
+    cout << "zone map tests ok" << endl;
+
+    if (!test_predicate())
+        return assertion_failure("predicate tests failed");
+    cout << "predicate tests ok" << endl;
+
+    if (!test_column_table())
+        return assertion_failure("column table tests failed");
+    cout << "column table tests ok" << endl;
+
+    if (!test_btree())
+        return assertion_failure("btree tests failed");
+    cout << "btree tests ok" << endl;
+    if (!test_hash_index())
+        return assertion_failure("hash index tests failed");
+    cout << "hash index tests ok" << endl;
+    if (!test_bloom_filter())
+        return assertion_failure("bloom filter tests failed");
+    cout << "bloom filter tests ok" << endl;
+
     ColumnNames column_names;
     column_names.push_back("a");
     column_names.push_back("b");
@@ -381,7 +1183,8 @@ bool test_heap_storage() {
         if (!test_compare(table, handle, i++, b))
             return false;
     }
-    cout << "many inserts/select/projects ok" << endl;
+    cout << "many inserts/select/projects ok (buffer pool hits " << table.get_buffer_pool().get_hits()
+         << ", misses " << table.get_buffer_pool().get_misses() << ")" << endl;
     delete handles;
 
     table.del(last_handle);
@@ -394,7 +1197,362 @@ bool test_heap_storage() {
             return false;
     }
     cout << "del ok" << endl;
+
+    // positional rows go in and come back out without a dictionary
+    Row positional(&column_names);
+    positional[0] = Value(12345);
+    positional[1] = Value(b);
+    Handle positional_handle = table.insert(&positional);
+    positional[0] = Value(0);
+    table.project(positional_handle, positional);
+    if (positional[0].n != 12345 || positional[1].s != b || !test_compare(table, positional_handle, 12345, b))
+        return assertion_failure("positional row");
+    table.del(positional_handle);
+    cout << "positional row ok" << endl;
+
+    // narrow projections and where clauses only look at the fields they name, including ones after a TEXT
+    ColumnNames wide_names = {"a", "b", "c"};
+    ColumnAttributes wide_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                        ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable wide("_test_projection_cpp", wide_names, wide_attributes);
+    wide.create();
+    for (int i = 0; i < 10; i++) {
+        ValueDict wide_row;
+        wide_row["a"] = Value(i);
+        wide_row["b"] = Value(string((size_t) i, 'b'));
+        wide_row["c"] = Value(-i);
+        wide.insert(&wide_row);
+    }
+    ValueDict where;
+    where["b"] = Value(string(7, 'b'));
+    u_long fetches = wide.get_buffer_pool().get_hits() + wide.get_buffer_pool().get_misses();
+    u_long writes = wide.get_buffer_pool().get_writes();
+    Handles *wide_handles = wide.select(&where);
+    fetches = wide.get_buffer_pool().get_hits() + wide.get_buffer_pool().get_misses() - fetches;
+    if (fetches != 1 || wide.get_buffer_pool().get_writes() != writes)  // its one block, cached in the pool
+        return assertion_failure("select fetched pages more than once, or flushed them", fetches);
+    if (wide_handles->size() != 1)
+        return assertion_failure("where on TEXT", wide_handles->size());
+    ColumnNames narrow = {"c", "a"};
+    ValueDict *result = wide.project(wide_handles->front(), &narrow);
+    bool narrow_ok = result->size() == 2 && (*result)["c"].n == -7 && (*result)["a"].n == 7;
+    delete result;
+    delete wide_handles;
+    where["c"] = Value(-6);
+    wide_handles = wide.select(&where);
+    narrow_ok = narrow_ok && wide_handles->empty();
+    delete wide_handles;
+    wide.drop();
+    if (!narrow_ok)
+        return assertion_failure("narrow projection or where after a TEXT");
+    cout << "narrow projection ok" << endl;
+
+    // updates: in place while the row fits, else moved behind a forwarding stub so the handle holds
+    HeapTable updated("_test_update_cpp", column_names, column_attributes);
+    updated.create();
+    Handles update_handles;
+    for (int i = 0; i < 20; i++) {
+        test_set_row(row, i, b);
+        update_handles.push_back(updated.insert(&row));
+    }
+    Handle first = update_handles.front();
+    ValueDict new_values;
+    new_values["a"] = Value(100);
+    new_values["b"] = Value(string("short"));
+    updated.update(first, &new_values);
+    if (!test_compare(updated, first, 100, "short"))
+        return assertion_failure("update in place");
+    string longer(1000, 'L');
+    new_values["b"] = Value(longer);
+    for (auto const &handle: update_handles)
+        updated.update(handle, &new_values);  // the first block can't hold all of them any more
+    for (auto const &handle: update_handles)
+        if (!test_compare(updated, handle, 100, longer))
+            return assertion_failure("update moved row", handle.first, handle.second);
+    Handles *all = updated.select();
+    bool same_handles = *all == update_handles;
+    delete all;
+    all = updated.select(Predicate(), 3);  // the stubs are checked after the workers finish
+    same_handles = same_handles && *all == update_handles;
+    delete all;
+    DbRelationScan *moved_scan = updated.scan(&column_names, Predicate());
+    Batch moved_batch;
+    ValueView moved_value;
+    same_handles = same_handles && moved_scan->next(moved_batch) && moved_batch.handles == update_handles;
+    if (same_handles) {
+        moved_batch.columns[1].view(moved_batch.size() - 1, moved_value);
+        same_handles = moved_value == Value(longer) && !moved_scan->next(moved_batch);
+    }
+    delete moved_scan;
+    if (!same_handles)
+        return assertion_failure("select after moving updates");
+    new_values["b"] = Value(string(2000, 'M'));  // moved rows move again; stubs still point straight at them
+    new_values["a"] = Value(7);
+    ValueDict update_where;
+    update_where["a"] = Value(100);
+    if (updated.update(Predicate(&update_where, column_names, column_attributes), &new_values) != update_handles.size())
+        return assertion_failure("update where count");
+    if (!test_compare(updated, update_handles.back(), 7, string(2000, 'M')))
+        return assertion_failure("update of moved row");
+    new_values["b"] = Value(string("back home"));
+    updated.update(update_handles.back(), &new_values);
+    if (!test_compare(updated, update_handles.back(), 7, "back home"))
+        return assertion_failure("update of moved row back home");
+    for (auto const &handle: update_handles)
+        updated.del(handle);
+    all = updated.select();
+    bool none_left = all->empty();
+    delete all;
+    if (!none_left)
+        return assertion_failure("delete of moved rows");
+    updated.drop();
+    cout << "update ok" << endl;
+
+    // bulk load packs the rows into blocks and writes each block once
+    HeapTable bulk("_test_insert_many_cpp", column_names, column_attributes);
+    bulk.create();
+    ValueDicts bulk_rows;
+    for (int i = 0; i < 1000; i++) {
+        bulk_rows.push_back(new ValueDict());
+        test_set_row(*bulk_rows.back(), i, b);
+    }
+    Handles *bulk_handles = bulk.insert_many(&bulk_rows);
+    bool bulk_ok = bulk_handles->size() == 1000;
+    for (int i = 0; bulk_ok && i < 1000; i += 99)
+        bulk_ok = test_compare(bulk, (*bulk_handles)[i], i, b);
+    BlockID bulk_blocks = bulk_handles->back().first;
+    delete bulk_handles;
+    bulk.close();
+    if (!bulk_ok || bulk.get_buffer_pool().get_writes() != bulk_blocks)
+        return assertion_failure("insert_many", bulk.get_buffer_pool().get_writes(), bulk_blocks);
+    bulk_rows.back()->erase("b");
+    try {
+        bulk_handles = bulk.insert_many(&bulk_rows);
+        return assertion_failure("insert_many of an invalid batch did not throw");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    for (auto const &bulk_row: bulk_rows)
+        delete bulk_row;
+    bulk_handles = bulk.select();
+    bulk_ok = bulk_handles->size() == 1000;
+    delete bulk_handles;
+    ValueDict bulk_where;
+    bulk_where["a"] = Value(500);
+    Predicate bulk_predicate(&bulk_where, column_names, column_attributes);
+    bulk_handles = bulk.select(bulk_predicate, 4);
+    Handles *serial_handles = bulk.select(bulk_predicate);
+    bulk_ok = bulk_ok && bulk_handles->size() == 1 && *bulk_handles == *serial_handles;
+    delete serial_handles;
+    delete bulk_handles;
+    bulk.drop();
+    if (!bulk_ok)
+        return assertion_failure("invalid batch was partly inserted");
+    cout << "insert_many ok" << endl;
+
+    // vectorized scans: batches of up to Batch::CAPACITY rows, filtered and projected column by column
+    HeapTable batched("_test_batch_scan_cpp", column_names, column_attributes);
+    batched.create();
+    Rows batch_rows;
+    Row batch_row(&column_names);
+    string texts[] = {"x", "yy", "zzz"};
+    for (int i = 0; i < 3000; i++) {
+        batch_row[0] = Value(i);
+        batch_row[1] = Value(texts[i % 3]);
+        batch_rows.push_back(batch_row);
+    }
+    delete batched.insert_many(&batch_rows);
+    ValueDict batch_where;
+    batch_where["b"] = Value(string("x"));
+    Predicate batch_predicate(&batch_where, column_names, column_attributes);
+    ColumnNames a_only = {"a"};
+    DbRelationScan *batch_scan = batched.scan(&a_only, batch_predicate);
+    Batch batch;
+    Handles scanned;
+    int next_a = 0;
+    bool batch_ok = true;
+    while (batch_scan->next(batch)) {
+        batch_ok = batch_ok && batch.size() <= Batch::CAPACITY && batch.columns.size() == 1;
+        for (uint j = 0; batch_ok && j < batch.size(); j++, next_a += 3)
+            batch_ok = batch.columns[0].ints[j] == next_a;
+        scanned.insert(scanned.end(), batch.handles.begin(), batch.handles.end());
+    }
+    delete batch_scan;
+    Handles *batch_handles = batched.select(batch_predicate);
+    batch_ok = batch_ok && next_a == 3000 && scanned == *batch_handles && batch.size() == 0;
+    delete batch_handles;
+    ColumnNames all_columns;
+    batch_scan = batched.scan(&all_columns, Predicate());
+    uint batches = 0, rows_scanned = 0;
+    ValueView text;
+    while (batch_scan->next(batch)) {
+        batches++;
+        batch.columns[1].view(batch.size() - 1, text);
+        batch_ok = batch_ok && text == Value(texts[(rows_scanned + batch.size() - 1) % 3]);
+        rows_scanned += batch.size();
+    }
+    delete batch_scan;
+    batched.drop();
+    if (!batch_ok || rows_scanned != 3000 || batches != 3)
+        return assertion_failure("batch scan", rows_scanned, batches);
+    cout << "batch scan ok" << endl;
+
+    // scans read the blocks cached in the buffer pool from there, changes and all, and only the rest from the file
+    HeapTable cached("_test_cached_scan_cpp", column_names, column_attributes);
+    cached.create();
+    Rows cached_rows;
+    for (int i = 0; i < 1000; i++) {
+        batch_row[0] = Value(i);
+        batch_row[1] = Value(string(500, 'c'));
+        cached_rows.push_back(batch_row);
+    }
+    Handles *cached_handles = cached.insert_many(&cached_rows);  // more blocks than the pool holds
+    ValueDict cached_update;
+    cached_update["b"] = Value(string("u"));
+    Handles changed;
+    for (int i = 0; i < 1000; i += 100) {
+        cached.update((*cached_handles)[i], &cached_update);  // its block is in the pool, changed
+        changed.push_back((*cached_handles)[i]);
+    }
+    delete cached_handles;
+    u_long cached_writes = cached.get_buffer_pool().get_writes();
+    Predicate b_is_u(&cached_update, column_names, column_attributes);
+    cached_handles = cached.select(b_is_u);
+    bool cached_ok = *cached_handles == changed;
+    delete cached_handles;
+    cached_handles = cached.select(b_is_u, 3);
+    cached_ok = cached_ok && *cached_handles == changed;
+    delete cached_handles;
+    Handles cached_scanned;
+    batch_scan = cached.scan(&a_only, b_is_u);
+    while (batch_scan->next(batch))
+        cached_scanned.insert(cached_scanned.end(), batch.handles.begin(), batch.handles.end());
+    delete batch_scan;
+    cached_ok = cached_ok && cached_scanned == changed && cached.get_buffer_pool().get_writes() == cached_writes;
+    cached.drop();
+    if (!cached_ok)
+        return assertion_failure("scans of cached and uncached blocks");
+    cout << "cached scan ok" << endl;
+
+    // zone maps: a where clause on clustered data only reads the blocks that could have its rows
+    HeapTable zoned("_test_zone_map_table_cpp", column_names, column_attributes);
+    zoned.create();
+    Rows zoned_rows;
+    for (int i = 0; i < 3000; i++) {
+        batch_row[0] = Value(i);
+        batch_row[1] = Value(string(100, texts[i % 3][0]));
+        zoned_rows.push_back(batch_row);
+    }
+    Handles *zoned_handles = zoned.insert_many(&zoned_rows);
+    BlockID zoned_blocks = zoned_handles->back().first;
+    Handle last_zoned = zoned_handles->back();
+    delete zoned_handles;
+    ValueDict zoned_where;
+    zoned_where["a"] = Value(1500);
+    Predicate a_is_1500(&zoned_where, column_names, column_attributes);
+    u_long scanned_before = zoned.get_blocks_scanned();
+    zoned_handles = zoned.select(a_is_1500);
+    bool zoned_ok = zoned_handles->size() == 1 && test_compare(zoned, zoned_handles->front(), 1500, string(100, 'x'));
+    u_long blocks_read = zoned.get_blocks_scanned() - scanned_before;
+    Handles *parallel_handles = zoned.select(a_is_1500, 3);
+    zoned_ok = zoned_ok && *parallel_handles == *zoned_handles;
+    delete parallel_handles;
+    DbRelationScan *zoned_scan = zoned.scan(&a_only, a_is_1500);
+    zoned_ok = zoned_ok && zoned_scan->next(batch) && batch.handles == *zoned_handles && !zoned_scan->next(batch);
+    delete zoned_scan;
+    delete zoned_handles;
+    if (!zoned_ok || zoned_blocks < 20 || blocks_read > 2)
+        return assertion_failure("select skipping blocks by zone", blocks_read, zoned_blocks);
+    zoned_where["a"] = Value(2999);  // the greatest a in the last block, until it is deleted
+    zoned.del(last_zoned);
+    scanned_before = zoned.get_blocks_scanned();
+    zoned_handles = zoned.select(&zoned_where);
+    zoned_ok = zoned_handles->empty() && zoned.get_blocks_scanned() == scanned_before;
+    delete zoned_handles;
+    ValueDict zoned_update;
+    zoned_update["a"] = Value(5000);
+    zoned_where["a"] = Value(10);
+    zoned.update(Predicate(&zoned_where, column_names, column_attributes), &zoned_update);
+    zoned_where["a"] = Value(5000);
+    zoned_handles = zoned.select(&zoned_where);  // found in a block whose zone the update widened
+    zoned_ok = zoned_ok && zoned_handles->size() == 1 && zoned_handles->front().first == 1;
+    delete zoned_handles;
+    zoned.close();
+    scanned_before = zoned.get_blocks_scanned();
+    zoned_handles = zoned.select(a_is_1500);  // zones survive closing
+    zoned_ok = zoned_ok && zoned_handles->size() == 1 && zoned.get_blocks_scanned() - scanned_before <= 2;
+    delete zoned_handles;
+    zoned.drop();
+    if (!zoned_ok)
+        return assertion_failure("zone map after delete, update or reopening");
+    cout << "zone map ok" << endl;
+
+    // delete-and-reinsert churn reuses the freed space instead of growing the file
+    BlockID last_block_id = handles->back().first;
+    for (int round = 0; round < 3; round++) {
+        for (size_t j = 0; j < handles->size(); j += 2)
+            table.del((*handles)[j]);
+        for (size_t j = 0; j < handles->size(); j += 2) {
+            test_set_row(row, (int) j, b);
+            (*handles)[j] = table.insert(&row);
+            if ((*handles)[j].first > last_block_id)
+                return assertion_failure("churn grew the file", (*handles)[j].first, last_block_id);
+        }
+    }
+    cout << "free space reuse ok" << endl;
     table.drop();
     delete handles;
+
+    HeapTable big_table("_test_page_size_cpp", column_names, column_attributes, 4 * DbBlock::BLOCK_SZ);
+    big_table.create();
+    for (int i = 0; i < 1000; i++) {
+        test_set_row(row, i, b);
+        last_handle = big_table.insert(&row);
+    }
+    if (last_handle.first != 1000 / (4 * DbBlock::BLOCK_SZ / (b.size() + 10)) + 1)
+        return assertion_failure("rows per 16K page", last_handle.first);
+    if (!test_compare(big_table, last_handle, 999, b))
+        return false;
+    big_table.drop();
+
+    // the biggest row leaves room in its block for the block's header, its record header and a forwarding prefix
+    HeapTable small_table("_test_max_row_cpp", column_names, column_attributes);
+    small_table.create();
+    u_int32_t max_b = SlottedPage::max_row_size(DbBlock::BLOCK_SZ) - sizeof(int32_t) - sizeof(u16);
+    test_set_row(row, 1, string(max_b, 'm'));
+    last_handle = small_table.insert(&row);
+    if (!test_compare(small_table, last_handle, 1, string(max_b, 'm')))
+        return assertion_failure("biggest row");
+    test_set_row(row, 2, string(max_b + 1, 'm'));
+    try {
+        small_table.insert(&row);
+        return assertion_failure("row too big for a block with room to move it was inserted");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+
+    // growing a row past what it can be moved with is refused and leaves the row as it was
+    test_set_row(row, 2, "x");
+    Handle grown = small_table.insert(&row);
+    test_set_row(row, 3, "y");
+    Handle neighbor = small_table.insert(&row);
+    string grown_b = "x";
+    for (u_int32_t size = max_b - 7; size <= max_b + 8; size++) {
+        ValueDict grow;
+        grow["b"] = Value(string(size, 'g'));
+        try {
+            small_table.update(grown, &grow);
+            if (size > max_b)
+                return assertion_failure("row grown too big to move was updated", size);
+            grown_b = string(size, 'g');
+        } catch (DbRelationError &e) {
+            if (size <= max_b)
+                return assertion_failure("row grown to fit a block was not updated", size);
+        }
+        if (!test_compare(small_table, grown, 2, grown_b) || !test_compare(small_table, neighbor, 3, "y"))
+            return assertion_failure("row after growing it", size);
+    }
+    small_table.drop();
+    cout << "page size ok" << endl;
     return true;
 }
\ No newline at end of file
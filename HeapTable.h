@@ -10,14 +10,32 @@
 #include "storage_engine.h"
 #include "SlottedPage.h"
 #include "HeapFile.h"
+#include "BufferPool.h"
+#include "Predicate.h"
+#include "ZoneMap.h"
 
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ * Rows are handled internally as positional Rows; the ValueDict forms of insert() and project()
+ * convert at the edge. Callers on hot paths can use the Row forms directly and reuse one Row per scan.
+ *
+ * A single field is found in a record without decoding the ones before it when they are all INTs
+ * (their offsets are worked out from the schema once); otherwise only the lengths of the TEXTs in between
+ * are read. Projecting a few columns decodes just those, and where-clause checks compare TEXTs in place.
+ *
+ * Handles are stable across updates: a row that outgrows its block is moved to another one and a
+ * forwarding stub is left in its place (see SlottedPage), which every access through the handle follows.
+ *
+ * A ZoneMap summarizes the rows of each block. The scans for a where clause only read the blocks whose
+ * zones don't rule it out. select(where) looks up the rows in an attached index instead when one helps,
+ * and a scan whose columns an index covers reads only the index.
  */
 
 class HeapTable : public DbRelation {
 public:
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              uint block_size = DbBlock::BLOCK_SZ);
 
     virtual ~HeapTable() {}
 
@@ -41,32 +59,200 @@ public:
 
     virtual Handle insert(const ValueDict *row);
 
+    /**
+     * Insert a row that already has a value for every column, in column order.
+     * @param row  the new row (its schema must be this table's columns)
+     * @returns    a handle to the new row
+     */
+    virtual Handle insert(const Row *row);
+
+    /**
+     * Bulk load: insert a batch of rows, packing them into blocks at the end of the file.
+     * The whole batch is validated before anything is inserted.
+     * @param rows  the new rows, each with a value for every column
+     * @returns     handles to the new rows, in order (freed by caller)
+     */
+    virtual Handles *insert_many(const ValueDicts *rows);
+
+    /**
+     * Bulk load: insert a batch of rows, packing them into blocks at the end of the file.
+     * The whole batch is validated before anything is inserted.
+     * @param rows  the new rows, in column order (their schema must be this table's columns)
+     * @returns     handles to the new rows, in order (freed by caller)
+     */
+    virtual Handles *insert_many(const Rows *rows);
+
     virtual void update(const Handle handle, const ValueDict *new_values);
 
+    /**
+     * Conceptually, execute: UPDATE <table_name> SET <new_values> WHERE <where>
+     * @param where       which rows to update
+     * @param new_values  a dictionary keyed by column names for changing columns
+     * @returns           number of rows updated
+     */
+    virtual u_long update(const Predicate &where, const ValueDict *new_values);
+
     virtual void del(const Handle handle);
 
     virtual Handles *select();
 
     virtual Handles *select(const ValueDict *where);
 
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+     * @param where  compiled where clause (see Predicate)
+     * @returns      a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const Predicate &where);
+
+    /**
+     * Parallel form of select(where): worker threads pull morsels of blocks from one shared scan
+     * and each checks the where clause against the records in its own pages.
+     * @param where    compiled where clause (see Predicate)
+     * @param workers  number of worker threads (0 for one per hardware thread)
+     * @returns        the same handles as select(where), in the same order (freed by caller)
+     */
+    virtual Handles *select(const Predicate &where, uint workers);
+
     virtual ValueDict *project(Handle handle);
 
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
+    /**
+     * Read all the values of a row into the given Row, reusing its memory.
+     * @param handle  row to get values from
+     * @param row     where to put them (given this table's schema if it doesn't already have it)
+     */
+    virtual void project(Handle handle, Row &row);
+
     using DbRelation::project;
 
+    virtual DbRelationScan *scan(const ColumnNames *column_names, const Predicate &where);
+
+    /**
+     * Access the buffer pool caching this table's blocks (e.g., for its hit and miss counters).
+     * @return  the buffer pool
+     */
+    virtual const BufferPool &get_buffer_pool() const { return pool; }
+
+    /**
+     * Number of blocks the table's scans have read, from its file or its buffer pool (e.g., to see how many its
+     * zone map saved).
+     * @return  blocks read
+     */
+    virtual u_long get_blocks_scanned() const { return file.get_blocks_scanned() + pooled_scanned; }
+
 protected:
+    /**
+     * The fields of a record, viewed in place in its block, for evaluating a Predicate.
+     */
+    class RecordFieldReader : public FieldReader {
+    public:
+        RecordFieldReader(const HeapTable &table, const RecordView &data) : table(table), data(data) {}
+
+        virtual void read(uint ordinal, ValueView &value) const { table.view(data, ordinal, value); }
+
+    protected:
+        const HeapTable &table;
+        const RecordView &data;
+    };
+
     HeapFile file;
+    BufferPool pool;
+    ZoneMap zones;
+    std::vector<ColumnAttribute::DataType> column_types;
+    std::vector<int> column_offsets;  // offset of each column in a record, or -1 if it follows a TEXT
+    uint first_text;                  // ordinal of the first TEXT column (or number of columns if none)
+    u_long pooled_scanned;            // blocks the scans have read from the buffer pool instead of the file
+
+    virtual void view(const RecordView &data, uint ordinal, ValueView &value) const;
+
+    virtual void validate(const ValueDict *row, Row &full_row) const;
+
+    virtual void update(SlottedPage *home, RecordID record_id, const ValueDict *new_values);
+
+    virtual void rewrite(SlottedPage *home, RecordID record_id, const ValueDict *new_values);
+
+    virtual void erase(const Handle handle);
+
+    virtual SlottedPage *fetch(Handle handle, RecordView &data);
 
-    virtual ValueDict *validate(const ValueDict *row) const;
+    virtual void summarize(SlottedPage *block);
+
+    virtual Handle append(const Row *row, const Handle *home = nullptr);
+
+    virtual u_int32_t marshaled_size(const Row *row) const;
+
+    virtual void marshal(const Row *row, void *record) const;
+
+    virtual void unmarshal(const RecordView &data, Row &row) const;
+
+    virtual bool selected(const RecordView &data, const Predicate &where) const;
+
+    virtual BlockIDs pooled_blocks(std::vector<bool> &wanted);
+
+    virtual void select_block(SlottedPage &block, const Predicate &where, Handles &handles);
+
+    virtual void select_morsel(Dbt &morsel, const HeapFileScan &scan, const Predicate &where, Handles &handles,
+                               Handles &stubs) const;
+
+    friend class HeapTableScan;
+};
+
+/**
+ * @class HeapTableScan - vectorized scan of a HeapTable (see DbRelation::scan)
+ *
+ * Reads the blocks in bulk (see HeapFileScan) and decodes Batch::CAPACITY records at a time straight
+ * out of them into column vectors, one for each column that is projected or that the where clause
+ * reads. The where clause is then evaluated over the whole batch and the projection kernel gathers the
+ * qualifying rows' values into the caller's Batch. No Row or ValueDict is built, and the vectors are
+ * reused from batch to batch. Blocks the table's zone map rules out are not read, and those cached in the
+ * table's buffer pool are read there rather than from the file.
+ */
+class HeapTableScan : public DbRelationScan {
+public:
+    HeapTableScan(HeapTable &table, const ColumnNames *column_names, const Predicate &where);
+
+    virtual ~HeapTableScan();
+
+    HeapTableScan(const HeapTableScan &other) = delete;
+
+    HeapTableScan(HeapTableScan &&temp) = delete;
+
+    HeapTableScan &operator=(const HeapTableScan &other) = delete;
+
+    HeapTableScan &operator=(HeapTableScan &&temp) = delete;
+
+    virtual bool next(Batch &batch);
+
+protected:
+    HeapTable &table;
+    ColumnNames column_names;
+    std::vector<uint> ordinals;         // table ordinal of each projected column
+    std::vector<uint> decoded;          // table ordinals of the columns to decode
+    Predicate where;
+    std::vector<bool> wanted;           // the blocks the table's zone map doesn't rule out, to read from the file
+    BlockIDs pooled;                    // and those to read from the buffer pool
+    uint next_pooled;                   // position in pooled of the next one to decode
+    HeapFileScan file_scan;
+    BlockID scanned_id;                 // the next block from the file scan, once it has been read
+    Dbt scanned_block;
+    bool scanned;
+    SlottedPage *block;                 // the block being decoded, within the file scan's buffer or pinned in the pool
+    bool pinned;
+    RecordIDs record_ids;               // its records
+    uint next_record;                   // position in record_ids of the next one to decode
+    std::vector<ColumnVector> columns;  // the decoded values, one vector per table ordinal
+    Handles handles;                    // the decoded rows
+    Selection selection;
 
-    virtual Handle append(const ValueDict *row);
+    virtual uint fill();
 
-    virtual Dbt *marshal(const ValueDict *row) const;
+    virtual bool next_block();
 
-    virtual ValueDict *unmarshal(Dbt *data) const;
+    virtual void release_block();
 
-    virtual bool selected(Handle handle, const ValueDict *where);
+    virtual void decode(const RecordView &data);
 };
 
 bool test_heap_storage();
@@ -211,6 +211,20 @@ string ParseTreeToString::insert(const InsertStatement *stmt) {
 
 string ParseTreeToString::create(const CreateStatement *stmt) {
     string ret("CREATE ");
+    if (stmt->type == CreateStatement::kIndex) {
+        ret += string("INDEX ") + stmt->indexName + " ON " + stmt->tableName;
+        if (stmt->indexType != nullptr)
+            ret += string(" USING ") + stmt->indexType;
+        ret += " (";
+        bool doComma = false;
+        for (char *col : *stmt->indexColumns) {
+            if (doComma)
+                ret += ", ";
+            ret += col;
+            doComma = true;
+        }
+        return ret + ")";
+    }
     if (stmt->type != CreateStatement::kTable)
         return ret + "...";
     ret += "TABLE ";
@@ -234,6 +248,8 @@ string ParseTreeToString::drop(const DropStatement *stmt) {
         case DropStatement::kTable:
             ret += "TABLE ";
             break;
+        case DropStatement::kIndex:
+            return ret + "INDEX " + stmt->indexName + " FROM " + stmt->name;
         default:
             ret += "? ";
     }
@@ -251,7 +267,7 @@ string ParseTreeToString::show(const ShowStatement *stmt) {
             ret += string("COLUMNS FROM ") + stmt->tableName;
             break;
         case ShowStatement::kIndex:
-            ret += "INDEX";
+            ret += string("INDEX FROM ") + stmt->tableName;
             break;
         default:
             ret += "?what?";
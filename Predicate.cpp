@@ -0,0 +1,736 @@
+/**
+ * @file Predicate.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include "Predicate.h"
+#include "SlottedPage.h"
+#include "SQLParser.h"
+
+using namespace std;
+using namespace hsql;
+
+/**
+ * Compile equality conditions into a chain of comparisons joined by AND.
+ * @param where              values keyed by column name (nullptr for none)
+ * @param column_names       the relation's columns
+ * @param column_attributes  their types
+ */
+Predicate::Predicate(const ValueDict *where, const ColumnNames &column_names,
+                     const ColumnAttributes &column_attributes) : program() {
+    if (where == nullptr)
+        return;
+    vector<uint> jumps;
+    for (auto const &condition: *where) {
+        if (!this->program.empty())
+            jumps.push_back(jump(JUMP_IF_FALSE));
+        uint i = 0;
+        while (i < column_names.size() && column_names[i] != condition.first)
+            i++;
+        if (i == column_names.size())
+            throw DbRelationError("table does not have column named '" + condition.first + "'");
+        ColumnAttribute column_attribute = column_attributes[i];
+        if (condition.second.data_type != column_attribute.get_data_type())
+            throw DbRelationError("where clause compares a column with a value of the wrong type");
+        compare(EQ, i, condition.second);
+    }
+    for (uint j: jumps)
+        land(j);
+}
+
+/**
+ * Compile a parsed where clause.
+ * @param where              the where clause (nullptr for none)
+ * @param column_names       the relation's columns
+ * @param column_attributes  their types
+ */
+Predicate::Predicate(const Expr *where, const ColumnNames &column_names,
+                     const ColumnAttributes &column_attributes) : program() {
+    if (where != nullptr)
+        compile(where, column_names, column_attributes);
+}
+
+/**
+ * Run the program.
+ * @param fields  the row's fields
+ * @return        the result flag at the end of the program
+ */
+bool Predicate::evaluate(const FieldReader &fields) const {
+    bool result = true;
+    ValueView value;
+    uint pc = 0;
+    while (pc < this->program.size()) {
+        const Instruction &instruction = this->program[pc++];
+        switch (instruction.op) {
+            case NOT:
+                result = !result;
+                break;
+            case JUMP_IF_FALSE:
+                if (!result)
+                    pc = instruction.target;
+                break;
+            case JUMP_IF_TRUE:
+                if (result)
+                    pc = instruction.target;
+                break;
+            default:
+                fields.read(instruction.ordinal, value);
+                int comparison = value.compare(instruction.operand);
+                switch (instruction.op) {
+                    case EQ:
+                        result = comparison == 0;
+                        break;
+                    case NE:
+                        result = comparison != 0;
+                        break;
+                    case LT:
+                        result = comparison < 0;
+                        break;
+                    case LE:
+                        result = comparison <= 0;
+                        break;
+                    case GT:
+                        result = comparison > 0;
+                        break;
+                    default:
+                        result = comparison >= 0;
+                }
+        }
+    }
+    return result;
+}
+
+/**
+ * Look at a field of the row.
+ * @param ordinal  which column
+ * @param value    set to the field's value (a TEXT points into the row's string)
+ */
+void RowFieldReader::read(uint ordinal, ValueView &value) const {
+    const Value &field = this->row[ordinal];
+    value.data_type = field.data_type;
+    value.n = field.n;
+    value.s = field.s.data();
+    value.length = (u_int16_t) field.s.length();
+}
+
+/**
+ * Run the program against a decoded row.
+ * @param row  a row of the relation the predicate was compiled for
+ * @return     the result flag at the end of the program
+ */
+bool Predicate::evaluate(const Row &row) const {
+    return evaluate(RowFieldReader(row));
+}
+
+/**
+ * Comparison kernel: compare each value of an INT vector with a literal, for the rows that are active
+ * at this point in the program (those with resume[i] <= pc).
+ */
+template<typename Compare>
+static void compare_ints(const int32_t *values, int32_t operand, uint size, uint pc, const uint *resume,
+                         u_int8_t *result) {
+    Compare compare;
+    for (uint i = 0; i < size; i++) {
+        u_int8_t outcome = compare(values[i], operand);
+        result[i] = resume[i] <= pc ? outcome : result[i];
+    }
+}
+
+/**
+ * Comparison kernel for a TEXT vector: compares the bytes of each value with the literal in place.
+ */
+template<typename Compare>
+static void compare_texts(const ColumnVector &column, const string &operand, uint size, uint pc,
+                          const uint *resume, u_int8_t *result) {
+    Compare compare;
+    const char *bytes = column.bytes.data();
+    const u_int32_t *offsets = column.offsets.data();
+    for (uint i = 0; i < size; i++) {
+        if (resume[i] > pc)
+            continue;
+        size_t length = offsets[i + 1] - offsets[i];
+        int comparison = memcmp(bytes + offsets[i], operand.data(), min(length, operand.size()));
+        if (comparison == 0)
+            comparison = length < operand.size() ? -1 : length > operand.size() ? 1 : 0;
+        result[i] = compare(comparison, 0);
+    }
+}
+
+template<typename Compare>
+static void compare_vector(const ColumnVector &column, const Value &operand, uint size, uint pc,
+                           const uint *resume, u_int8_t *result) {
+    if (column.data_type == ColumnAttribute::INT)
+        compare_ints<Compare>(column.ints.data(), operand.n, size, pc, resume, result);
+    else
+        compare_texts<Compare>(column, operand.s, size, pc, resume, result);
+}
+
+/**
+ * Run the program over a batch, one instruction at a time for all the rows.
+ * A row that takes a jump gets its resume point set to the jump's target; until then it is left out.
+ * @param columns    the rows' values by column ordinal
+ * @param size       number of rows
+ * @param selection  set to the rows whose result flag ends up set
+ */
+void Predicate::evaluate(const vector<ColumnVector> &columns, uint size, Selection &selection) const {
+    u_int8_t result[Batch::CAPACITY];
+    uint resume[Batch::CAPACITY];
+    fill(result, result + size, 1);
+    fill(resume, resume + size, 0);
+    for (uint pc = 0; pc < this->program.size(); pc++) {
+        const Instruction &instruction = this->program[pc];
+        switch (instruction.op) {
+            case NOT:
+                for (uint i = 0; i < size; i++)
+                    result[i] ^= resume[i] <= pc;
+                break;
+            case JUMP_IF_FALSE:
+            case JUMP_IF_TRUE: {
+                u_int8_t jump_on = instruction.op == JUMP_IF_TRUE;
+                for (uint i = 0; i < size; i++)
+                    if (resume[i] <= pc && result[i] == jump_on)
+                        resume[i] = instruction.target;
+                break;
+            }
+            case EQ:
+                compare_vector<equal_to<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume, result);
+                break;
+            case NE:
+                compare_vector<not_equal_to<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume,
+                                                  result);
+                break;
+            case LT:
+                compare_vector<less<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume, result);
+                break;
+            case LE:
+                compare_vector<less_equal<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume,
+                                                result);
+                break;
+            case GT:
+                compare_vector<greater<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume, result);
+                break;
+            default:
+                compare_vector<greater_equal<int>>(columns[instruction.ordinal], instruction.operand, size, pc, resume,
+                                                   result);
+        }
+    }
+    selection.clear();
+    for (uint i = 0; i < size; i++)
+        if (result[i])
+            selection.push_back((u_int16_t) i);
+}
+
+/**
+ * Mark the column ordinals of the program's comparisons.
+ * @param used  the flags to set
+ */
+void Predicate::uses(vector<bool> &used) const {
+    for (auto const &instruction: this->program)
+        if (instruction.op != NOT && instruction.op != JUMP_IF_FALSE && instruction.op != JUMP_IF_TRUE)
+            used[instruction.ordinal] = true;
+}
+
+/**
+ * Check a summary of a set of rows against the predicate.
+ * @param summary  what is known about the rows' values
+ * @return         false only if none of the rows can satisfy it
+ */
+bool Predicate::may_match(const FieldSummary &summary) const {
+    return may_match(summary, (uint) this->program.size());
+}
+
+/**
+ * Run the program over the result flags a set of rows could have rather than one row's. A comparison
+ * the summary can't settle goes both ways, so at each point of the program the flag may be true, false
+ * or either. Jumps only go forward, so one pass from the start finds every flag the end is reached with.
+ * @param summary    what is known about the rows' values
+ * @param falsified  a comparison taken to be false for every row (program size for none)
+ * @return           true if the end can be reached with the flag set
+ */
+bool Predicate::may_match(const FieldSummary &summary, uint falsified) const {
+    vector<u_int8_t> reach(this->program.size() + 1, 0);  // possible outcomes on arriving at each instruction
+    reach[0] = MAY_BE_TRUE;
+    for (uint pc = 0; pc < this->program.size(); pc++) {
+        u_int8_t results = reach[pc];
+        if (results == 0)
+            continue;
+        const Instruction &instruction = this->program[pc];
+        switch (instruction.op) {
+            case NOT:
+                reach[pc + 1] |= ((results & MAY_BE_TRUE) ? MAY_BE_FALSE : 0) |
+                                 ((results & MAY_BE_FALSE) ? MAY_BE_TRUE : 0);
+                break;
+            case JUMP_IF_FALSE:
+            case JUMP_IF_TRUE: {
+                u_int8_t jumping = instruction.op == JUMP_IF_TRUE ? MAY_BE_TRUE : MAY_BE_FALSE;
+                reach[instruction.target] |= results & jumping;
+                reach[pc + 1] |= results & ~jumping;
+                break;
+            }
+            default:
+                reach[pc + 1] |= pc == falsified ? MAY_BE_FALSE : outcomes(instruction, summary);
+        }
+    }
+    return (reach.back() & MAY_BE_TRUE) != 0;
+}
+
+/**
+ * A summary that knows nothing about the rows, so every comparison goes both ways.
+ */
+class NoFieldSummary : public FieldSummary {
+public:
+    virtual bool range(uint ordinal, int32_t &min, int32_t &max) const { return false; }
+
+    virtual bool may_contain(uint ordinal, const Value &value) const { return true; }
+};
+
+/**
+ * A comparison of the column bounds its values if the predicate can't be satisfied when the comparison
+ * is false: then every row that satisfies it has the comparison true. The bounds of all such comparisons
+ * are intersected. A < or > of an INT is made inclusive by moving it by one; for a TEXT it is left
+ * inclusive (a little wider than it needs to be).
+ * @param ordinal  which column
+ * @param min      set to the least value, if there is one
+ * @param has_min  set to whether there is one
+ * @param max      set to the greatest value, if there is one
+ * @param has_max  set to whether there is one
+ */
+void Predicate::bounds(uint ordinal, Value &min, bool &has_min, Value &max, bool &has_max) const {
+    has_min = has_max = false;
+    NoFieldSummary unknown;
+    for (uint pc = 0; pc < this->program.size(); pc++) {
+        const Instruction &instruction = this->program[pc];
+        if (instruction.ordinal != ordinal || instruction.op == NE || instruction.op >= NOT)
+            continue;
+        if (may_match(unknown, pc))
+            continue;  // the predicate can be satisfied without it
+        Value operand = instruction.operand;
+        bool is_int = operand.data_type == ColumnAttribute::INT;
+        if (instruction.op == EQ || instruction.op == GT || instruction.op == GE) {
+            if (instruction.op == GT && is_int) {
+                if (operand.n == INT32_MAX) {
+                    // nothing is greater: an empty range
+                    min = Value(INT32_MAX);
+                    max = Value(INT32_MIN);
+                    has_min = has_max = true;
+                    return;
+                }
+                operand.n++;
+            }
+            if (!has_min || min < operand)
+                min = operand;
+            has_min = true;
+        }
+        operand = instruction.operand;
+        if (instruction.op == EQ || instruction.op == LT || instruction.op == LE) {
+            if (instruction.op == LT && is_int) {
+                if (operand.n == INT32_MIN) {
+                    min = Value(INT32_MAX);
+                    max = Value(INT32_MIN);
+                    has_min = has_max = true;
+                    return;
+                }
+                operand.n--;
+            }
+            if (!has_max || operand < max)
+                max = operand;
+            has_max = true;
+        }
+    }
+}
+
+/**
+ * The outcomes a comparison could have for some row of a summarized set. An INT column's range settles
+ * all the comparisons; a TEXT column's summary can only say that no row equals the literal.
+ * @param instruction  the comparison
+ * @param summary      what is known about the rows' values
+ * @return             MAY_BE_TRUE and/or MAY_BE_FALSE
+ */
+u_int8_t Predicate::outcomes(const Instruction &instruction, const FieldSummary &summary) {
+    const int32_t k = instruction.operand.n;
+    int32_t lo, hi;
+    bool may_be_true = true, may_be_false = true;
+    if (instruction.operand.data_type == ColumnAttribute::INT) {
+        if (summary.range(instruction.ordinal, lo, hi)) {
+            switch (instruction.op) {
+                case EQ:
+                case NE:
+                    may_be_true = lo <= k && k <= hi;
+                    may_be_false = lo != k || hi != k;
+                    if (instruction.op == NE)
+                        swap(may_be_true, may_be_false);
+                    break;
+                case LT:
+                    may_be_true = lo < k;
+                    may_be_false = hi >= k;
+                    break;
+                case LE:
+                    may_be_true = lo <= k;
+                    may_be_false = hi > k;
+                    break;
+                case GT:
+                    may_be_true = hi > k;
+                    may_be_false = lo <= k;
+                    break;
+                default:
+                    may_be_true = hi >= k;
+                    may_be_false = lo < k;
+            }
+        }
+    } else if (instruction.op == EQ) {
+        may_be_true = summary.may_contain(instruction.ordinal, instruction.operand);
+    } else if (instruction.op == NE) {
+        may_be_false = summary.may_contain(instruction.ordinal, instruction.operand);
+    }
+    return (u_int8_t) ((may_be_true ? MAY_BE_TRUE : 0) | (may_be_false ? MAY_BE_FALSE : 0));
+}
+
+/**
+ * Append the code for an expression that leaves its truth in the result flag.
+ * @param expr               the expression
+ * @param column_names       the relation's columns
+ * @param column_attributes  their types
+ * @throws DbRelationError   if the expression is not supported
+ */
+void Predicate::compile(const Expr *expr, const ColumnNames &column_names, const ColumnAttributes &column_attributes) {
+    if (expr->type != kExprOperator)
+        throw DbRelationError("where clause must be a comparison or a combination of comparisons");
+    switch (expr->opType) {
+        case Expr::AND:
+        case Expr::OR: {
+            compile(expr->expr, column_names, column_attributes);
+            uint skip = jump(expr->opType == Expr::AND ? JUMP_IF_FALSE : JUMP_IF_TRUE);
+            compile(expr->expr2, column_names, column_attributes);
+            land(skip);
+            break;
+        }
+        case Expr::NOT:
+            compile(expr->expr, column_names, column_attributes);
+            this->program.push_back(Instruction{NOT, 0, Value(), 0});
+            break;
+        case Expr::BETWEEN: {
+            if (expr->exprList == nullptr || expr->exprList->size() != 2)
+                throw DbRelationError("BETWEEN needs a lower and an upper bound");
+            compare(GE, expr->expr, (*expr->exprList)[0], column_names, column_attributes);
+            uint skip = jump(JUMP_IF_FALSE);
+            compare(LE, expr->expr, (*expr->exprList)[1], column_names, column_attributes);
+            land(skip);
+            break;
+        }
+        case Expr::IN: {
+            if (expr->exprList == nullptr || expr->exprList->empty())
+                throw DbRelationError("IN needs a list of values");
+            vector<uint> jumps;
+            for (auto const &item: *expr->exprList) {
+                if (item != expr->exprList->front())
+                    jumps.push_back(jump(JUMP_IF_TRUE));
+                compare(EQ, expr->expr, item, column_names, column_attributes);
+            }
+            for (uint j: jumps)
+                land(j);
+            break;
+        }
+        case Expr::SIMPLE_OP: {
+            OpCode op;
+            switch (expr->opChar) {
+                case '=':
+                    op = EQ;
+                    break;
+                case '<':
+                    op = LT;
+                    break;
+                case '>':
+                    op = GT;
+                    break;
+                default:
+                    throw DbRelationError(string("unsupported operator '") + expr->opChar + "' in where clause");
+            }
+            compare(op, expr->expr, expr->expr2, column_names, column_attributes);
+            break;
+        }
+        case Expr::NOT_EQUALS:
+            compare(NE, expr->expr, expr->expr2, column_names, column_attributes);
+            break;
+        case Expr::LESS_EQ:
+            compare(LE, expr->expr, expr->expr2, column_names, column_attributes);
+            break;
+        case Expr::GREATER_EQ:
+            compare(GE, expr->expr, expr->expr2, column_names, column_attributes);
+            break;
+        default:
+            throw DbRelationError("unsupported operator in where clause");
+    }
+}
+
+/**
+ * Append a comparison of a column with a literal, in either order.
+ * @param op                 comparison (as if the column is on the left)
+ * @param column             the column reference (or the literal, if it is on the left)
+ * @param literal            the literal (or the column)
+ * @param column_names       the relation's columns
+ * @param column_attributes  their types
+ */
+void Predicate::compare(OpCode op, const Expr *column, const Expr *literal, const ColumnNames &column_names,
+                        const ColumnAttributes &column_attributes) {
+    if (column->type != kExprColumnRef) {
+        swap(column, literal);
+        op = op == LT ? GT : op == GT ? LT : op == LE ? GE : op == GE ? LE : op;
+    }
+    if (column->type != kExprColumnRef)
+        throw DbRelationError("where clause comparisons must be between a column and a literal");
+    uint i = ordinal(column, column_names);
+    compare(op, i, Predicate::literal(literal, column_attributes[i]));
+}
+
+/**
+ * Append a comparison of a column with a value.
+ * @param op       comparison
+ * @param ordinal  the column
+ * @param operand  the value
+ */
+void Predicate::compare(OpCode op, uint ordinal, const Value &operand) {
+    this->program.push_back(Instruction{op, ordinal, operand, 0});
+}
+
+/**
+ * Append a conditional jump to be pointed at its target later with land().
+ * @param op  JUMP_IF_FALSE or JUMP_IF_TRUE
+ * @return    the jump's position in the program
+ */
+uint Predicate::jump(OpCode op) {
+    this->program.push_back(Instruction{op, 0, Value(), 0});
+    return (uint) this->program.size() - 1;
+}
+
+/**
+ * Point a jump at the end of the program so far.
+ * @param jump  the jump's position in the program
+ */
+void Predicate::land(uint jump) {
+    this->program[jump].target = (uint) this->program.size();
+}
+
+/**
+ * Find the ordinal of a referenced column.
+ * @param column        column reference
+ * @param column_names  the relation's columns
+ * @return              the column's ordinal
+ * @throws DbRelationError if there is no such column
+ */
+uint Predicate::ordinal(const Expr *column, const ColumnNames &column_names) {
+    for (uint i = 0; i < column_names.size(); i++)
+        if (column_names[i] == column->name)
+            return i;
+    throw DbRelationError(string("table does not have column named '") + column->name + "'");
+}
+
+/**
+ * Get the value of a literal to compare with a column.
+ * @param expr              the literal (an INT may be negated)
+ * @param column_attribute  the column's type, which the literal must have
+ * @return                  the literal's value
+ * @throws DbRelationError  if it is not a literal of the column's type
+ */
+Value Predicate::literal(const Expr *expr, ColumnAttribute column_attribute) {
+    if (column_attribute.get_data_type() == ColumnAttribute::INT) {
+        if (expr->type == kExprLiteralInt)
+            return Value((int32_t) expr->ival);
+        if (expr->type == kExprOperator && expr->opType == Expr::UMINUS && expr->expr->type == kExprLiteralInt)
+            return Value((int32_t) -expr->expr->ival);
+    } else if (column_attribute.get_data_type() == ColumnAttribute::TEXT && expr->type == kExprLiteralString) {
+        return Value(string(expr->name));
+    }
+    throw DbRelationError("where clause compares a column with a value of the wrong type");
+}
+
+/**
+ * Test helper. Compile the where clause of a query against columns a INT, b TEXT.
+ * @param where  the where clause
+ * @param rows   rows (a, b) to evaluate it against
+ * @return       the rows (by position, as a string of 0s and 1s) that satisfy it
+ */
+static string test_evaluate(string where, const vector<Row> &rows) {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE " + where);
+    if (!parse->isValid()) {
+        delete parse;
+        return "parse error";
+    }
+    string results;
+    try {
+        Predicate predicate(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names,
+                            column_attributes);
+        vector<ColumnVector> columns = {ColumnVector(ColumnAttribute::INT), ColumnVector(ColumnAttribute::TEXT)};
+        ValueView value;
+        for (auto const &row: rows) {
+            results += predicate.evaluate(row) ? "1" : "0";
+            for (uint ordinal = 0; ordinal < 2; ordinal++) {
+                RowFieldReader(row).read(ordinal, value);
+                columns[ordinal].append(value);
+            }
+        }
+        Selection selection;
+        predicate.evaluate(columns, (uint) rows.size(), selection);
+        string batch_results(rows.size(), '0');
+        for (u_int16_t i: selection)
+            batch_results[i] = '1';
+        if (batch_results != results)
+            results = "batch " + batch_results + " but row by row " + results;
+    } catch (DbRelationError &e) {
+        results = "error";
+    }
+    delete parse;
+    return results;
+}
+
+/**
+ * Test helper. A summary of rows whose a is from 2 to 3 and whose b is 'y'.
+ */
+class TestFieldSummary : public FieldSummary {
+public:
+    virtual bool range(uint ordinal, int32_t &min, int32_t &max) const {
+        min = 2;
+        max = 3;
+        return ordinal == 0;
+    }
+
+    virtual bool may_contain(uint ordinal, const Value &value) const {
+        return ordinal != 1 || value.s == "y";
+    }
+};
+
+/**
+ * Test helper. Compile the where clause of a query against columns a INT, b TEXT and check it against
+ * the summary of rows in TestFieldSummary.
+ * @param where  the where clause
+ * @return       "1" if some row may match, "0" if none can
+ */
+static string test_may_match(string where) {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE " + where);
+    string result = "parse error";
+    if (parse->isValid()) {
+        Predicate predicate(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names,
+                            column_attributes);
+        result = predicate.may_match(TestFieldSummary()) ? "1" : "0";
+    }
+    delete parse;
+    return result;
+}
+
+/**
+ * Test helper. The bounds a where clause puts on column a (an INT), as "min..max" (either left out if there
+ * isn't one).
+ */
+static string test_bounds(string where) {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE " + where);
+    string result = "parse error";
+    if (parse->isValid()) {
+        Predicate predicate(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names,
+                            column_attributes);
+        Value min, max;
+        bool has_min, has_max;
+        predicate.bounds(0, min, has_min, max, has_max);
+        result = (has_min ? to_string(min.n) : "") + ".." + (has_max ? to_string(max.n) : "");
+    }
+    delete parse;
+    return result;
+}
+
+/**
+ * Testing function for Predicate.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_predicate() {
+    ColumnNames column_names = {"a", "b"};
+    vector<Row> rows;
+    int a[] = {-5, 1, 2, 3, 10};
+    string b[] = {"x", "y", "z", "y", "x"};
+    for (uint i = 0; i < 5; i++) {
+        Row row(&column_names);
+        row[0] = Value(a[i]);
+        row[1] = Value(b[i]);
+        rows.push_back(row);
+    }
+    vector<pair<string, string>> cases = {
+            {"a = 2",                          "00100"},
+            {"2 < a",                          "00011"},
+            {"a <= 1",                         "11000"},
+            {"a <> 3",                         "11101"},
+            {"a >= -5 AND b = 'x'",            "10001"},
+            {"a BETWEEN 1 AND 3",              "01110"},
+            {"a IN (1, 10, 42)",               "01001"},
+            {"b IN ('z')",                     "00100"},
+            {"NOT a = 2 AND (b = 'y' OR a > 5)", "01011"},
+            {"a < 0 OR b != 'x'",              "11110"},
+            {"b = 1",                          "error"},
+            {"c = 1",                          "error"},
+    };
+    for (auto const &test_case: cases) {
+        string results = test_evaluate(test_case.first, rows);
+        if (results != test_case.second) {
+            cout << test_case.first << ": " << results << endl;
+            return assertion_failure("predicate " + test_case.first);
+        }
+    }
+
+    ValueDict where;
+    where["a"] = Value(3);
+    where["b"] = Value(string("y"));
+    Predicate equalities(&where, column_names, {ColumnAttribute(ColumnAttribute::INT),
+                                                ColumnAttribute(ColumnAttribute::TEXT)});
+    string results;
+    for (auto const &row: rows)
+        results += equalities.evaluate(row) ? "1" : "0";
+    if (results != "00010" || Predicate().evaluate(rows[0]) != true)
+        return assertion_failure("predicate from equalities");
+
+    cases = {
+            {"a = 2",                       "1"},
+            {"a = 5",                       "0"},
+            {"a > 3",                       "0"},
+            {"3 <= a",                      "1"},
+            {"a <> 2",                      "1"},
+            {"a BETWEEN 4 AND 10",          "0"},
+            {"NOT a BETWEEN 1 AND 5",       "0"},
+            {"a IN (1, 4) AND b = 'y'",     "0"},
+            {"a = 5 OR b = 'y'",            "1"},
+            {"a = 5 OR b = 'x'",            "0"},
+            {"b <> 'y'",                    "1"},
+            {"NOT b <> 'x'",                "0"},
+    };
+    for (auto const &test_case: cases) {
+        string result = test_may_match(test_case.first);
+        if (result != test_case.second) {
+            cout << test_case.first << ": " << result << endl;
+            return assertion_failure("may_match " + test_case.first);
+        }
+    }
+    if (!Predicate().may_match(TestFieldSummary()))
+        return assertion_failure("may_match with no where clause");
+
+    cases = {
+            {"a = 2",                              "2..2"},
+            {"a > 1 AND a <= 5",                   "2..5"},
+            {"a BETWEEN 1 AND 3 AND b = 'x'",      "1..3"},
+            {"a >= 3 AND a >= 5 AND a < 10",       "5..9"},
+            {"b = 'x' AND (a = 1 OR b = 'y') AND a < 4", "..3"},
+            {"a > 1 OR b = 'x'",                   ".."},
+            {"NOT a = 2",                          ".."},
+            {"a IN (1, 10)",                       ".."},
+    };
+    for (auto const &test_case: cases) {
+        string result = test_bounds(test_case.first);
+        if (result != test_case.second) {
+            cout << test_case.first << ": " << result << endl;
+            return assertion_failure("bounds " + test_case.first);
+        }
+    }
+    return true;
+}
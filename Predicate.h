@@ -0,0 +1,206 @@
+/**
+ * @file Predicate.h - Where clauses compiled for evaluation against rows.
+ * FieldReader
+ * RowFieldReader: FieldReader
+ * FieldSummary
+ * Predicate
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+
+namespace hsql {
+    struct Expr;
+}
+
+/**
+ * @class FieldReader - gives a Predicate the fields of the row it is evaluating, by column ordinal
+ * (e.g., straight out of a record in its block)
+ */
+class FieldReader {
+public:
+    virtual ~FieldReader() {}
+
+    /**
+     * Look at a field.
+     * @param ordinal  which column
+     * @param value    set to the field's value
+     */
+    virtual void read(uint ordinal, ValueView &value) const = 0;
+};
+
+/**
+ * @class RowFieldReader - the fields of a decoded row
+ */
+class RowFieldReader : public FieldReader {
+public:
+    RowFieldReader(const Row &row) : row(row) {}
+
+    virtual void read(uint ordinal, ValueView &value) const;
+
+protected:
+    const Row &row;
+};
+
+/**
+ * @class FieldSummary - tells a Predicate what is known about each column's values in a set of rows
+ * (e.g., a block's zone, see ZoneMap), so it can rule out the whole set without looking at the rows
+ */
+class FieldSummary {
+public:
+    virtual ~FieldSummary() {}
+
+    /**
+     * Get the range of an INT column's values.
+     * @param ordinal  which column
+     * @param min      set to the least value
+     * @param max      set to the greatest value
+     * @returns        false if the range isn't known
+     */
+    virtual bool range(uint ordinal, int32_t &min, int32_t &max) const = 0;
+
+    /**
+     * Check whether a column could have a given value in some row.
+     * @param ordinal  which column
+     * @param value    the value
+     * @returns        false only if no row has it
+     */
+    virtual bool may_contain(uint ordinal, const Value &value) const = 0;
+};
+
+/**
+ * @class Predicate - a where clause, compiled once per statement into a flat program over column ordinals
+ *
+ * Supports comparisons of a column to a literal (=, !=, <>, <, <=, >, >=), BETWEEN, IN, AND, OR and NOT.
+ * Column names and literal types are checked against the schema when the predicate is compiled, so
+ * evaluating it never fails and never allocates. The program is a list of comparisons, each of which sets
+ * a single result flag, plus NOTs and conditional jumps that short-circuit AND, OR, BETWEEN and IN:
+ *     a > 1 AND b = 'x'    is    GT a 1;  JUMP_IF_FALSE end;  EQ b 'x';  end:
+ * An empty program is always true.
+ *
+ * A batch of rows in column vectors is evaluated one instruction at a time over the whole batch, each
+ * comparison being a tight loop over one vector. Rows a jump skips past sit out the instructions up to
+ * its target, which gives each row the same result as evaluating it alone.
+ */
+class Predicate {
+public:
+    /**
+     * The predicate that accepts every row.
+     */
+    Predicate() : program() {}
+
+    /**
+     * Compile equality conditions, all of which must hold.
+     * @param where              values keyed by column name (nullptr for none)
+     * @param column_names       the relation's columns
+     * @param column_attributes  their types
+     * @throws DbRelationError   if the where clause doesn't fit the schema
+     */
+    Predicate(const ValueDict *where, const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    /**
+     * Compile a parsed where clause.
+     * @param where              the where clause (nullptr for none)
+     * @param column_names       the relation's columns
+     * @param column_attributes  their types
+     * @throws DbRelationError   if the where clause is not supported or doesn't fit the schema
+     */
+    Predicate(const hsql::Expr *where, const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    virtual ~Predicate() {}
+
+    /**
+     * Evaluate the predicate.
+     * @param fields  the row's fields
+     * @returns       true if the row satisfies the predicate
+     */
+    bool evaluate(const FieldReader &fields) const;
+
+    /**
+     * Evaluate the predicate against a decoded row.
+     * @param row  a row of the relation the predicate was compiled for
+     * @returns    true if the row satisfies the predicate
+     */
+    bool evaluate(const Row &row) const;
+
+    /**
+     * Evaluate the predicate against a batch of rows.
+     * @param columns    the rows' values, one vector per column ordinal (only the columns the predicate
+     *                   uses need to be filled in)
+     * @param size       number of rows (at most Batch::CAPACITY)
+     * @param selection  set to the positions of the rows that satisfy the predicate
+     */
+    void evaluate(const std::vector<ColumnVector> &columns, uint size, Selection &selection) const;
+
+    /**
+     * Note which columns the predicate reads.
+     * @param used  used[ordinal] is set for each of them (sized to the number of columns)
+     */
+    void uses(std::vector<bool> &used) const;
+
+    /**
+     * Check whether any of a set of rows could satisfy the predicate, given only a summary of them.
+     * @param summary  what is known about the rows' values
+     * @returns        false only if none of them can
+     */
+    bool may_match(const FieldSummary &summary) const;
+
+    /**
+     * Find the range of values a column has in every row that satisfies the predicate, from the
+     * comparisons of the column that it can't be satisfied without (e.g., a > 1 in a > 1 AND (b = 2 OR c = 3),
+     * but neither comparison in a > 1 OR b = 2). The range may be wider than the rows' values.
+     * @param ordinal  which column
+     * @param min      set to the least value (inclusive), if there is one
+     * @param has_min  set to whether there is one
+     * @param max      set to the greatest value (inclusive), if there is one
+     * @param has_max  set to whether there is one
+     */
+    void bounds(uint ordinal, Value &min, bool &has_min, Value &max, bool &has_max) const;
+
+    /**
+     * Whether every row satisfies the predicate (there is nothing to check).
+     */
+    bool is_true() const { return program.empty(); }
+
+protected:
+    enum OpCode {
+        EQ, NE, LT, LE, GT, GE, NOT, JUMP_IF_FALSE, JUMP_IF_TRUE
+    };
+
+    struct Instruction {
+        OpCode op;
+        uint ordinal;   // column to compare
+        Value operand;  // literal to compare it to
+        uint target;    // where to jump to
+    };
+
+    enum Outcome {
+        MAY_BE_FALSE = 1, MAY_BE_TRUE = 2
+    };
+
+    std::vector<Instruction> program;
+
+    bool may_match(const FieldSummary &summary, uint falsified) const;
+
+    static u_int8_t outcomes(const Instruction &instruction, const FieldSummary &summary);
+
+    void compile(const hsql::Expr *expr, const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    void compare(OpCode op, const hsql::Expr *column, const hsql::Expr *literal, const ColumnNames &column_names,
+                 const ColumnAttributes &column_attributes);
+
+    void compare(OpCode op, uint ordinal, const Value &operand);
+
+    uint jump(OpCode op);
+
+    void land(uint jump);
+
+    static uint ordinal(const hsql::Expr *column, const ColumnNames &column_names);
+
+    static Value literal(const hsql::Expr *expr, ColumnAttribute column_attribute);
+};
+
+bool test_predicate();
@@ -3,6 +3,9 @@
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
+#include <algorithm>
+#include <map>
+#include <regex>
 #include "SQLExec.h"
 
 using namespace std;
@@ -43,17 +46,26 @@ ostream &operator<<(ostream &out, const QueryResult &qres) {
 }
 
 QueryResult::~QueryResult() {
-    // FIXME
+    delete this->column_names;
+    delete this->column_attributes;
+    if (this->rows != nullptr) {
+        for (auto row: *this->rows)
+            delete row;
+        delete this->rows;
+    }
 }
 
 
-QueryResult *SQLExec::execute(const SQLStatement *statement) {
-    // FIXME: initialize _tables table, if not yet present
+QueryResult *SQLExec::execute(const SQLStatement *statement, const Identifier &storage,
+                              const ColumnNames &include_columns, int32_t page_size) {
+    // initialize _tables table, if not yet present
+    if (SQLExec::tables == nullptr)
+        SQLExec::tables = new Tables();
 
     try {
         switch (statement->type()) {
             case kStmtCreate:
-                return create((const CreateStatement *) statement);
+                return create((const CreateStatement *) statement, storage, include_columns, page_size);
             case kStmtDrop:
                 return drop((const DropStatement *) statement);
             case kStmtShow:
@@ -66,28 +78,492 @@ QueryResult *SQLExec::execute(const SQLStatement *statement) {
     }
 }
 
+// Take USING {HEAP | COLUMN} off the end of a CREATE TABLE, leaving the statement for the parser (not after
+// another statement on the line, which the clause would otherwise be applied to as well)
+Identifier SQLExec::storage_clause(string &query) {
+    static const regex clause("^(\\s*CREATE\\s+TABLE\\b[^;]*\\))\\s*USING\\s+(\\w+)\\s*(;?)\\s*$", regex::icase);
+    smatch match;
+    if (!regex_match(query, match, clause))
+        return "";
+    Identifier storage = match[2];
+    for (auto &c: storage)
+        c = (char) toupper(c);
+    query = match[1].str() + match[3].str();
+    return storage;
+}
+
+// Take PAGE_SIZE <bytes> off the end of a CREATE TABLE, leaving the statement (and any USING clause) for the parser
+// (again, only if it is the line's one statement)
+int32_t SQLExec::page_size_clause(string &query) {
+    static const regex clause("^(\\s*CREATE\\s+TABLE\\b[^;]*?)\\s*\\bPAGE_SIZE\\s*=?\\s*(\\d+)\\s*(;?)\\s*$", regex::icase);
+    smatch match;
+    if (!regex_match(query, match, clause))
+        return 0;
+    string digits = match[2];
+    query = match[1].str() + match[3].str();
+    if (digits.length() > 9 || stoi(digits) == 0)
+        return -1;
+    return stoi(digits);
+}
+
+// Take INCLUDE (<columns>) off the end of a CREATE INDEX, leaving the statement for the parser (again, only if it is
+// the line's one statement)
+ColumnNames SQLExec::include_clause(string &query) {
+    static const regex clause("^(\\s*CREATE\\s+INDEX\\b[^;]*\\))\\s*INCLUDE\\s*\\(([^()]*)\\)\\s*(;?)\\s*$", regex::icase);
+    static const regex column("\\w+");
+    smatch match;
+    ColumnNames include_columns;
+    if (!regex_match(query, match, clause))
+        return include_columns;
+    string columns = match[2];
+    for (sregex_iterator it(columns.begin(), columns.end(), column); it != sregex_iterator(); it++)
+        include_columns.push_back(it->str());
+    query = match[1].str() + match[3].str();
+    return include_columns;
+}
+
 void
 SQLExec::column_definition(const ColumnDefinition *col, Identifier &column_name, ColumnAttribute &column_attribute) {
-    throw SQLExecError("not implemented");  // FIXME
+    column_name = col->name;
+    switch (col->type) {
+        case ColumnDefinition::INT:
+            column_attribute.set_data_type(ColumnAttribute::INT);
+            break;
+        case ColumnDefinition::TEXT:
+            column_attribute.set_data_type(ColumnAttribute::TEXT);
+            break;
+        default:
+            throw SQLExecError("unrecognized data type for column '" + column_name + "'");
+    }
 }
 
-QueryResult *SQLExec::create(const CreateStatement *statement) {
-    return new QueryResult("not implemented"); // FIXME
+QueryResult *SQLExec::create(const CreateStatement *statement, const Identifier &storage,
+                             const ColumnNames &include_columns, int32_t page_size) {
+    switch (statement->type) {
+        case CreateStatement::kTable:
+            return create_table(statement, storage, page_size);
+        case CreateStatement::kIndex:
+            return create_index(statement, include_columns);
+        default:
+            return new QueryResult("Only CREATE TABLE and CREATE INDEX are implemented");
+    }
+}
+
+// CREATE TABLE ... [USING {HEAP | COLUMN}] [PAGE_SIZE <bytes>]: record the table in _tables and _columns, then
+// create its file(s)
+QueryResult *SQLExec::create_table(const CreateStatement *statement, const Identifier &storage, int32_t page_size) {
+    Identifier table_name = statement->tableName;
+    if (page_size != 0 && !is_acceptable_page_size(page_size))
+        throw SQLExecError("unacceptable page size for table '" + table_name + "' (must be a power of two from "
+                           + to_string(DbBlock::BLOCK_SZ) + " to " + to_string(DbBlock::MAX_BLOCK_SZ) + ")");
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    Identifier column_name;
+    ColumnAttribute column_attribute;
+    for (ColumnDefinition *col: *statement->columns) {
+        column_definition(col, column_name, column_attribute);
+        column_names.push_back(column_name);
+        column_attributes.push_back(column_attribute);
+    }
+
+    ValueDict row;
+    row["table_name"] = Value(table_name);
+    if (!storage.empty())
+        row["storage"] = Value(storage);
+    if (page_size != 0)
+        row["page_size"] = Value(page_size);
+    Handle table_handle = SQLExec::tables->insert(&row);
+    try {
+        Handles column_handles;
+        DbRelation &columns = SQLExec::tables->get_table(Columns::TABLE_NAME);
+        try {
+            for (uint i = 0; i < column_names.size(); i++) {
+                ValueDict column_row;
+                column_row["table_name"] = Value(table_name);
+                column_row["column_name"] = Value(column_names[i]);
+                column_row["data_type"] = Value(column_attributes[i].get_data_type() == ColumnAttribute::INT ? "INT"
+                                                                                                             : "TEXT");
+                column_row["ordinal"] = Value((int32_t) i);
+                column_handles.push_back(columns.insert(&column_row));
+            }
+            DbRelation &table = SQLExec::tables->get_table(table_name);
+            if (statement->ifNotExists)
+                table.create_if_not_exists();
+            else
+                table.create();
+        } catch (...) {
+            try {
+                for (auto const &handle: column_handles)
+                    columns.del(handle);
+            } catch (...) {}
+            throw;
+        }
+    } catch (...) {
+        try {
+            SQLExec::tables->del(table_handle);
+        } catch (...) {}
+        throw;
+    }
+    return new QueryResult("created " + table_name);
+}
+
+// CREATE INDEX <index> ON <table> [USING BTREE|HASH|BLOOM] (<columns>) [INCLUDE (<columns>)]: record the index
+// in _indices, then build it
+QueryResult *SQLExec::create_index(const CreateStatement *statement, const ColumnNames &include_columns) {
+    Identifier table_name = statement->tableName;
+    Identifier index_name = statement->indexName;
+    Identifier index_type = statement->indexType == nullptr ? Indices::BTREE_INDEX : statement->indexType;
+    for (auto &c: index_type)
+        c = (char) toupper(c);
+
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles *handles = SQLExec::tables->select(&where);
+    bool exists = !handles->empty();
+    delete handles;
+    if (!exists)
+        throw SQLExecError("no table named '" + table_name + "'");
+    DbRelation &table = SQLExec::tables->get_table(table_name);
+    ColumnNames index_columns(statement->indexColumns->begin(), statement->indexColumns->end());
+    index_columns.insert(index_columns.end(), include_columns.begin(), include_columns.end());
+    for (auto column_name = index_columns.begin(); column_name != index_columns.end(); column_name++) {
+        const ColumnNames &column_names = table.get_column_names();
+        if (find(column_names.begin(), column_names.end(), *column_name) == column_names.end())
+            throw SQLExecError("table '" + table_name + "' has no column '" + *column_name + "'");
+        if (find(index_columns.begin(), column_name, *column_name) != column_name)
+            throw SQLExecError("column '" + *column_name + "' is in index '" + index_name + "' twice");
+    }
+    if (index_type == Indices::BLOOM_FILTER && !include_columns.empty())
+        throw SQLExecError("bloom filter '" + index_name + "' can't include columns");
+    Indices &indices = SQLExec::tables->get_indices();
+    IndexNames index_names = indices.get_index_names(table_name);
+    if (find(index_names.begin(), index_names.end(), index_name) != index_names.end())
+        throw SQLExecError("table '" + table_name + "' already has an index named '" + index_name + "'");
+
+    Handles index_handles;
+    try {
+        ValueDict row;
+        row["table_name"] = Value(table_name);
+        row["index_name"] = Value(index_name);
+        row["index_type"] = Value(index_type);
+        row["is_unique"] = Value(0);
+        int32_t seq_in_index = 0;
+        for (auto const &column_name: index_columns) {
+            row["seq_in_index"] = Value(++seq_in_index);
+            row["column_name"] = Value(column_name);
+            row["is_included"] = Value(seq_in_index > (int32_t) statement->indexColumns->size() ? 1 : 0);
+            index_handles.push_back(indices.insert(&row));
+        }
+        DbIndex &index = indices.get_index(table, index_name);
+        index.create();
+        table.attach(&index);
+    } catch (...) {
+        try {
+            for (auto const &handle: index_handles)
+                indices.del(handle);
+        } catch (...) {}
+        throw;
+    }
+    return new QueryResult("created index " + index_name);
 }
 
 // DROP ...
 QueryResult *SQLExec::drop(const DropStatement *statement) {
-    return new QueryResult("not implemented"); // FIXME
+    switch (statement->type) {
+        case DropStatement::kTable:
+            return drop_table(statement);
+        case DropStatement::kIndex:
+            return drop_index(statement);
+        default:
+            return new QueryResult("Only DROP TABLE and DROP INDEX are implemented");
+    }
+}
+
+// DROP TABLE: remove the table's file(s), then its rows in _columns and _tables
+QueryResult *SQLExec::drop_table(const DropStatement *statement) {
+    Identifier table_name = statement->name;
+    if (table_name == Tables::TABLE_NAME || table_name == Columns::TABLE_NAME || table_name == Indices::TABLE_NAME)
+        throw SQLExecError("cannot drop a schema table");
+
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles *handles = SQLExec::tables->select(&where);
+    if (handles->empty()) {
+        delete handles;
+        throw SQLExecError("no table named '" + table_name + "'");
+    }
+    Handle table_handle = handles->front();
+    delete handles;
+
+    DbRelation &table = SQLExec::tables->get_table(table_name);
+    for (auto const &index_name: SQLExec::tables->get_indices().get_index_names(table_name))
+        drop_index(table, index_name);
+    table.drop();
+
+    DbRelation &columns = SQLExec::tables->get_table(Columns::TABLE_NAME);
+    handles = columns.select(&where);
+    for (auto const &handle: *handles)
+        columns.del(handle);
+    delete handles;
+
+    SQLExec::tables->del(table_handle);
+    return new QueryResult("dropped " + table_name);
+}
+
+// DROP INDEX <index> FROM <table>
+QueryResult *SQLExec::drop_index(const DropStatement *statement) {
+    Identifier table_name = statement->name;
+    Identifier index_name = statement->indexName;
+    IndexNames index_names = SQLExec::tables->get_indices().get_index_names(table_name);
+    if (find(index_names.begin(), index_names.end(), index_name) == index_names.end())
+        throw SQLExecError("table '" + table_name + "' has no index named '" + index_name + "'");
+    drop_index(SQLExec::tables->get_table(table_name), index_name);
+    return new QueryResult("dropped index " + index_name);
+}
+
+// Detach an index from its table and remove its file, then its rows in _indices
+void SQLExec::drop_index(DbRelation &table, Identifier index_name) {
+    Indices &indices = SQLExec::tables->get_indices();
+    DbIndex &index = indices.get_index(table, index_name);
+    table.detach(&index);
+    index.drop();
+
+    ValueDict where;
+    where["table_name"] = Value(table.get_table_name());
+    where["index_name"] = Value(index_name);
+    Handles *handles = indices.select(&where);
+    for (auto const &handle: *handles)
+        indices.del(handle);
+    delete handles;
 }
 
 QueryResult *SQLExec::show(const ShowStatement *statement) {
-    return new QueryResult("not implemented"); // FIXME
+    switch (statement->type) {
+        case ShowStatement::kTables:
+            return show_tables();
+        case ShowStatement::kColumns:
+            return show_columns(statement);
+        case ShowStatement::kIndex:
+            return show_index(statement);
+        default:
+            throw SQLExecError("unrecognized SHOW type");
+    }
 }
 
+// SHOW TABLES: the user's tables (not the schema tables), with their storage engines
 QueryResult *SQLExec::show_tables() {
-    return new QueryResult("not implemented"); // FIXME
+    ColumnNames *column_names = new ColumnNames;
+    column_names->push_back("table_name");
+    column_names->push_back("storage");
+    ColumnAttributes *column_attributes = new ColumnAttributes(2, ColumnAttribute(ColumnAttribute::TEXT));
+
+    Handles *handles = SQLExec::tables->select();
+    ValueDicts *rows = new ValueDicts;
+    for (auto const &handle: *handles) {
+        ValueDict *row = SQLExec::tables->project(handle, column_names);
+        Identifier table_name = row->at("table_name").s;
+        if (table_name != Tables::TABLE_NAME && table_name != Columns::TABLE_NAME && table_name != Indices::TABLE_NAME)
+            rows->push_back(row);
+        else
+            delete row;
+    }
+    delete handles;
+    return new QueryResult(column_names, column_attributes, rows, "successfully returned " + to_string(rows->size())
+                                                                  + " rows");
 }
 
+// SHOW COLUMNS FROM <table>
 QueryResult *SQLExec::show_columns(const ShowStatement *statement) {
-    return new QueryResult("not implemented"); // FIXME
+    DbRelation &columns = SQLExec::tables->get_table(Columns::TABLE_NAME);
+
+    ColumnNames *column_names = new ColumnNames;
+    column_names->push_back("table_name");
+    column_names->push_back("column_name");
+    column_names->push_back("data_type");
+    ColumnAttributes *column_attributes = new ColumnAttributes(3, ColumnAttribute(ColumnAttribute::TEXT));
+
+    ValueDict where;
+    where["table_name"] = Value(statement->tableName);
+    Handles *handles = columns.select(&where);
+    ColumnNames with_ordinal(*column_names);
+    with_ordinal.push_back("ordinal");
+    std::map<int32_t, ValueDict *> by_ordinal;  // in the order the columns were declared
+    for (auto const &handle: *handles) {
+        ValueDict *row = columns.project(handle, &with_ordinal);
+        by_ordinal[row->at("ordinal").n] = row;
+        row->erase("ordinal");
+    }
+    delete handles;
+    ValueDicts *rows = new ValueDicts;
+    for (auto const &row: by_ordinal)
+        rows->push_back(row.second);
+    return new QueryResult(column_names, column_attributes, rows, "successfully returned " + to_string(rows->size())
+                                                                  + " rows");
+}
+
+// SHOW INDEX FROM <table>
+QueryResult *SQLExec::show_index(const ShowStatement *statement) {
+    Indices &indices = SQLExec::tables->get_indices();
+
+    ColumnNames *column_names = new ColumnNames;
+    column_names->push_back("table_name");
+    column_names->push_back("index_name");
+    column_names->push_back("column_name");
+    column_names->push_back("seq_in_index");
+    column_names->push_back("index_type");
+    column_names->push_back("is_unique");
+    column_names->push_back("is_included");
+    ColumnAttributes *column_attributes = new ColumnAttributes;
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes->push_back(ColumnAttribute(ColumnAttribute::INT));
+
+    ValueDict where;
+    where["table_name"] = Value(statement->tableName);
+    Handles *handles = indices.select(&where);
+    ValueDicts *rows = new ValueDicts;
+    for (auto const &handle: *handles)
+        rows->push_back(indices.project(handle, column_names));
+    delete handles;
+    return new QueryResult(column_names, column_attributes, rows, "successfully returned " + to_string(rows->size())
+                                                                  + " rows");
+}
+
+/**
+ * Testing function for SQLExec.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_sql_exec() {
+    if (SQLExec::tables == nullptr)
+        SQLExec::tables = new Tables();
+
+    // CREATE TABLE ... PAGE_SIZE 16384 records the page size and makes the table's blocks that big
+    string query = "CREATE TABLE _test_sql_exec_cpp (a INT, b TEXT) USING HEAP PAGE_SIZE 16384;";
+    int32_t page_size = SQLExec::page_size_clause(query);
+    Identifier storage = SQLExec::storage_clause(query);
+    if (page_size != 16384 || storage != Tables::HEAP_STORAGE
+        || query != "CREATE TABLE _test_sql_exec_cpp (a INT, b TEXT);")
+        return assertion_failure("page size clause", page_size);
+    SQLParserResult *parse = SQLParser::parseSQLString(query);
+    delete SQLExec::execute(parse->getStatement(0), storage, ColumnNames(), page_size);
+    delete parse;
+    ValueDict where;
+    where["table_name"] = Value("_test_sql_exec_cpp");
+    Handles *handles = SQLExec::tables->select(&where);
+    bool ok = handles->size() == 1;
+    if (ok) {
+        ValueDict *row = SQLExec::tables->project(handles->front());
+        ok = row->at("page_size").n == 16384 && row->at("storage").s == Tables::HEAP_STORAGE;
+        delete row;
+    }
+    delete handles;
+    if (!ok)
+        return assertion_failure("16K table in _tables");
+    DbRelation &table = SQLExec::tables->get_table("_test_sql_exec_cpp");
+    ValueDict row;
+    row["a"] = Value(1);
+    row["b"] = Value(string(10000, 'x'));  // too big for a 4K block
+    table.insert(&row);
+    handles = table.select();
+    ok = handles->size() == 1;
+    delete handles;
+    parse = SQLParser::parseSQLString("DROP TABLE _test_sql_exec_cpp");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    if (!ok)
+        return assertion_failure("16K table's rows");
+
+    // a clause on a line with more than the one statement is left alone, rather than applied to them all
+    for (string line: {"CREATE TABLE _test_a_cpp (a INT); CREATE TABLE _test_b_cpp (b INT) USING COLUMN",
+                       "CREATE TABLE _test_a_cpp (a INT); CREATE TABLE _test_b_cpp (b INT) PAGE_SIZE 16384",
+                       "CREATE INDEX ix ON _test_a_cpp (a); CREATE INDEX ix ON _test_b_cpp (b) INCLUDE (c)"}) {
+        query = line;
+        if (SQLExec::storage_clause(query) != "" || SQLExec::page_size_clause(query) != 0
+            || !SQLExec::include_clause(query).empty() || query != line)
+            return assertion_failure("clause taken off a line of two statements: " + line);
+    }
+
+    // a table's columns come back in the order they were declared, even in rows freed by a dropped table
+    parse = SQLParser::parseSQLString("CREATE TABLE _test_ordinal_cpp (a INT, b TEXT, c INT)");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    parse = SQLParser::parseSQLString("DROP TABLE _test_ordinal_cpp");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    parse = SQLParser::parseSQLString("CREATE TABLE _test_ordinal_cpp (z INT, y TEXT, x INT, w TEXT)");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    ColumnNames declared;
+    ColumnAttributes declared_attributes;
+    SQLExec::tables->get_columns("_test_ordinal_cpp", declared, declared_attributes);
+    ok = declared == ColumnNames({"z", "y", "x", "w"}) && declared_attributes.size() == 4 &&
+         declared_attributes[1].get_data_type() == ColumnAttribute::TEXT;
+    parse = SQLParser::parseSQLString("DROP TABLE _test_ordinal_cpp");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    if (!ok)
+        return assertion_failure("columns out of their declared order");
+
+    // a page size that isn't a power of two in range is turned away, and nothing is left behind
+    query = "CREATE TABLE _test_sql_exec_bad_cpp (a INT) PAGE_SIZE 5000";
+    page_size = SQLExec::page_size_clause(query);
+    parse = SQLParser::parseSQLString(query);
+    try {
+        delete SQLExec::execute(parse->getStatement(0), "", ColumnNames(), page_size);
+        ok = false;
+    } catch (SQLExecError &e) {
+        // expected
+    }
+    delete parse;
+    where["table_name"] = Value("_test_sql_exec_bad_cpp");
+    handles = SQLExec::tables->select(&where);
+    ok = ok && handles->empty();
+    delete handles;
+    if (!ok)
+        return assertion_failure("unacceptable page size");
+
+    // once every table and index is closed (as on quit), what they held in memory is all on disk
+    parse = SQLParser::parseSQLString("CREATE TABLE _test_close_all_cpp (a INT, b TEXT)");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    parse = SQLParser::parseSQLString("CREATE INDEX fx ON _test_close_all_cpp USING BLOOM (a)");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    DbRelation &unclosed = SQLExec::tables->get_table("_test_close_all_cpp");
+    for (int i = 0; i < 100; i++) {
+        row["a"] = Value(i);
+        row["b"] = Value("row " + to_string(i));
+        unclosed.insert(&row);
+    }
+    Tables::close_all();
+    HeapTable reopened("_test_close_all_cpp", ColumnNames({"a", "b"}),
+                       ColumnAttributes({ColumnAttribute(ColumnAttribute::INT),
+                                         ColumnAttribute(ColumnAttribute::TEXT)}));
+    BloomFilter reopened_filter(reopened, "fx", ColumnNames({"a"}));
+    handles = reopened.select();
+    ok = handles->size() == 100;
+    delete handles;
+    for (int i = 0; ok && i < 100; i++)
+        ok = reopened_filter.may_contain(KeyValue({Value(i)}));
+    reopened_filter.close();
+    reopened.close();
+    HeapTable reopened_tables(Tables::TABLE_NAME, ColumnNames({"table_name", "page_size", "storage"}),
+                              ColumnAttributes({ColumnAttribute(ColumnAttribute::TEXT),
+                                                ColumnAttribute(ColumnAttribute::INT),
+                                                ColumnAttribute(ColumnAttribute::TEXT)}));
+    where["table_name"] = Value("_test_close_all_cpp");
+    handles = reopened_tables.select(&where);
+    ok = ok && handles->size() == 1;
+    delete handles;
+    reopened_tables.close();
+    parse = SQLParser::parseSQLString("DROP TABLE _test_close_all_cpp");
+    delete SQLExec::execute(parse->getStatement(0));
+    delete parse;
+    if (!ok)
+        return assertion_failure("rows, filter bits or schema rows lost when closed");
+    return true;
 }
@@ -60,25 +60,70 @@ public:
     /**
      * Execute the given SQL statement.
      * @param statement   the Hyrise AST of the SQL statement to execute
-     * @returns           the query result (freed by caller)
+     * @param storage          storage engine for a CREATE TABLE: Tables::HEAP_STORAGE (the default) or
+     *                         Tables::COLUMN_STORAGE
+     * @param include_columns  columns a CREATE INDEX is to carry besides its key (see include_clause)
+     * @param page_size        size of a CREATE TABLE's blocks (see page_size_clause), or 0 for DbBlock::BLOCK_SZ
+     * @returns                the query result (freed by caller)
      */
-    static QueryResult *execute(const hsql::SQLStatement *statement);
+    static QueryResult *execute(const hsql::SQLStatement *statement, const Identifier &storage = "",
+                                const ColumnNames &include_columns = ColumnNames(), int32_t page_size = 0);
+
+    /**
+     * Take a trailing storage clause, USING {HEAP | COLUMN}, off a CREATE TABLE statement before it is
+     * parsed (the parser doesn't know the clause). The clause is only taken off a line holding just the one
+     * statement; on a line of several statements it is left for the parser to reject, since what it was
+     * meant for is ambiguous (the same goes for the other clauses).
+     * @param query  the statement; returned by reference without the clause
+     * @returns      the storage engine named (in upper case), or "" if there is no clause
+     */
+    static Identifier storage_clause(std::string &query);
+
+    /**
+     * Take a trailing INCLUDE (<columns>) clause off a CREATE INDEX statement before it is parsed (the
+     * parser doesn't know the clause).
+     * @param query  the statement; returned by reference without the clause
+     * @returns      the columns named, or none if there is no clause
+     */
+    static ColumnNames include_clause(std::string &query);
+
+    /**
+     * Take a trailing PAGE_SIZE <bytes> clause off a CREATE TABLE statement before it is parsed (the parser
+     * doesn't know the clause). It goes after the storage clause, if there is one, so take it off first.
+     * @param query  the statement; returned by reference without the clause
+     * @returns      the page size given, 0 if there is no clause, or -1 if it isn't a usable number
+     */
+    static int32_t page_size_clause(std::string &query);
 
 protected:
     // the one place in the system that holds the _tables table
     static Tables *tables;
 
     // recursive decent into the AST
-    static QueryResult *create(const hsql::CreateStatement *statement);
+    static QueryResult *create(const hsql::CreateStatement *statement, const Identifier &storage,
+                               const ColumnNames &include_columns, int32_t page_size);
+
+    static QueryResult *create_table(const hsql::CreateStatement *statement, const Identifier &storage,
+                                     int32_t page_size);
+
+    static QueryResult *create_index(const hsql::CreateStatement *statement, const ColumnNames &include_columns);
 
     static QueryResult *drop(const hsql::DropStatement *statement);
 
+    static QueryResult *drop_table(const hsql::DropStatement *statement);
+
+    static QueryResult *drop_index(const hsql::DropStatement *statement);
+
+    static void drop_index(DbRelation &table, Identifier index_name);
+
     static QueryResult *show(const hsql::ShowStatement *statement);
 
     static QueryResult *show_tables();
 
     static QueryResult *show_columns(const hsql::ShowStatement *statement);
 
+    static QueryResult *show_index(const hsql::ShowStatement *statement);
+
     /**
      * Pull out column name and attributes from AST's column definition clause
      * @param col                AST column definition
@@ -87,4 +132,8 @@ protected:
      */
     static void
     column_definition(const hsql::ColumnDefinition *col, Identifier &column_name, ColumnAttribute &column_attribute);
+
+    friend bool test_sql_exec();
 };
+
+bool test_sql_exec();
@@ -3,7 +3,9 @@
  * @author K Lundeen
  * @see Seattle University, CPSC5300
  */
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include "SlottedPage.h"
 
 using namespace std;
@@ -18,29 +20,68 @@ typedef uint16_t u16;
 SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new) : DbBlock(block, block_id, is_new) {
     if (is_new) {
         this->num_records = 0;
-        this->end_free = DbBlock::BLOCK_SZ - 1;
+        this->end_free = (u16) (get_block_size() - 1);
+        this->dead_bytes = 0;
+        this->free_slot = 0;
         put_header();
     } else {
         get_header(this->num_records, this->end_free);
+        this->dead_bytes = get_n(4);
+        this->free_slot = get_n(6);
     }
 }
 
 /**
- * Add a new record to the block.
+ * Add a new record to the block, reusing the slot of a deleted record if there is one.
  * @param data
- * @return the new block's id
+ * @return the new record's id
  */
 RecordID SlottedPage::add(const Dbt *data) {
-    if (!has_room((u16) data->get_size()))
+    RecordID id;
+    void *bytes = reserve(data->get_size(), id);
+    memcpy(bytes, data->get_data(), data->get_size());
+    return id;
+}
+
+/**
+ * Add a new record of the given size to the block without filling it in, so the caller can build
+ * the record in place. The block is left unchanged if there is no room.
+ * @param size       size of the new record
+ * @param record_id  set to the new record's id
+ * @param home       if not null, the record is a moved one and this is the handle of its forwarding stub
+ * @return           where to write the record's bytes (valid until the block is next changed)
+ * @throws DbBlockNoRoomError if it won't fit
+ */
+void *SlottedPage::reserve(u_int32_t size, RecordID &record_id, const Handle *home) {
+    if (home != nullptr)
+        size += FORWARD_SZ;
+    if (size > FORWARDING - 1)
+        throw DbBlockNoRoomError("record too big for a block");
+    u_int32_t needed = size;
+    if (this->free_slot == 0)
+        needed += 4;  // the record plus a new header
+    if (!has_room(needed))
         throw DbBlockNoRoomError("not enough room for new record");
-    u16 id = ++this->num_records;
-    u16 size = (u16) data->get_size();
+    if (needed > contiguous_free())
+        compact();
+    u16 id;
+    if (this->free_slot != 0) {
+        u16 next, loc;
+        id = this->free_slot;
+        get_header(next, loc, id);
+        this->free_slot = next;
+    } else {
+        id = ++this->num_records;
+    }
     this->end_free -= size;
     u16 loc = this->end_free + 1U;
     put_header();
-    put_header(id, size, loc);
-    memcpy(this->address(loc), data->get_data(), size);
-    return id;
+    put_header(id, (u16) size, loc, home != nullptr);
+    record_id = id;
+    if (home == nullptr)
+        return this->address(loc);
+    put_forward(loc, MOVED, *home);
+    return this->address((u16) (loc + FORWARD_SZ));
 }
 
 /**
@@ -49,50 +90,160 @@ RecordID SlottedPage::add(const Dbt *data) {
  * @return the bits of the record as stored in the block, or nullptr if it has been deleted (freed by caller)
  */
 Dbt *SlottedPage::get(RecordID record_id) const {
+    RecordView record;
+    if (!view(record_id, record))
+        return nullptr;
+    return new Dbt((void *) record.data, record.size);
+}
+
+/**
+ * Get a record from the block as a view into the block's memory (no allocation, no copy).
+ * @param record_id
+ * @param record     set to the bits of the record as stored in the block
+ * @return           false if it has been deleted or is a forwarding stub (see forwarded())
+ */
+bool SlottedPage::view(RecordID record_id, RecordView &record) const {
     u16 size, loc;
     get_header(size, loc, record_id);
     if (loc == 0)
-        return nullptr;  // this is just a tombstone, record has been deleted
-    return new Dbt(this->address(loc), size);
+        return false;  // this is just a tombstone, record has been deleted
+    if (is_forwarding(record_id)) {
+        Handle handle;
+        if (get_forward(loc, handle) == STUB)
+            return false;
+        record = RecordView(this->address((u16) (loc + FORWARD_SZ)), size - FORWARD_SZ);
+        return true;
+    }
+    record = RecordView(this->address(loc), size);
+    return true;
 }
 
 /**
  * Replace the record with the given data.
  * @param record_id   record to replace
- * @param data        new contents of record_id
+ * @param data        new contents of record_id (must not point into this block)
  * @throws DbBlockNoRoomError if it won't fit
  */
 void SlottedPage::put(RecordID record_id, const Dbt &data) {
+    memcpy(replace(record_id, data.get_size()), data.get_data(), data.get_size());
+}
+
+/**
+ * Resize a record without filling it in, so the caller can rebuild it in place. A moved record stays
+ * a moved record; a forwarding stub becomes an ordinary record again. The block is left unchanged if
+ * there is no room.
+ * @param record_id   record to replace
+ * @param size        its new size
+ * @return            where to write the record's new bytes (valid until the block is next changed)
+ * @throws DbBlockNoRoomError if it won't fit
+ */
+void *SlottedPage::replace(RecordID record_id, u_int32_t size) {
+    u16 old_size, loc;
+    get_header(old_size, loc, record_id);
+    if (loc == 0)
+        throw DbRelationError("cannot put a deleted record");
+    Handle home;
+    if (!is_forwarding(record_id) || get_forward(loc, home) == STUB)
+        return resize(record_id, size, false);
+    loc = (u16) ((char *) resize(record_id, size + FORWARD_SZ, true) - (char *) this->address(0));
+    put_forward(loc, MOVED, home);
+    return this->address((u16) (loc + FORWARD_SZ));
+}
+
+/**
+ * Turn a record into a forwarding stub pointing at where the row now lives (or repoint a stub).
+ * The block is left unchanged if there is no room.
+ * @param record_id  record to turn into a stub
+ * @param target     handle of the moved record
+ * @throws DbBlockNoRoomError if a stub won't fit in place of the record
+ */
+void SlottedPage::forward(RecordID record_id, Handle target) {
     u16 size, loc;
     get_header(size, loc, record_id);
-    u16 new_size = (u16) data.get_size();
-    if (new_size > size) {
-        u16 extra = new_size - size;
-        if (!has_room(extra))
-            throw DbBlockNoRoomError("not enough room for enlarged record");
-        slide(loc, loc - extra);
-        memcpy(this->address(loc - extra), data.get_data(), new_size);
+    if (loc == 0)
+        throw DbRelationError("cannot forward a deleted record");
+    loc = (u16) ((char *) resize(record_id, FORWARD_SZ, true) - (char *) this->address(0));
+    put_forward(loc, STUB, target);
+}
+
+/**
+ * Check whether a record is a forwarding stub.
+ * @param record_id  record to check
+ * @param target     set to the handle of the moved record if it is
+ * @return           true if it is a stub
+ */
+bool SlottedPage::forwarded(RecordID record_id, Handle &target) const {
+    u16 size, loc;
+    get_header(size, loc, record_id);
+    return loc != 0 && is_forwarding(record_id) && get_forward(loc, target) == STUB;
+}
+
+/**
+ * Change a record's size. A record that shrinks stays where it is (so its bytes are kept); one that
+ * grows is moved to the start of the free space, compacting the block first if that is the only way to
+ * make room.
+ * @param record_id   record to resize (not deleted)
+ * @param size        its new size, including any forwarding prefix
+ * @param forwarding  whether it is a forwarding record (stub or moved)
+ * @return            where the record now starts
+ * @throws DbBlockNoRoomError if it won't fit
+ */
+void *SlottedPage::resize(RecordID record_id, u_int32_t size, bool forwarding) {
+    if (size > FORWARDING - 1)
+        throw DbBlockNoRoomError("record too big for a block");
+    u16 old_size, loc;
+    get_header(old_size, loc, record_id);
+    u16 new_size = (u16) size;
+    if (new_size <= old_size) {
+        this->dead_bytes += old_size - new_size;
     } else {
-        memcpy(this->address(loc), data.get_data(), new_size);
-        slide(loc + new_size, loc + size);
+        if (!has_room(new_size - old_size))
+            throw DbBlockNoRoomError("not enough room for enlarged record");
+        free_record(record_id, old_size, loc);
+        if (new_size > contiguous_free())
+            compact();
+        this->end_free -= new_size;
+        loc = this->end_free + 1U;
     }
-    get_header(size, loc, record_id);
-    put_header(record_id, new_size, loc);
+    put_header(record_id, new_size, loc, forwarding);
+    put_header();
+    return this->address(loc);
 }
 
 /**
  * Delete a record from the page.
  *
- * Mark the given id as deleted by changing its size to zero and its location to 0.
- * Compact the rest of the data in the block. But keep the record ids the same for everyone.
+ * Mark the given id as deleted by changing its location to 0 and push it onto the free slot chain.
+ * The record's bytes are left in place as dead space to be reclaimed by a later compaction.
+ * The record ids stay the same for everyone else; this one may be reused by a later add().
  *
  * @param record_id  record to delete
  */
 void SlottedPage::del(RecordID record_id) {
     u16 size, loc;
     get_header(size, loc, record_id);
+    if (loc == 0)
+        return;  // already deleted
+    free_record(record_id, size, loc);
+    put_header(record_id, this->free_slot, 0);
+    this->free_slot = record_id;
+    put_header();
+}
+
+/**
+ * Tombstone a record's header and account for the bytes it leaves behind. A record sitting right at the
+ * start of the data area is simply given back to the free space instead of becoming dead bytes.
+ * Does not write the block header.
+ * @param record_id  record to free
+ * @param size       its current size
+ * @param loc        its current offset
+ */
+void SlottedPage::free_record(RecordID record_id, u16 size, u16 loc) {
     put_header(record_id, 0, 0);  // 0 is the tombstone sentinel
-    slide(loc, loc + size);
+    if (loc == this->end_free + 1U)
+        this->end_free += size;
+    else
+        this->dead_bytes += size;
 }
 
 /**
@@ -101,13 +252,68 @@ void SlottedPage::del(RecordID record_id) {
  */
 RecordIDs *SlottedPage::ids(void) const {
     RecordIDs *vec = new RecordIDs();
+    for (RecordID record_id: records())
+        vec->push_back(record_id);
+    return vec;
+}
+
+/**
+ * Iterator positioned at the first non-deleted record at or after the given id.
+ * @param page       page whose records to iterate over
+ * @param record_id  where to start
+ */
+RecordIterator::RecordIterator(const SlottedPage *page, RecordID record_id) : page(page), record_id(record_id) {
+    skip_deleted();
+}
+
+/**
+ * Advance to the next non-deleted record.
+ * @return  this iterator
+ */
+RecordIterator &RecordIterator::operator++() {
+    this->record_id++;
+    skip_deleted();
+    return *this;
+}
+
+/**
+ * Move forward past any tombstones (stops one past the last record).
+ */
+void RecordIterator::skip_deleted() {
     u16 size, loc;
-    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
-        get_header(size, loc, record_id);
-        if (loc != 0)
-            vec->push_back(record_id);
+    Handle handle;
+    while (this->record_id <= this->page->num_records) {
+        this->page->get_header(size, loc, this->record_id);
+        if (loc != 0 && !(this->page->is_forwarding(this->record_id) &&
+                          this->page->get_forward(loc, handle) == SlottedPage::MOVED))
+            break;
+        this->record_id++;
     }
-    return vec;
+}
+
+/**
+ * Range over a page's current records.
+ * @param page  the page
+ */
+RecordIDRange::RecordIDRange(const SlottedPage *page) : page(page), last(page->num_records) {
+}
+
+/**
+ * Largest row that fits in a block, with room to be moved.
+ * @param block_size  the size of the block
+ * @return            the size of the row in bytes
+ */
+u_int32_t SlottedPage::max_row_size(u_int32_t block_size) {
+    return min(block_size - HEADER_SZ - 4 - FORWARD_SZ, (u_int32_t) MAX_RECORD_SZ);
+}
+
+/**
+ * Total free space in the block: the contiguous free space plus the dead bytes a compaction would reclaim.
+ * An add() of a record needs its size plus 4 bytes for the header.
+ * @return  free bytes
+ */
+u_int32_t SlottedPage::free_space() const {
+    return (u_int32_t) contiguous_free() + this->dead_bytes;
 }
 
 /**
@@ -117,8 +323,11 @@ RecordIDs *SlottedPage::ids(void) const {
  * @param id    the id of the header to fetch
  */
 void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const {
-    size = get_n((u16) 4 * id);
-    loc = get_n((u16) (4 * id + 2));
+    u16 offset = header_offset(id);
+    size = get_n(offset);
+    if (id != 0)
+        size &= (u16) ~FORWARDING;
+    loc = get_n((u16) (offset + 2));
 }
 
 /**
@@ -126,61 +335,108 @@ void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const
  * @param id
  * @param size
  * @param loc
+ * @param forwarding  mark the record as a forwarding stub or moved record
  */
-void SlottedPage::put_header(RecordID id, u16 size, u16 loc) {
+void SlottedPage::put_header(RecordID id, u16 size, u16 loc, bool forwarding) {
     if (id == 0) { // called the put_header() version and using the default params
         size = this->num_records;
         loc = this->end_free;
+        put_n(4, this->dead_bytes);
+        put_n(6, this->free_slot);
     }
-    put_n((u16) 4 * id, size);
-    put_n((u16) (4 * id + 2), loc);
+    u16 offset = header_offset(id);
+    put_n(offset, forwarding ? (u16) (size | FORWARDING) : size);
+    put_n((u16) (offset + 2), loc);
+}
+
+/**
+ * Whether a live record is a forwarding stub or a moved record (the top bit of its size).
+ * @param id  the record
+ * @return    true if it has a forwarding prefix
+ */
+bool SlottedPage::is_forwarding(RecordID id) const {
+    return (get_n(header_offset(id)) & FORWARDING) != 0;
+}
+
+/**
+ * Read the prefix of a forwarding record.
+ * @param loc     where the record starts
+ * @param handle  set to the handle in the prefix (a stub's target or a moved record's stub)
+ * @return        STUB or MOVED
+ */
+SlottedPage::ForwardKind SlottedPage::get_forward(u16 loc, Handle &handle) const {
+    const char *bytes = (const char *) this->address(loc);
+    memcpy(&handle.first, bytes + 1, sizeof(BlockID));
+    memcpy(&handle.second, bytes + 1 + sizeof(BlockID), sizeof(RecordID));
+    return (ForwardKind) bytes[0];
+}
+
+/**
+ * Write the prefix of a forwarding record.
+ * @param loc     where the record starts
+ * @param kind    STUB or MOVED
+ * @param handle  a stub's target or a moved record's stub
+ */
+void SlottedPage::put_forward(u16 loc, ForwardKind kind, const Handle &handle) {
+    char *bytes = (char *) this->address(loc);
+    bytes[0] = (char) kind;
+    memcpy(bytes + 1, &handle.first, sizeof(BlockID));
+    memcpy(bytes + 1 + sizeof(BlockID), &handle.second, sizeof(RecordID));
+}
+
+/**
+ * Byte offset of the header for given id. For id of zero, it is the block header.
+ * @param id
+ * @return    offset into the block
+ */
+u16 SlottedPage::header_offset(RecordID id) const {
+    return id == 0 ? 0 : (u16) (HEADER_SZ + 4 * (id - 1));
 }
 
 /**
- * Calculate if we have room to store a record with given size. The size should include the 4 bytes
- * for the header, too, if this is an add.
- * @param size   size of the new record (not including the header space needed)
+ * Number of free bytes between the end of the record headers and the start of the record data.
+ * @return  contiguous free space (not counting dead bytes)
+ */
+u16 SlottedPage::contiguous_free() const {
+    return (u16) (this->end_free + 1U - header_offset((RecordID) (this->num_records + 1)));
+}
+
+/**
+ * Calculate if we have room to store a record with given size, possibly after compacting. The size should
+ * include the 4 bytes for the header, too, if this is an add.
+ * @param size   number of bytes needed
  * @return       true if there is enough room, false otherwise
  */
-bool SlottedPage::has_room(u16 size) const {
-    return 4 * (this->num_records + 1) + size <= this->end_free;
+bool SlottedPage::has_room(u_int32_t size) const {
+    return size <= (u_int32_t) contiguous_free() + this->dead_bytes;
 }
 
 /**
- * Slide the contents to compensate for a smaller/larger record.
- *
- * If start < end, then remove data from offset start up to but not including offset end by sliding data
- * that is to the left of start to the right. If start > end, then make room for extra data from end to start
- * by sliding data that is to the left of start to the left.
- * Also fix up any record headers whose data has slid. Assumes there is enough room if it is a left
- * shift (end < start).
+ * Squeeze out the dead bytes so that all the free space in the block is contiguous.
  *
- * @param start  beginning of slide
- * @param end    end of slide
+ * One pass over the record headers: the data area is copied aside (into a buffer just its size, so a big
+ * page doesn't need that much stack) and each live record is copied back, packed against the end of the
+ * block, with its header fixed up as we go. Linear in the number of records.
  */
-void SlottedPage::slide(u_int16_t start, u_int16_t end) {
-    int shift = end - start;
-    if (shift == 0)
+void SlottedPage::compact() {
+    if (this->dead_bytes == 0)
         return;
+    u16 data_start = this->end_free + 1U;
+    u_int32_t end = get_block_size();
+    const char *data = (const char *) this->address(data_start);
+    vector<char> data_area(data, data + (end - data_start));
 
-    // slide data
-    void *to = this->address((u16) (this->end_free + 1 + shift));
-    void *from = this->address((u16) (this->end_free + 1));
-    int bytes = start - (this->end_free + 1U);
-    memmove(to, from, bytes);
-
-    // fix up headers to the right
-    RecordIDs *record_ids = ids();
-    for (auto const &record_id : *record_ids) {
-        u16 size, loc;
+    u16 size, loc;
+    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
         get_header(size, loc, record_id);
-        if (loc <= start) {
-            loc += shift;
-            put_header(record_id, size, loc);
-        }
+        if (loc == 0)
+            continue;
+        end -= size;
+        memcpy(this->address((u16) end), data_area.data() + (loc - data_start), size);
+        put_header(record_id, size, (u16) end, is_forwarding(record_id));
     }
-    delete record_ids;
-    this->end_free += shift;
+    this->end_free = (u16) (end - 1);
+    this->dead_bytes = 0;
     put_header();
 }
 
@@ -264,7 +520,7 @@ bool test_slotted_page() {
     if (expected != actual)
         return assertion_failure("get 2 back " + actual);
 
-    // test put with expansion (and slide and ids)
+    // test put with expansion (and ids)
     char rec1_rev[] = "something much bigger";
     rec1_dbt = Dbt(rec1_rev, sizeof(rec1_rev));
     slot.put(1, rec1_dbt);
@@ -282,7 +538,7 @@ bool test_slotted_page() {
     if (expected != actual)
         return assertion_failure("get 1 back after expanding put of 1 " + actual);
 
-    // test put with contraction (and slide and ids)
+    // test put with contraction (and ids)
     rec1_dbt = Dbt(rec1, sizeof(rec1));
     slot.put(1, rec1_dbt);
     // check both rec2 and rec1 after contracting put
@@ -309,10 +565,26 @@ bool test_slotted_page() {
     if (id_list->size() != 1 || id_list->at(0) != 2)
         return assertion_failure("ids() with 1 record remaining");
     delete id_list;
+    RecordIDs iterated;
+    for (RecordID record_id: slot.records())
+        iterated.push_back(record_id);
+    if (iterated.size() != 1 || iterated.at(0) != 2)
+        return assertion_failure("records() with 1 record remaining");
     get_dbt = slot.get(1);
     if (get_dbt != nullptr)
         return assertion_failure("get of deleted record was not null");
 
+    // view sees the same bytes as get, in place
+    RecordView record_view;
+    if (slot.view(1, record_view))
+        return assertion_failure("view of deleted record");
+    if (!slot.view(2, record_view) || record_view.size != sizeof(rec2) || memcmp(record_view.data, rec2, sizeof(rec2)) != 0)
+        return assertion_failure("view 2");
+    u16 size, loc;
+    slot.get_header(size, loc, 2);
+    if (record_view.data != slot.address(loc))
+        return assertion_failure("view 2 is not in place");
+
     // try adding something too big
     rec2_dbt = Dbt(nullptr, DbBlock::BLOCK_SZ - 10); // too big, but only because we have a record in there
     try {
@@ -325,6 +597,92 @@ bool test_slotted_page() {
         return assertion_failure("wrong type thrown when add too big");
     }
 
+    // churn: delete every other record of a full page, then fill it again, which needs compaction
+    char churn_space[DbBlock::BLOCK_SZ];
+    Dbt churn_dbt(churn_space, sizeof(churn_space));
+    SlottedPage churn(churn_dbt, 2, true);
+    char churn_rec[50];
+    Dbt churn_rec_dbt(churn_rec, sizeof(churn_rec));
+    RecordID churn_count = 0;
+    try {
+        while (true) {
+            memset(churn_rec, 'a' + churn_count % 26, sizeof(churn_rec));
+            churn_count = churn.add(&churn_rec_dbt);
+        }
+    } catch (DbBlockNoRoomError &exc) {
+        // page is full
+    }
+    for (RecordID churn_id = 1; churn_id <= churn_count; churn_id += 2)
+        churn.del(churn_id);
+    if (churn.dead_bytes == 0)
+        return assertion_failure("del did not leave dead bytes");
+    char big_rec[500];
+    memset(big_rec, 'z', sizeof(big_rec));
+    Dbt big_dbt(big_rec, sizeof(big_rec));
+    RecordID big_id = churn.add(&big_dbt);
+    if (churn.dead_bytes != 0)
+        return assertion_failure("add did not compact");
+    if (big_id % 2 != 1 || big_id > churn_count || churn.num_records != churn_count)
+        return assertion_failure("add did not reuse a deleted slot", big_id, churn.num_records);
+    for (RecordID churn_id = 2; churn_id <= churn_count; churn_id += 2) {
+        if (!churn.view(churn_id, record_view) || record_view.size != sizeof(churn_rec) ||
+            record_view.data[0] != 'a' + (churn_id - 1) % 26 || record_view.data[sizeof(churn_rec) - 1] != record_view.data[0])
+            return assertion_failure("record moved by compaction", churn_id);
+    }
+    if (!churn.view(big_id, record_view) || record_view.size != sizeof(big_rec) || memcmp(record_view.data, big_rec, sizeof(big_rec)) != 0)
+        return assertion_failure("record added after compaction");
+
+    // the rest of the deleted slots get reused before the slot directory grows again
+    Dbt small_dbt(churn_rec, 10);
+    while (churn.free_slot != 0) {
+        RecordID id = churn.add(&small_dbt);
+        if (id % 2 != 1 || id > churn_count)
+            return assertion_failure("deleted slot not reused", id);
+    }
+    if (churn.num_records != churn_count)
+        return assertion_failure("slot directory grew while slots were free", churn.num_records);
+
+    // forwarding: a stub is not viewed but followed, a moved record is viewed without its prefix and skipped by scans
+    char fwd_block[DbBlock::BLOCK_SZ];
+    Dbt fwd_dbt(fwd_block, sizeof(fwd_block));
+    SlottedPage fwd(fwd_dbt, 1, true);
+    char fwd_rec[] = "forwarded row";
+    Dbt row_dbt(fwd_rec, sizeof(fwd_rec));
+    RecordID stub_id = fwd.add(&row_dbt);
+    Handle stub_home(1, stub_id);
+    RecordID moved_id;
+    memcpy(fwd.reserve(sizeof(fwd_rec), moved_id, &stub_home), fwd_rec, sizeof(fwd_rec));
+    fwd.forward(stub_id, Handle(1, moved_id));
+    Handle target;
+    if (fwd.view(stub_id, record_view) || !fwd.forwarded(stub_id, target) || target != Handle(1, moved_id))
+        return assertion_failure("forwarding stub");
+    if (!fwd.view(moved_id, record_view) || record_view.size != sizeof(fwd_rec) || memcmp(record_view.data, fwd_rec, sizeof(fwd_rec)) != 0)
+        return assertion_failure("moved record");
+    RecordIDs *fwd_ids = fwd.ids();
+    bool only_stub = fwd_ids->size() == 1 && fwd_ids->front() == stub_id;
+    delete fwd_ids;
+    if (!only_stub)
+        return assertion_failure("scan of forwarded records");
+    memcpy(fwd.replace(moved_id, 5), "hello", 5);  // a moved record keeps its prefix when rewritten
+    fwd.compact();
+    if (!fwd.view(moved_id, record_view) || record_view.size != 5 || fwd.forwarded(moved_id, target))
+        return assertion_failure("rewritten moved record");
+
+    // a record built in reserved space; a reservation that doesn't fit leaves the block alone
+    RecordID reserved_id;
+    memcpy(churn.reserve(4, reserved_id), "abcd", 4);
+    if (!churn.view(reserved_id, record_view) || record_view.size != 4 || memcmp(record_view.data, "abcd", 4) != 0)
+        return assertion_failure("reserved record", reserved_id);
+    u_int32_t free_before = churn.free_space();
+    RecordID num_before = churn.num_records;
+    try {
+        churn.reserve(DbBlock::BLOCK_SZ, reserved_id);
+        return assertion_failure("reserve more than the block did not throw");
+    } catch (DbBlockNoRoomError &e) {
+        if (churn.free_space() != free_before || churn.num_records != num_before)
+            return assertion_failure("failed reserve changed the block");
+    }
+
     // more volume
     string gettysburg = "Four score and seven years ago our fathers brought forth on this continent, a new nation, conceived in Liberty, and dedicated to the proposition that all men are created equal.";
     int32_t n = -1;
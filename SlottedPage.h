@@ -11,23 +11,102 @@
 
 #include "storage_engine.h"
 
+class SlottedPage;
+
+/**
+ * @class RecordIterator - iterator over the non-deleted RecordIDs of a SlottedPage, computed as it goes
+ */
+class RecordIterator {
+public:
+    RecordIterator(const SlottedPage *page, RecordID record_id);
+
+    RecordID operator*() const { return record_id; }
+
+    RecordIterator &operator++();
+
+    bool operator==(const RecordIterator &other) const { return record_id == other.record_id; }
+
+    bool operator!=(const RecordIterator &other) const { return record_id != other.record_id; }
+
+protected:
+    const SlottedPage *page;
+    RecordID record_id;
+
+    void skip_deleted();
+};
+
+/**
+ * @class RecordIDRange - the non-deleted RecordIDs of a SlottedPage, for a range-based for loop
+ * (an allocation-free alternative to ids())
+ */
+class RecordIDRange {
+public:
+    RecordIDRange(const SlottedPage *page);
+
+    RecordIterator begin() const { return RecordIterator(page, 1); }
+
+    RecordIterator end() const { return RecordIterator(page, (RecordID) (last + 1)); }
+
+protected:
+    const SlottedPage *page;
+    RecordID last;
+};
+
 /**
  * @class SlottedPage - heap file implementation of DbBlock.
  *
  *      Manage a database block that contains several records.
         Modeled after slotted-page from Database Systems Concepts, 6ed, Figure 10-9.
 
-        Record id are handed out sequentially starting with 1 as records are added with add().
-        Each record has a header which is a fixed offset from the beginning of the block:
+        Record ids start with 1. add() reuses the slot of a deleted record if there is one, otherwise it
+        hands out the next id in sequence.
+        The block starts with an 8-byte block header followed by a 4-byte header per record:
             Bytes 0x00 - Ox01: number of records
             Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x04 - 0x05: number of dead bytes (left in the data area by del or a shrinking put)
+            Bytes 0x06 - 0x07: id of first free (deleted) slot, or 0 if none
+            Bytes 0x08 - 0x09: size of record 1
+            Bytes 0x0A - 0x0B: offset to record 1
             etc.
+
+        Deleting a record just tombstones its header (offset 0) and counts its bytes as dead. The size
+        field of a tombstoned header holds the id of the next free slot, chaining the deleted slots
+        together so add() can reuse them.
+        The dead bytes are only reclaimed, by one compaction pass over the records, when an add or
+        put needs more contiguous space than is free between the headers and the record data.
+
+        Handle recycling: a RecordID is valid from add() until del(). After del() the same id may be
+        handed out again by the next add() to this block, so a handle to a deleted row must not be
+        kept. BlockIDs are never recycled.
+
+        Forwarding (so a row can move to another block without its handle changing): the top bit of
+        a record's size marks a forwarding record, whose first FORWARD_SZ bytes are a kind byte and a
+        handle. A stub (left where the row was) holds the handle of the moved record; a moved record holds
+        the handle of its stub, followed by the row. view() doesn't see stubs (see forwarded()) and shows
+        just the row part of a moved record. ids() and records() skip moved records, so a scan meets each
+        row once, at its stub.
  *
  */
 class SlottedPage : public DbBlock {
 public:
+    /**
+     * size of the prefix of a forwarding record: kind byte plus a handle
+     */
+    static const uint16_t FORWARD_SZ = 7;
+
+    /**
+     * largest row a block of any size can hold (leaving room for a forwarding prefix in the size field)
+     */
+    static const uint16_t MAX_RECORD_SZ = 0x7fff - FORWARD_SZ;
+
+    /**
+     * Largest row a block of a given size can hold and still move to another block of that size: the block
+     * less its header, one record header and a forwarding prefix (and no more than MAX_RECORD_SZ).
+     * @param block_size  the size of the block
+     * @returns           the size of the row in bytes
+     */
+    static u_int32_t max_row_size(u_int32_t block_size);
+
     SlottedPage(Dbt &block, BlockID block_id, bool is_new = false);
 
     // Big 5 - use the defaults
@@ -35,25 +114,69 @@ public:
 
     virtual RecordID add(const Dbt *data);
 
+    virtual void *reserve(u_int32_t size, RecordID &record_id, const Handle *home = nullptr);
+
     virtual Dbt *get(RecordID record_id) const;
 
+    virtual bool view(RecordID record_id, RecordView &record) const;
+
     virtual void put(RecordID record_id, const Dbt &data);
 
+    virtual void *replace(RecordID record_id, u_int32_t size);
+
+    virtual void forward(RecordID record_id, Handle target);
+
+    virtual bool forwarded(RecordID record_id, Handle &target) const;
+
     virtual void del(RecordID record_id);
 
     virtual RecordIDs *ids(void) const;
 
+    RecordIDRange records() const { return RecordIDRange(this); }
+
+    u_int32_t free_space() const;
+
 protected:
+    /**
+     * size of the block header preceding the record headers
+     */
+    static const uint16_t HEADER_SZ = 8;
+
+    /**
+     * bit of a record header's size that marks a forwarding record
+     */
+    static const uint16_t FORWARDING = 0x8000;
+
+    enum ForwardKind {
+        STUB = 1, MOVED = 2
+    };
+
     uint16_t num_records;
     uint16_t end_free;
+    uint16_t dead_bytes;
+    RecordID free_slot;
 
     void get_header(uint16_t &size, uint16_t &loc, RecordID id = 0) const;
 
-    void put_header(RecordID id = 0, uint16_t size = 0, uint16_t loc = 0);
+    void put_header(RecordID id = 0, uint16_t size = 0, uint16_t loc = 0, bool forwarding = false);
+
+    bool is_forwarding(RecordID id) const;
+
+    ForwardKind get_forward(uint16_t loc, Handle &handle) const;
+
+    void put_forward(uint16_t loc, ForwardKind kind, const Handle &handle);
+
+    void *resize(RecordID record_id, u_int32_t size, bool forwarding);
 
-    bool has_room(uint16_t size) const;
+    uint16_t header_offset(RecordID id) const;
 
-    virtual void slide(uint16_t start, uint16_t end);
+    uint16_t contiguous_free() const;
+
+    bool has_room(u_int32_t size) const;
+
+    virtual void compact();
+
+    void free_record(RecordID record_id, uint16_t size, uint16_t loc);
 
     uint16_t get_n(uint16_t offset) const;
 
@@ -61,6 +184,10 @@ protected:
 
     void *address(uint16_t offset) const;
 
+    friend class RecordIterator;
+
+    friend class RecordIDRange;
+
     friend bool test_slotted_page();
 };
 
@@ -0,0 +1,332 @@
+/**
+ * @file ZoneMap.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "ZoneMap.h"
+#include "SlottedPage.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name               name of the table the map is for
+ * @param column_attributes  the table's column types
+ */
+ZoneMap::ZoneMap(string name, const ColumnAttributes &column_attributes)
+        : dbfilename(name + ".zm.db"), column_types(), zone_size(0), record_size(0), zones_per_record(0),
+          closed(true), current(false), db(_DB_ENV, 0), zones(), dirty() {
+    for (auto ca: column_attributes)
+        this->column_types.push_back(ca.get_data_type());
+    this->zone_size = ZONE_HEADER_SZ + FIELD_SZ * (uint) this->column_types.size();
+    this->record_size = max((uint) DbBlock::BLOCK_SZ, this->zone_size);
+    this->zones_per_record = this->record_size / this->zone_size;
+}
+
+/**
+ * Remove any old file of the map's name and start a new one.
+ */
+void ZoneMap::create() {
+    drop();
+    open(0);
+}
+
+/**
+ * Open (or create) the map's file and read in the zones, if they are current.
+ * @param last_block  the table's last block id
+ */
+void ZoneMap::open(BlockID last_block) {
+    if (!this->closed)
+        return;
+    this->db.set_re_len(this->record_size);
+    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, DB_CREATE, 0644);
+    this->closed = false;
+
+    this->zones.clear();
+    this->dirty.clear();
+    this->current = false;
+    vector<u_char> buffer(this->record_size);
+    for (db_recno_t record = 1;; record++) {
+        Dbt key(&record, sizeof(record));
+        Dbt data(buffer.data(), this->record_size);
+        data.set_ulen(this->record_size);
+        data.set_flags(DB_DBT_USERMEM);
+        if (this->db.get(nullptr, &key, &data, 0) != 0)
+            break;
+        if (record == 1) {
+            this->current = *(u_int32_t *) buffer.data() != 0 && *(u_int32_t *) (buffer.data() + 4) == this->zone_size;
+            if (!this->current)
+                break;
+            continue;
+        }
+        this->zones.insert(this->zones.end(), buffer.begin(), buffer.begin() + this->zones_per_record * this->zone_size);
+        this->dirty.push_back(false);
+    }
+    if (!this->current) {
+        // nothing is known about the blocks there are now, and the file's zones have to be rewritten
+        this->zones.assign((size_t) last_block * this->zone_size, 0);
+        for (BlockID block_id = 1; block_id <= last_block; block_id++)
+            zone(block_id)[0] = UNKNOWN;
+        this->dirty.assign((last_block + this->zones_per_record - 1) / this->zones_per_record, true);
+    }
+}
+
+/**
+ * Write back and close the map's file.
+ */
+void ZoneMap::close() {
+    if (this->closed)
+        return;
+    flush();
+    this->db.close(0);
+    this->closed = true;
+}
+
+/**
+ * Delete the map's file (if there is one -- tables from before zone maps were kept have none).
+ */
+void ZoneMap::drop() {
+    close();
+    Db db(_DB_ENV, 0);
+    try {
+        db.remove(this->dbfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // no file to remove
+    }
+}
+
+/**
+ * Write back every record of the map that has a changed zone in it, then mark the file current.
+ */
+void ZoneMap::flush() {
+    vector<u_char> buffer(this->record_size);
+    uint record_bytes = this->zones_per_record * this->zone_size;
+    for (uint i = 0; i < this->dirty.size(); i++) {
+        if (!this->dirty[i])
+            continue;
+        fill(buffer.begin(), buffer.end(), 0);
+        size_t first = (size_t) i * record_bytes;
+        size_t n = min((size_t) record_bytes, this->zones.size() - first);
+        memcpy(buffer.data(), this->zones.data() + first, n);
+        db_recno_t record = i + 2;  // after the header
+        Dbt key(&record, sizeof(record));
+        Dbt data(buffer.data(), this->record_size);
+        this->db.put(nullptr, &key, &data, 0);
+        this->dirty[i] = false;
+    }
+    if (!this->current)
+        put_header(true);
+}
+
+/**
+ * Widen a block's zone to cover a row. An empty zone becomes just the row's values; an unknown one
+ * stays unknown.
+ * @param block_id  the row's home block
+ * @param fields    the row's fields
+ */
+void ZoneMap::add(BlockID block_id, const FieldReader &fields) {
+    u_char *zone = this->zone(block_id);
+    if (zone[0] == UNKNOWN)
+        return;
+    bool first = zone[0] == EMPTY;
+    zone[0] = ROWS;
+    u_char *field = zone + ZONE_HEADER_SZ;
+    ValueView value;
+    for (uint ordinal = 0; ordinal < this->column_types.size(); ordinal++, field += FIELD_SZ) {
+        fields.read(ordinal, value);
+        if (this->column_types[ordinal] == ColumnAttribute::INT) {
+            int32_t *range = (int32_t *) field;
+            if (first || value.n < range[0])
+                range[0] = value.n;
+            if (first || value.n > range[1])
+                range[1] = value.n;
+        } else {
+            u_int64_t *bloom = (u_int64_t *) field;
+            *bloom = (first ? 0 : *bloom) | bloom_bits(value.s, value.length);
+        }
+    }
+    changed(block_id);
+}
+
+/**
+ * Empty a block's zone (which makes an unknown one known).
+ * @param block_id  the block
+ */
+void ZoneMap::clear(BlockID block_id) {
+    u_char *zone = this->zone(block_id);
+    memset(zone, 0, this->zone_size);
+    zone[0] = EMPTY;
+    changed(block_id);
+}
+
+/**
+ * Check each block's zone against the where clause. Blocks without rows are never wanted, and blocks
+ * with unknown zones always are.
+ * @param where  the where clause
+ * @return       the wanted blocks (empty if they all are)
+ */
+vector<bool> ZoneMap::candidates(const Predicate &where) const {
+    vector<bool> wanted;
+    if (where.is_true())
+        return wanted;
+    BlockID blocks = (BlockID) (this->zones.size() / this->zone_size);
+    wanted.assign(blocks, true);
+    for (BlockID i = 0; i < blocks; i++) {
+        const u_char *zone = this->zones.data() + (size_t) i * this->zone_size;
+        if (zone[0] == EMPTY)
+            wanted[i] = false;
+        else if (zone[0] == ROWS)
+            wanted[i] = where.may_match(ZoneSummary(*this, zone));
+    }
+    return wanted;
+}
+
+/**
+ * Get the range of an INT column's values in the zone.
+ * @param ordinal  which column
+ * @param min      set to the least value
+ * @param max      set to the greatest value
+ * @return         false for a TEXT column
+ */
+bool ZoneMap::ZoneSummary::range(uint ordinal, int32_t &min, int32_t &max) const {
+    if (this->map.column_types[ordinal] != ColumnAttribute::INT)
+        return false;
+    const int32_t *range = (const int32_t *) (this->zone + ZONE_HEADER_SZ + FIELD_SZ * ordinal);
+    min = range[0];
+    max = range[1];
+    return true;
+}
+
+/**
+ * Check a value against the column's range or Bloom filter.
+ * @param ordinal  which column
+ * @param value    the value
+ * @return         false if no row in the zone has it
+ */
+bool ZoneMap::ZoneSummary::may_contain(uint ordinal, const Value &value) const {
+    const u_char *field = this->zone + ZONE_HEADER_SZ + FIELD_SZ * ordinal;
+    if (this->map.column_types[ordinal] == ColumnAttribute::INT)
+        return ((const int32_t *) field)[0] <= value.n && value.n <= ((const int32_t *) field)[1];
+    u_int64_t bits = bloom_bits(value.s.data(), (u_int16_t) value.s.length());
+    return (*(const u_int64_t *) field & bits) == bits;
+}
+
+/**
+ * Find a block's zone, adding empty zones for any blocks past the end of the map.
+ * @param block_id  the block
+ * @return          its zone_size bytes
+ */
+u_char *ZoneMap::zone(BlockID block_id) {
+    size_t offset = (size_t) (block_id - 1) * this->zone_size;
+    if (offset >= this->zones.size())
+        this->zones.resize(offset + this->zone_size, 0);  // all zeros is an empty zone
+    return this->zones.data() + offset;
+}
+
+/**
+ * Note that a block's zone has changed, marking the file as no longer current the first time.
+ * @param block_id  the block
+ */
+void ZoneMap::changed(BlockID block_id) {
+    if (this->current)
+        put_header(false);
+    uint record = (block_id - 1) / this->zones_per_record;
+    if (record >= this->dirty.size())
+        this->dirty.resize(record + 1, false);
+    this->dirty[record] = true;
+}
+
+/**
+ * Write the header record right away: whether the zones in the file are current, and the size of a zone.
+ * @param is_current  whether they are
+ */
+void ZoneMap::put_header(bool is_current) {
+    vector<u_char> buffer(this->record_size, 0);
+    *(u_int32_t *) buffer.data() = is_current;
+    *(u_int32_t *) (buffer.data() + 4) = this->zone_size;
+    db_recno_t record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data(buffer.data(), this->record_size);
+    this->db.put(nullptr, &key, &data, 0);
+    this->current = is_current;
+}
+
+/**
+ * The two bits a TEXT value sets in a Bloom filter, from an FNV-1a hash of its bytes.
+ * @param s       the value's bytes
+ * @param length  how many
+ * @return        the bits
+ */
+u_int64_t ZoneMap::bloom_bits(const char *s, u_int16_t length) {
+    u_int64_t hash = 14695981039346656037ULL;
+    for (u_int16_t i = 0; i < length; i++) {
+        hash ^= (u_char) s[i];
+        hash *= 1099511628211ULL;
+    }
+    return (1ULL << (hash & 63)) | (1ULL << ((hash >> 32) & 63));
+}
+
+/**
+ * Test helper. A row of the test's table, a INT and b TEXT.
+ */
+static Row test_zone_row(const ColumnNames &column_names, int a, string b) {
+    Row row(&column_names);
+    row[0] = Value(a);
+    row[1] = Value(b);
+    return row;
+}
+
+/**
+ * Testing function for ZoneMap.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_zone_map() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    ValueDict where;
+    where["a"] = Value(15);
+    Predicate a_is_15(&where, column_names, column_attributes);
+    where.clear();
+    where["b"] = Value(string("two"));
+    Predicate b_is_two(&where, column_names, column_attributes);
+
+    ZoneMap zm("_test_zone_map_cpp", column_attributes);
+    zm.create();
+    zm.add(1, RowFieldReader(test_zone_row(column_names, 10, "one")));
+    zm.add(1, RowFieldReader(test_zone_row(column_names, 20, "one")));
+    zm.add(3, RowFieldReader(test_zone_row(column_names, 30, "two")));
+    vector<bool> wanted = zm.candidates(a_is_15);
+    if (wanted != vector<bool>({true, false, false}))
+        return assertion_failure("candidates by range");
+    wanted = zm.candidates(b_is_two);
+    if (wanted.size() != 3 || wanted[1] || !wanted[2])
+        return assertion_failure("candidates by bloom filter");
+    if (!zm.candidates(Predicate()).empty())
+        return assertion_failure("candidates with no where clause");
+
+    // rebuilding a zone narrows it
+    zm.clear(1);
+    zm.add(1, RowFieldReader(test_zone_row(column_names, 20, "one")));
+    if (zm.candidates(a_is_15)[0])
+        return assertion_failure("candidates after rebuild");
+
+    // zones persist if flushed, and are unknown if not
+    zm.close();
+    zm.open(3);
+    wanted = zm.candidates(a_is_15);  // a whole record's worth of zones, the rest of them empty
+    if (wanted.size() < 3 || find(wanted.begin(), wanted.end(), true) != wanted.end())
+        return assertion_failure("reopened map");
+    zm.add(2, RowFieldReader(test_zone_row(column_names, 15, "three")));
+    ZoneMap unflushed("_test_zone_map_cpp", column_attributes);
+    unflushed.open(3);
+    if (unflushed.candidates(a_is_15) != vector<bool>({true, true, true}))
+        return assertion_failure("map that wasn't flushed");
+    unflushed.add(4, RowFieldReader(test_zone_row(column_names, 40, "four")));
+    if (unflushed.candidates(a_is_15) != vector<bool>({true, true, true, false}))
+        return assertion_failure("new block of map that wasn't flushed");
+    unflushed.close();
+    zm.close();
+    zm.drop();
+    return true;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file ZoneMap.h - Persistent summaries of the values in each block of a HeapTable.
+ * ZoneMap
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+#include "Predicate.h"
+
+/**
+ * @class ZoneMap - a zone (summary of the rows) for every block of a heap table, so that a scan can
+ * skip the blocks a where clause rules out without reading them
+ *
+ * A block's zone says whether the block is home to any rows and, for each column, the least and greatest
+ * INT value or a 64-bit Bloom filter of the TEXT values (two bits per value). A row that has been moved
+ * to another block (see SlottedPage) counts in its home block's zone, since that is where a scan meets it.
+ * Adding and updating rows only ever widen a zone; deleting a row has the table summarize its block
+ * again from the rows that are left (see clear()).
+ *
+ * The zones are kept in memory and written back to their own Berkeley DB RecNo file (<table>.zm.db)
+ * when the map is flushed or closed, like a FreeSpaceMap. Unlike a free space class, a zone that is
+ * too narrow gives wrong answers, so the first record of the file says whether the zones in it are
+ * current; it is cleared (and written through) the first time a zone changes after a flush. A map opened
+ * from a file that wasn't flushed, or that is missing, knows nothing about the blocks the table had then.
+ * A block whose zone is unknown is never skipped, until the table summarizes it again.
+ */
+class ZoneMap {
+public:
+    ZoneMap(std::string name, const ColumnAttributes &column_attributes);
+
+    virtual ~ZoneMap() {}
+
+    ZoneMap(const ZoneMap &other) = delete;
+
+    ZoneMap(ZoneMap &&temp) = delete;
+
+    ZoneMap &operator=(const ZoneMap &other) = delete;
+
+    ZoneMap &operator=(ZoneMap &&temp) = delete;
+
+    /**
+     * Start an empty map for a new table, replacing any old map file.
+     */
+    virtual void create();
+
+    /**
+     * Open the map, creating its file if it doesn't exist yet.
+     * @param last_block  the table's last block id (the zones of blocks up to it are unknown if the
+     *                    file isn't current)
+     */
+    virtual void open(BlockID last_block);
+
+    /**
+     * Write back the map and close its file.
+     */
+    virtual void close();
+
+    /**
+     * Remove the map's file.
+     */
+    virtual void drop();
+
+    /**
+     * Write back the zones that have changed since the last flush.
+     */
+    virtual void flush();
+
+    /**
+     * Widen a block's zone to cover a row whose home is the block.
+     * @param block_id  the block
+     * @param fields    the row's fields
+     */
+    virtual void add(BlockID block_id, const FieldReader &fields);
+
+    /**
+     * Empty a block's zone, so it can be summarized again by adding each of the block's rows.
+     * @param block_id  the block
+     */
+    virtual void clear(BlockID block_id);
+
+    /**
+     * Find the blocks that could have rows satisfying a where clause.
+     * @param where  the where clause
+     * @returns      wanted[block_id - 1] is false if the block has no such rows (blocks past the end
+     *               are wanted); empty if every block is
+     */
+    virtual std::vector<bool> candidates(const Predicate &where) const;
+
+protected:
+    /**
+     * A block's zone, seen as what is known about each column's values.
+     */
+    class ZoneSummary : public FieldSummary {
+    public:
+        ZoneSummary(const ZoneMap &map, const u_char *zone) : map(map), zone(zone) {}
+
+        virtual bool range(uint ordinal, int32_t &min, int32_t &max) const;
+
+        virtual bool may_contain(uint ordinal, const Value &value) const;
+
+    protected:
+        const ZoneMap &map;
+        const u_char *zone;
+    };
+
+    enum ZoneState {
+        EMPTY = 0, UNKNOWN = 1, ROWS = 2  // all zeros is an empty zone
+    };
+
+    static const uint ZONE_HEADER_SZ = 8;  // state, padding
+    static const uint FIELD_SZ = 8;        // INT: least and greatest value; TEXT: Bloom filter
+
+    std::string dbfilename;
+    std::vector<ColumnAttribute::DataType> column_types;
+    uint zone_size;
+    uint record_size;
+    uint zones_per_record;
+    bool closed;
+    bool current;                 // the file's header says its zones are current
+    Db db;
+    std::vector<u_char> zones;    // zone_size bytes for each block, from block 1
+    std::vector<bool> dirty;      // dirty[i]: i-th record of zones needs writing back
+
+    u_char *zone(BlockID block_id);
+
+    void changed(BlockID block_id);
+
+    void put_header(bool is_current);
+
+    static u_int64_t bloom_bits(const char *s, u_int16_t length);
+
+    friend bool test_zone_map();
+};
+
+bool test_zone_map();
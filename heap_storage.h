@@ -3,11 +3,17 @@
  * SlottedPage: DbBlock
  * HeapFile: DbFile
  * HeapTable: DbRelation
+ * BufferPool: cache of pinned SlottedPages in front of a HeapFile
+ * FreeSpaceMap: free space class of each block of a HeapFile
+ * ZoneMap: summary of the rows in each block of a HeapTable
  *
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
 #pragma once
 #include "SlottedPage.h"
+#include "FreeSpaceMap.h"
+#include "ZoneMap.h"
 #include "HeapFile.h"
+#include "BufferPool.h"
 #include "HeapTable.h"
@@ -3,6 +3,9 @@
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
+#include <algorithm>
+#include <map>
+#include <set>
 #include "schema_tables.h"
 #include "ParseTreeToString.h"
 
@@ -14,6 +17,9 @@ void initialize_schema_tables() {
     Columns columns;
     columns.create_if_not_exists();
     columns.close();
+    Indices indices;
+    indices.create_if_not_exists();
+    indices.close();
 }
 
 // Not terribly useful since the parser weeds most of these out
@@ -36,6 +42,31 @@ bool is_acceptable_data_type(std::string dt) {
     return dt == "INT" || dt == "TEXT";  // for now
 }
 
+bool is_acceptable_storage(std::string storage) {
+    return storage == Tables::HEAP_STORAGE || storage == Tables::COLUMN_STORAGE;
+}
+
+bool is_acceptable_index_type(std::string index_type) {
+    return index_type == Indices::BTREE_INDEX || index_type == Indices::HASH_INDEX
+           || index_type == Indices::BLOOM_FILTER;
+}
+
+bool is_acceptable_page_size(int32_t page_size) {
+    if (page_size < (int32_t) DbBlock::BLOCK_SZ || page_size > (int32_t) DbBlock::MAX_BLOCK_SZ)
+        return false;
+    return (page_size & (page_size - 1)) == 0;  // power of two
+}
+
+// Open a schema table's internal index (building it if the table is older than it) and keep it up to date.
+void open_name_index(DbRelation &table, DbIndex &index) {
+    try {
+        index.open();
+    } catch (DbException &e) {
+        index.create();
+    }
+    table.attach(&index);
+}
+
 
 /*
  * ***************************
@@ -43,33 +74,51 @@ bool is_acceptable_data_type(std::string dt) {
  * ***************************
  */
 const Identifier Tables::TABLE_NAME = "_tables";
+const Identifier Tables::HEAP_STORAGE = "HEAP";
+const Identifier Tables::COLUMN_STORAGE = "COLUMN";
 Columns *Tables::columns_table = nullptr;
+Indices *Tables::indices_table = nullptr;
 std::map<Identifier, DbRelation *> Tables::table_cache;
 
-// get the column name for _tables column
+// get the column names for _tables columns
 ColumnNames &Tables::COLUMN_NAMES() {
     static ColumnNames cn;
-    if (cn.empty())
+    if (cn.empty()) {
         cn.push_back("table_name");
+        cn.push_back("page_size");
+        cn.push_back("storage");
+    }
     return cn;
 }
 
-// get the column attribute for _tables column
+// get the column attributes for _tables columns
 ColumnAttributes &Tables::COLUMN_ATTRIBUTES() {
     static ColumnAttributes cas;
     if (cas.empty()) {
-        ColumnAttribute ca(ColumnAttribute::TEXT);
-        cas.push_back(ca);
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::INT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
     }
     return cas;
 }
 
-// ctor - we have a fixed table structure of just one column: table_name
-Tables::Tables() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+// ctor - we have a fixed table structure of three columns: table_name, page_size, storage
+Tables::Tables() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()),
+                   name_index(*this, "pk", ColumnNames({"table_name"}), true) {
     Tables::table_cache[TABLE_NAME] = this;
     if (Tables::columns_table == nullptr)
         columns_table = new Columns();
     Tables::table_cache[columns_table->TABLE_NAME] = columns_table;
+    if (Tables::indices_table == nullptr)
+        indices_table = new Indices();
+    Tables::table_cache[indices_table->TABLE_NAME] = indices_table;
+}
+
+// dtor - a Tables that goes away (like initialize_schema_tables') must not be left in the cache for close_all()
+Tables::~Tables() {
+    auto cached = Tables::table_cache.find(TABLE_NAME);
+    if (cached != Tables::table_cache.end() && cached->second == this)
+        Tables::table_cache.erase(cached);
 }
 
 // Create the file and also, manually add schema tables.
@@ -80,17 +129,44 @@ void Tables::create() {
     insert(&row);
     row["table_name"] = Value("_columns");
     insert(&row);
+    row["table_name"] = Value("_indices");
+    insert(&row);
+}
+
+// Open the file and the index on table_name.
+void Tables::open() {
+    HeapTable::open();
+    open_name_index(*this, this->name_index);
 }
 
-// Manually check that table_name is unique.
+// Close the file and the index on table_name.
+void Tables::close() {
+    this->name_index.close();
+    HeapTable::close();
+}
+
+// Manually check that table_name is unique and fill in the default page_size and storage.
 Handle Tables::insert(const ValueDict *row) {
     // Try SELECT * FROM _tables WHERE table_name = row["table_name"] and it should return nothing
-    Handles *handles = select(row);
+    // (looked up in the index on table_name)
+    ValueDict where;
+    where["table_name"] = row->at("table_name");
+    Handles *handles = select(&where);
     bool unique = handles->empty();
     delete handles;
     if (!unique)
         throw DbRelationError(row->at("table_name").s + " already exists");
-    return HeapTable::insert(row);
+
+    ValueDict full_row(*row);
+    if (full_row.find("page_size") == full_row.end())
+        full_row["page_size"] = Value((int32_t) DbBlock::BLOCK_SZ);
+    if (!is_acceptable_page_size(full_row["page_size"].n))
+        throw DbRelationError("unacceptable page size " + std::to_string(full_row["page_size"].n));
+    if (full_row.find("storage") == full_row.end())
+        full_row["storage"] = Value(HEAP_STORAGE);
+    if (!is_acceptable_storage(full_row["storage"].s))
+        throw DbRelationError("unacceptable storage engine '" + full_row["storage"].s + "'");
+    return HeapTable::insert(&full_row);
 }
 
 // Remove a row, but first remove from table cache if there
@@ -108,27 +184,37 @@ void Tables::del(Handle handle) {
     HeapTable::del(handle);
 }
 
+// Close the cached indices, then the cached tables (each of the schema tables closes its own index).
+void Tables::close_all() {
+    Indices::close_all();
+    for (auto const &table: Tables::table_cache)
+        table.second->close();
+}
+
 // Return a list of column names and column attributes for given table.
 void Tables::get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes) {
-    // SELECT * FROM _columns WHERE table_name = <table_name>
+    // SELECT * FROM _columns WHERE table_name = <table_name> ORDER BY ordinal (a range of the index on
+    // (table_name, ordinal, column_name))
     ValueDict where;
     where["table_name"] = table_name;
     Handles *handles = Tables::columns_table->select(&where);
 
+    std::map<int32_t, std::pair<Identifier, ColumnAttribute>> columns;  // by ordinal
     ColumnAttribute column_attribute;
     for (auto const &handle: *handles) {
         ValueDict *row = Tables::columns_table->project(
-                handle);  // get the row's values: {'column_name': <name>, 'data_type': <type>}
-
-        Identifier column_name = (*row)["column_name"].s;
-        column_names.push_back(column_name);
+                handle);  // get the row's values: {'column_name': <name>, 'data_type': <type>, 'ordinal': <n>}
 
         column_attribute.set_data_type((*row)["data_type"].s == "INT" ? ColumnAttribute::INT : ColumnAttribute::TEXT);
-        column_attributes.push_back(column_attribute);
+        columns[(*row)["ordinal"].n] = std::make_pair((*row)["column_name"].s, column_attribute);
 
         delete row;
     }
     delete handles;
+    for (auto const &column: columns) {
+        column_names.push_back(column.second.first);
+        column_attributes.push_back(column.second.second);
+    }
 }
 
 // Return a table for given table_name.
@@ -137,12 +223,33 @@ DbRelation &Tables::get_table(Identifier table_name) {
     if (Tables::table_cache.find(table_name) != Tables::table_cache.end())
         return *Tables::table_cache[table_name];
 
-    // otherwise assume it is a HeapTable (for now)
+    // otherwise build it with the page size and storage engine recorded in _tables
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles *handles = select(&where);
+    uint page_size = DbBlock::BLOCK_SZ;
+    Identifier storage = HEAP_STORAGE;
+    if (!handles->empty()) {
+        ValueDict *row = project(handles->at(0));
+        page_size = (uint) row->at("page_size").n;
+        storage = row->at("storage").s;
+        delete row;
+    }
+    delete handles;
+
     ColumnNames column_names;
     ColumnAttributes column_attributes;
     get_columns(table_name, column_names, column_attributes);
-    DbRelation *table = new HeapTable(table_name, column_names, column_attributes);
+    DbRelation *table;
+    if (storage == COLUMN_STORAGE)
+        table = new ColumnTable(table_name, column_names, column_attributes, page_size);
+    else
+        table = new HeapTable(table_name, column_names, column_attributes, page_size);
     Tables::table_cache[table_name] = table;
+
+    // keep its indices up to date
+    for (auto const &index_name: Tables::indices_table->get_index_names(table_name))
+        table->attach(&Tables::indices_table->get_index(*table, index_name));
     return *table;
 }
 
@@ -161,6 +268,7 @@ ColumnNames &Columns::COLUMN_NAMES() {
         cn.push_back("table_name");
         cn.push_back("column_name");
         cn.push_back("data_type");
+        cn.push_back("ordinal");
     }
     return cn;
 }
@@ -173,32 +281,89 @@ ColumnAttributes &Columns::COLUMN_ATTRIBUTES() {
         cas.push_back(ca);
         cas.push_back(ca);
         cas.push_back(ca);
+        ca.set_data_type(ColumnAttribute::INT);
+        cas.push_back(ca);
     }
     return cas;
 }
 
-// ctor - we have a fixed table structure of just one column: table_name
-Columns::Columns() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+// ctor - we have a fixed table structure of four columns: table_name, column_name, data_type, ordinal
+Columns::Columns() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()),
+                     name_index(*this, "pk", ColumnNames({"table_name", "ordinal", "column_name"}), true) {
 }
 
 // Create the file and also, manually add schema columns.
 void Columns::create() {
     HeapTable::create();
     ValueDict row;
-    row["data_type"] = Value("TEXT");  // all these are TEXT fields
+    row["data_type"] = Value("TEXT");  // all these are TEXT fields except _tables.page_size
     row["table_name"] = Value("_tables");
     row["column_name"] = Value("table_name");
+    row["ordinal"] = Value(0);
+    insert(&row);
+    row["column_name"] = Value("page_size");
+    row["data_type"] = Value("INT");
+    row["ordinal"] = Value(1);
+    insert(&row);
+    row["data_type"] = Value("TEXT");
+    row["column_name"] = Value("storage");
+    row["ordinal"] = Value(2);
     insert(&row);
     row["table_name"] = Value("_columns");
     row["column_name"] = Value("table_name");
+    row["ordinal"] = Value(0);
     insert(&row);
     row["column_name"] = Value("column_name");
+    row["ordinal"] = Value(1);
     insert(&row);
     row["column_name"] = Value("data_type");
+    row["ordinal"] = Value(2);
+    insert(&row);
+    row["column_name"] = Value("ordinal");
+    row["data_type"] = Value("INT");
+    row["ordinal"] = Value(3);
     insert(&row);
+    row["data_type"] = Value("TEXT");
+    row["table_name"] = Value("_indices");
+    row["column_name"] = Value("table_name");
+    row["ordinal"] = Value(0);
+    insert(&row);
+    row["column_name"] = Value("index_name");
+    row["ordinal"] = Value(1);
+    insert(&row);
+    row["column_name"] = Value("seq_in_index");
+    row["data_type"] = Value("INT");
+    row["ordinal"] = Value(2);
+    insert(&row);
+    row["column_name"] = Value("column_name");
+    row["data_type"] = Value("TEXT");
+    row["ordinal"] = Value(3);
+    insert(&row);
+    row["column_name"] = Value("index_type");
+    row["ordinal"] = Value(4);
+    insert(&row);
+    row["column_name"] = Value("is_unique");
+    row["data_type"] = Value("INT");
+    row["ordinal"] = Value(5);
+    insert(&row);
+    row["column_name"] = Value("is_included");
+    row["ordinal"] = Value(6);
+    insert(&row);
+}
+
+// Open the file and the index on (table_name, ordinal, column_name).
+void Columns::open() {
+    HeapTable::open();
+    open_name_index(*this, this->name_index);
 }
 
-// Manually check that (table_name, column_name) is unique.
+// Close the file and the index on (table_name, ordinal, column_name).
+void Columns::close() {
+    this->name_index.close();
+    HeapTable::close();
+}
+
+// Manually check that (table_name, column_name) and (table_name, ordinal) are unique.
 Handle Columns::insert(const ValueDict *row) {
     // Check that datatype is acceptable
     if (!is_acceptable_identifier(row->at("table_name").s))
@@ -209,7 +374,7 @@ Handle Columns::insert(const ValueDict *row) {
         throw DbRelationError("unacceptable data type '" + row->at("data_type").s + "'");
 
     // Try SELECT * FROM _columns WHERE table_name = row["table_name"] AND column_name = column_name["column_name"]
-    // and it should return nothing
+    // and it should return nothing (looked up in the index on (table_name, ordinal, column_name))
     ValueDict where;
     where["table_name"] = row->at("table_name");
     where["column_name"] = row->at("column_name");
@@ -219,5 +384,170 @@ Handle Columns::insert(const ValueDict *row) {
     if (!unique)
         throw DbRelationError("duplicate column " + row->at("table_name").s + "." + row->at("column_name").s);
 
+    // likewise for the column's place in the table
+    where.erase("column_name");
+    where["ordinal"] = row->at("ordinal");
+    handles = select(&where);
+    unique = handles->empty();
+    delete handles;
+    if (!unique)
+        throw DbRelationError("duplicate ordinal " + std::to_string(row->at("ordinal").n) + " for a column of " +
+                              row->at("table_name").s);
+
+    return HeapTable::insert(row);
+}
+
+
+/*
+ * ****************************
+ * Indices class implementation
+ * ****************************
+ */
+const Identifier Indices::TABLE_NAME = "_indices";
+const Identifier Indices::BTREE_INDEX = "BTREE";
+const Identifier Indices::HASH_INDEX = "HASH";
+const Identifier Indices::BLOOM_FILTER = "BLOOM";
+std::map<std::pair<Identifier, Identifier>, DbIndex *> Indices::index_cache;
+
+// get the column names for _indices columns
+ColumnNames &Indices::COLUMN_NAMES() {
+    static ColumnNames cn;
+    if (cn.empty()) {
+        cn.push_back("table_name");
+        cn.push_back("index_name");
+        cn.push_back("seq_in_index");
+        cn.push_back("column_name");
+        cn.push_back("index_type");
+        cn.push_back("is_unique");
+        cn.push_back("is_included");
+    }
+    return cn;
+}
+
+// get the column attributes for _indices columns
+ColumnAttributes &Indices::COLUMN_ATTRIBUTES() {
+    static ColumnAttributes cas;
+    if (cas.empty()) {
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::INT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::INT));
+        cas.push_back(ColumnAttribute(ColumnAttribute::INT));
+    }
+    return cas;
+}
+
+// ctor - we have a fixed table structure of seven columns
+Indices::Indices() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()),
+                     name_index(*this, "pk", ColumnNames({"table_name", "index_name", "seq_in_index"}), true) {
+}
+
+// Open the file and the index on (table_name, index_name, seq_in_index).
+void Indices::open() {
+    HeapTable::open();
+    open_name_index(*this, this->name_index);
+}
+
+// Close the file and the index on (table_name, index_name, seq_in_index).
+void Indices::close() {
+    this->name_index.close();
+    HeapTable::close();
+}
+
+// Manually check that the names and the index type are acceptable.
+Handle Indices::insert(const ValueDict *row) {
+    if (!is_acceptable_identifier(row->at("index_name").s))
+        throw DbRelationError("unacceptable index name '" + row->at("index_name").s + "'");
+    if (!is_acceptable_index_type(row->at("index_type").s))
+        throw DbRelationError("unacceptable index type '" + row->at("index_type").s + "'");
     return HeapTable::insert(row);
 }
+
+// Remove a row, but first remove its index from the index cache if there
+// NOTE: detach the index from its table and drop it first.
+void Indices::del(Handle handle) {
+    ValueDict *row = project(handle);
+    std::pair<Identifier, Identifier> cache_key(row->at("table_name").s, row->at("index_name").s);
+    delete row;
+    if (Indices::index_cache.find(cache_key) != Indices::index_cache.end()) {
+        DbIndex *index = Indices::index_cache.at(cache_key);
+        Indices::index_cache.erase(cache_key);
+        delete index;
+    }
+    HeapTable::del(handle);
+}
+
+// Return the names of the indices of a table (in the order they were made).
+IndexNames Indices::get_index_names(Identifier table_name) {
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    where["seq_in_index"] = Value(1);  // one row per index
+    Handles *handles = select(&where);
+    IndexNames index_names;
+    ColumnNames column_names = {"index_name"};
+    for (auto const &handle: *handles) {
+        ValueDict *row = project(handle, &column_names);
+        index_names.push_back(row->at("index_name").s);
+        delete row;
+    }
+    delete handles;
+    return index_names;
+}
+
+// Return the key and included columns of an index in seq_in_index order, and what kind of index it is.
+void Indices::get_columns(Identifier table_name, Identifier index_name, ColumnNames &column_names,
+                          Identifier &index_type, bool &is_unique, ColumnNames &include_columns) {
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    where["index_name"] = Value(index_name);
+    Handles *handles = select(&where);
+    std::vector<std::pair<int32_t, Identifier>> columns;
+    std::set<Identifier> included;
+    for (auto const &handle: *handles) {
+        ValueDict *row = project(handle);
+        columns.push_back(std::make_pair(row->at("seq_in_index").n, row->at("column_name").s));
+        index_type = row->at("index_type").s;
+        is_unique = row->at("is_unique").n != 0;
+        if (row->at("is_included").n != 0)
+            included.insert(row->at("column_name").s);
+        delete row;
+    }
+    delete handles;
+    std::sort(columns.begin(), columns.end());
+    for (auto const &column: columns)
+        (included.count(column.second) ? include_columns : column_names).push_back(column.second);
+}
+
+// Return an index of a table.
+DbIndex &Indices::get_index(DbRelation &table, Identifier index_name) {
+    // if they are asking about an index we've once constructed, then just return that one
+    std::pair<Identifier, Identifier> cache_key(table.get_table_name(), index_name);
+    if (Indices::index_cache.find(cache_key) != Indices::index_cache.end())
+        return *Indices::index_cache[cache_key];
+
+    // otherwise build it with the key columns recorded in _indices
+    ColumnNames column_names;
+    Identifier index_type = BTREE_INDEX;
+    bool is_unique = false;
+    ColumnNames include_columns;
+    get_columns(table.get_table_name(), index_name, column_names, index_type, is_unique, include_columns);
+    if (column_names.empty())
+        throw DbRelationError("no index named '" + index_name + "' on table '" + table.get_table_name() + "'");
+    DbIndex *index;
+    if (index_type == BLOOM_FILTER)
+        index = new BloomFilter(table, index_name, column_names);
+    else if (index_type == HASH_INDEX)
+        index = new HashIndex(table, index_name, column_names, is_unique, include_columns);
+    else
+        index = new BTreeIndex(table, index_name, column_names, is_unique, include_columns);
+    Indices::index_cache[cache_key] = index;
+    return *index;
+}
+
+// Close every cached index.
+void Indices::close_all() {
+    for (auto const &index: Indices::index_cache)
+        index.second->close();
+}
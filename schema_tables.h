@@ -2,12 +2,17 @@
  * @file schema_tables.h - schema table classes:
  * 		Columns
  * 		Tables
+ * 		Indices
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
 #pragma once
 
 #include "heap_storage.h"
+#include "ColumnTable.h"
+#include "BTree.h"
+#include "HashIndex.h"
+#include "BloomFilter.h"
 
 /**
  * Initialize access to the schema tables.
@@ -16,13 +21,25 @@
  */
 void initialize_schema_tables();
 
+/**
+ * Whether a table's blocks can be a given size: a power of two from DbBlock::BLOCK_SZ to DbBlock::MAX_BLOCK_SZ.
+ * Whatever the page size, a marshaled row is at most SlottedPage::MAX_RECORD_SZ bytes (just under 32K), so
+ * pages over 32K hold more rows but not bigger ones.
+ * @param page_size  the size in bytes
+ */
+bool is_acceptable_page_size(int32_t page_size);
+
 
 class Columns; // forward declare
+class Indices;
 
 /**
  * @class Tables - The singleton table that stores the metadata for all other tables.
- * For now, we are not indexing anything, so a query requires sequential scan
- * of the table.
+ * Like the other schema tables, it keeps an internal unique index (not listed in _indices) on its key, here
+ * a hash index on table_name, so looking a table up doesn't scan the table however many there are.
+ * Each row has the table_name, the page_size its file is created with (defaults to DbBlock::BLOCK_SZ
+ * if the inserted row doesn't give one; rows are limited to SlottedPage::MAX_RECORD_SZ even in larger
+ * pages), and the storage engine that keeps it: HEAP (a HeapTable, the default) or COLUMN (a ColumnTable).
  */
 class Tables : public HeapTable {
 public:
@@ -31,14 +48,24 @@ public:
      */
     static const Identifier TABLE_NAME;
 
+    /**
+     * Storage engines a table can have ("HEAP" and "COLUMN")
+     */
+    static const Identifier HEAP_STORAGE;
+    static const Identifier COLUMN_STORAGE;
+
     // ctor/dtor
     Tables();
 
-    virtual ~Tables() {}
+    virtual ~Tables();
 
     // HeapTable overrides
     virtual void create();
 
+    virtual void open();
+
+    virtual void close();
+
     virtual Handle insert(const ValueDict *row);
 
     virtual void del(Handle handle);
@@ -47,7 +74,7 @@ public:
      * Get the columns and their attributes for a given table.
      * @param table_name         table to get column info for
      * @param column_names       returned by reference: list of column names
-     *                           for table_name
+     *                           for table_name, in the order they were declared
      * @param column_attributes  returned by reference: list of corresponding
      *                           attributes for column_names
      */
@@ -60,15 +87,33 @@ public:
      */
     virtual DbRelation &get_table(Identifier table_name);
 
+    /**
+     * Get the indices table (which get_table() uses to attach each table's indices to it).
+     * @returns  the _indices table
+     */
+    virtual Indices &get_indices() { return *indices_table; }
+
+    /**
+     * Close every table (the schema tables too) and index instantiated so far, writing out whatever they
+     * still hold in memory, e.g., before the program exits. Each one opens again when it is next used.
+     */
+    static void close_all();
+
 protected:
     // hard-coded columns for _tables table
     static ColumnNames &COLUMN_NAMES();
 
     static ColumnAttributes &COLUMN_ATTRIBUTES();
 
+    // unique index on table_name
+    HashIndex name_index;
+
     // keep a reference to the columns table (for get_columns method)
     static Columns *columns_table;
 
+    // and to the indices table (for get_table method)
+    static Indices *indices_table;
+
 private:
     // keep a cache of all the tables we've instantiated so far
     static std::map<Identifier, DbRelation *> table_cache;
@@ -77,6 +122,8 @@ private:
 
 /**
  * @class Columns - The singleton table that stores the column metadata for all tables.
+ * Each column's ordinal keeps the table's columns in the order they were declared. Its internal unique
+ * B+tree index on (table_name, ordinal, column_name) finds all of a table's columns in that order.
  */
 class Columns : public HeapTable {
 public:
@@ -93,6 +140,10 @@ public:
     // HeapTable overrides
     virtual void create();
 
+    virtual void open();
+
+    virtual void close();
+
     virtual Handle insert(const ValueDict *row);
 
 protected:
@@ -100,4 +151,90 @@ protected:
     static ColumnNames &COLUMN_NAMES();
 
     static ColumnAttributes &COLUMN_ATTRIBUTES();
+
+    // unique index on (table_name, ordinal, column_name)
+    BTreeIndex name_index;
+};
+
+
+/**
+ * @class Indices - The singleton table that stores the metadata for all indices.
+ * Each row is one column of an index: its table_name and index_name, seq_in_index (the column's
+ * place in the index, from 1), the column_name, the index_type (BTREE, HASH or BLOOM), is_unique (1 or 0) and
+ * is_included (1 for a column whose values the index carries but doesn't key on, numbered after the key's).
+ * Its internal unique B+tree index on (table_name, index_name, seq_in_index) also finds all of a table's or
+ * an index's rows.
+ */
+class Indices : public HeapTable {
+public:
+    /**
+     * Name of the indices table ("_indices")
+     */
+    static const Identifier TABLE_NAME;
+
+    /**
+     * Kinds of index there are ("BTREE", "HASH", "BLOOM")
+     */
+    static const Identifier BTREE_INDEX;
+    static const Identifier HASH_INDEX;
+    static const Identifier BLOOM_FILTER;
+
+    // ctor/dtor
+    Indices();
+
+    virtual ~Indices() {}
+
+    // HeapTable overrides
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handle insert(const ValueDict *row);
+
+    virtual void del(Handle handle);
+
+    /**
+     * Get the names of a table's indices.
+     * @param table_name  the table
+     * @returns           its index names
+     */
+    virtual IndexNames get_index_names(Identifier table_name);
+
+    /**
+     * Get the key and included columns and the kind of an index.
+     * @param table_name       the index's table
+     * @param index_name       the index
+     * @param column_names     returned by reference: the key columns, in order
+     * @param index_type       returned by reference: the kind of index
+     * @param is_unique        returned by reference: whether the index is unique
+     * @param include_columns  returned by reference: the included columns, in order
+     */
+    virtual void get_columns(Identifier table_name, Identifier index_name, ColumnNames &column_names,
+                             Identifier &index_type, bool &is_unique, ColumnNames &include_columns);
+
+    /**
+     * Get the correctly instantiated DbIndex for an index of a table (which is left to attach it).
+     * @param table       the index's table
+     * @param index_name  the index
+     * @returns           instantiated DbIndex of the correct type
+     */
+    virtual DbIndex &get_index(DbRelation &table, Identifier index_name);
+
+    /**
+     * Close every index instantiated so far (see Tables::close_all()).
+     */
+    static void close_all();
+
+protected:
+    // hard-coded columns for the _indices table
+    static ColumnNames &COLUMN_NAMES();
+
+    static ColumnAttributes &COLUMN_ATTRIBUTES();
+
+    // unique index on (table_name, index_name, seq_in_index)
+    BTreeIndex name_index;
+
+private:
+    // keep a cache of all the indices we've instantiated so far, by table and index name
+    static std::map<std::pair<Identifier, Identifier>, DbIndex *> index_cache;
 };
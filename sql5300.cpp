@@ -10,6 +10,7 @@
 #include "SQLParser.h"
 #include "ParseTreeToString.h"
 #include "SQLExec.h"
+#include "storage_bench.h"
 
 using namespace std;
 using namespace hsql;
@@ -44,10 +45,18 @@ int main(int argc, char *argv[]) {
             break;  // only way to get out
         if (query == "test") {
             cout << "test_heap_storage: " << (test_heap_storage() ? "ok" : "failed") << endl;
+            cout << "test_sql_exec: " << (test_sql_exec() ? "ok" : "failed") << endl;
+            continue;
+        }
+        if (query == "bench") {
+            cout << "bench_storage: " << (bench_storage() ? "ok" : "failed") << endl;
             continue;
         }
 
         // parse and execute
+        int32_t page_size = SQLExec::page_size_clause(query);
+        Identifier storage = SQLExec::storage_clause(query);
+        ColumnNames include_columns = SQLExec::include_clause(query);
         SQLParserResult *parse = SQLParser::parseSQLString(query);
         if (!parse->isValid()) {
             cout << "invalid SQL: " << query << endl;
@@ -57,7 +66,7 @@ int main(int argc, char *argv[]) {
                 const SQLStatement *statement = parse->getStatement(i);
                 try {
                     cout << ParseTreeToString::statement(statement) << endl;
-                    QueryResult *result = SQLExec::execute(statement);
+                    QueryResult *result = SQLExec::execute(statement, storage, include_columns, page_size);
                     cout << *result << endl;
                     delete result;
                 } catch (SQLExecError &e) {
@@ -67,6 +76,7 @@ int main(int argc, char *argv[]) {
         }
         delete parse;
     }
+    Tables::close_all();  // write out what the tables and indices still hold in memory
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,746 @@
+/**
+ * @file storage_bench.cpp - Microbenchmarks for the heap storage engine
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <thread>
+#include "SQLParser.h"
+#include "ColumnTable.h"
+#include "BTree.h"
+#include "HashIndex.h"
+#include "BloomFilter.h"
+#include "storage_bench.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace hsql;
+
+#ifdef COUNT_ALLOCATIONS
+/*
+ * Count every heap allocation in the process so the benchmarks can report allocations per row. Only the
+ * sql5300_bench build does (see the Makefile), so that the shell's own allocations don't pay for it.
+ */
+static atomic<u_long> allocations(0);
+
+// None of the replacements is inlined, so the compiler doesn't see malloc() paired with delete or free() with new
+// and warn. Every form of new and delete is replaced, so they all agree.
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void *operator new(size_t size, const nothrow_t &) noexcept {
+    allocations++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, const nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, const nothrow_t &) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, const nothrow_t &) noexcept {
+    free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+#endif
+#else
+static const u_long allocations = 0;  // not counted: the allocation checks pass trivially
+#endif
+
+/**
+ * Print one benchmark result line.
+ * @param name         what was measured
+ * @param rows         number of rows processed
+ * @param allocs       heap allocations made while processing them
+ * @param elapsed      time taken
+ */
+static void report(string name, u_long rows, u_long allocs, duration<double> elapsed) {
+    cout << "  " << name << ": " << rows << " rows, ";
+#ifdef COUNT_ALLOCATIONS
+    cout << (double) allocs / rows << " allocs/row, ";
+#endif
+    cout << (elapsed.count() > 0 ? rows / elapsed.count() : 0) << " rows/s" << endl;
+}
+
+/**
+ * A scan of a whole file, reading every record with SlottedPage::get (one Dbt allocated per record) versus
+ * SlottedPage::view (in place). Either way the scan itself allocates a little per bulk read.
+ * @return  true if view() made no allocations per record (fewer than one per block in all)
+ */
+static bool bench_record_access() {
+    const BlockID BLOCKS = 2000;
+    HeapFile file("_bench_record_access");
+    file.create();
+    char rec[32];
+    memset(rec, 'x', sizeof(rec));
+    Dbt rec_dbt(rec, sizeof(rec));
+    for (BlockID block_id = 1; block_id <= BLOCKS; block_id++) {
+        SlottedPage *page = block_id == 1 ? file.get(1) : file.get_new();
+        try {
+            while (true)
+                page->add(&rec_dbt);
+        } catch (DbBlockNoRoomError &e) {
+            // page is full
+        }
+        file.put(page);
+        delete page;
+    }
+    u_long checksum = 0;
+
+    u_long rows = 0;
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    {
+        HeapFileScan scan(file);
+        BlockID block_id;
+        Dbt block_dbt;
+        while (scan.next(block_id, block_dbt)) {
+            SlottedPage page(block_dbt, block_id);
+            for (RecordID record_id: page.records()) {
+                Dbt *record = page.get(record_id);
+                checksum += record->get_size();
+                delete record;
+                rows++;
+            }
+        }
+    }
+    u_long get_allocs = allocations - before;
+    report("SlottedPage::get  scan", rows, get_allocs, steady_clock::now() - start);
+
+    u_long viewed = 0;
+    before = allocations;
+    start = steady_clock::now();
+    {
+        HeapFileScan scan(file);
+        BlockID block_id;
+        Dbt block_dbt;
+        RecordView record;
+        while (scan.next(block_id, block_dbt)) {
+            SlottedPage page(block_dbt, block_id);
+            for (RecordID record_id: page.records())
+                if (page.view(record_id, record)) {
+                    checksum -= record.size;
+                    viewed++;
+                }
+        }
+    }
+    u_long view_allocs = allocations - before;
+    report("SlottedPage::view scan", viewed, view_allocs, steady_clock::now() - start);
+
+    file.drop();
+    return viewed == rows && checksum == 0 && get_allocs >= (allocations == 0 ? 0 : rows) && view_allocs < BLOCKS;
+}
+
+/**
+ * Insert and scan throughput of the same table at 4K, 16K and 64K pages, with rows of a medium-sized TEXT
+ * column, which waste the tail of every small page.
+ * @return  true if every table scanned back all its rows
+ */
+static bool bench_page_sizes() {
+    const int ROWS = 5000;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    ValueDict row;
+    row["b"] = Value(string(1500, 'b'));
+    for (uint page_size: {DbBlock::BLOCK_SZ, 4 * DbBlock::BLOCK_SZ, DbBlock::MAX_BLOCK_SZ}) {
+        HeapTable table("_bench_page_size_" + to_string(page_size), column_names, column_attributes, page_size);
+        table.create();
+
+        u_long before = allocations;
+        auto start = steady_clock::now();
+        Handle handle;
+        for (int i = 0; i < ROWS; i++) {
+            row["a"] = Value(i);
+            handle = table.insert(&row);
+        }
+        report(to_string(page_size / 1024) + "K insert", ROWS, allocations - before, steady_clock::now() - start);
+
+        before = allocations;
+        start = steady_clock::now();
+        Handles *handles = table.select();
+        u_long rows = 0;
+        for (auto const &h: *handles) {
+            ValueDict *result = table.project(h);
+            rows += (*result)["a"].n >= 0;
+            delete result;
+        }
+        delete handles;
+        report(to_string(page_size / 1024) + "K scan  ", rows, allocations - before, steady_clock::now() - start);
+        cout << "    " << handle.first << " blocks, " << (double) handle.first * page_size / ROWS << " bytes/row" << endl;
+        table.drop();
+        if (rows != ROWS)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Scan throughput of a freshly reopened heap file: one keyed Db::get per block versus a bulk cursor scan.
+ * @return  true if both scans saw all the records
+ */
+static bool bench_bulk_scan() {
+    const BlockID BLOCKS = 5000;
+    HeapFile file("_bench_bulk_scan");
+    file.create();
+    char rec[100];
+    memset(rec, 'r', sizeof(rec));
+    Dbt rec_dbt(rec, sizeof(rec));
+    u_long written = 0;
+    for (BlockID block_id = 1; block_id <= BLOCKS; block_id++) {
+        SlottedPage *page = block_id == 1 ? file.get(1) : file.get_new();
+        try {
+            while (true) {
+                page->add(&rec_dbt);
+                written++;
+            }
+        } catch (DbBlockNoRoomError &e) {
+            // page is full
+        }
+        file.put(page);
+        delete page;
+    }
+    file.close();
+
+    file.open();
+    u_long keyed = 0;
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    for (BlockID block_id: file.blocks()) {
+        SlottedPage *page = file.get(block_id);
+        for (RecordID record_id: page->records())
+            keyed += record_id != 0;
+        delete page;
+    }
+    report("keyed Db::get scan", keyed, allocations - before, steady_clock::now() - start);
+    file.close();
+
+    file.open();
+    u_long bulk = 0;
+    before = allocations;
+    start = steady_clock::now();
+    {
+        HeapFileScan scan(file);
+        BlockID block_id;
+        Dbt block_dbt;
+        while (scan.next(block_id, block_dbt)) {
+            SlottedPage page(block_dbt, block_id);
+            for (RecordID record_id: page.records())
+                bulk += record_id != 0;
+        }
+    }
+    report("bulk cursor scan  ", bulk, allocations - before, steady_clock::now() - start);
+    file.drop();
+    return keyed == written && bulk == written;
+}
+
+/**
+ * Insertion of rows with a few columns from one reused positional Row, then projection of every row:
+ * into a new ValueDict per row (of all the columns, then of just the last one) versus into one reused
+ * positional Row. Then a select whose where clause is checked in place.
+ * @return  true if the positional insertion and projection averaged less than one allocation per row
+ *          (only new blocks and buffer pool misses)
+ */
+static bool bench_row_projection() {
+    const int ROWS = 5000;
+    ColumnNames column_names = {"a", "b", "c", "d", "e", "f"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable table("_bench_row_projection", column_names, column_attributes);
+    table.create();
+    Row row(&column_names);
+    row[1] = Value(string(40, 'b'));
+    row[3] = Value(string(40, 'd'));
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    for (int i = 0; i < ROWS; i++) {
+        row[0].n = row[2].n = row[4].n = row[5].n = i;
+        table.insert(&row);
+    }
+    report("Row insert       ", ROWS, allocations - before, steady_clock::now() - start);
+    u_long insert_allocs = allocations - before;
+    Handles *handles = table.select();
+
+    long checksum = 0;
+    before = allocations;
+    start = steady_clock::now();
+    for (auto const &handle: *handles) {
+        ValueDict *result = table.project(handle);
+        checksum += (*result)["f"].n;
+        delete result;
+    }
+    report("ValueDict project", handles->size(), allocations - before, steady_clock::now() - start);
+
+    ColumnNames last_column = {"f"};
+    before = allocations;
+    start = steady_clock::now();
+    for (auto const &handle: *handles) {
+        ValueDict *result = table.project(handle, &last_column);
+        checksum += (*result)["f"].n;
+        delete result;
+    }
+    report("narrow project   ", handles->size(), allocations - before, steady_clock::now() - start);
+    for (auto const &handle: *handles) {
+        ValueDict *result = table.project(handle);
+        checksum -= (*result)["f"].n;
+        delete result;
+    }
+
+    table.project(handles->front(), row);  // size the row's strings
+    before = allocations;
+    start = steady_clock::now();
+    for (auto const &handle: *handles) {
+        table.project(handle, row);
+        checksum -= row[5].n;
+    }
+    u_long row_allocs = allocations - before;
+    report("Row project      ", handles->size(), row_allocs, steady_clock::now() - start);
+
+    ValueDict where;
+    where["d"] = Value(string(40, 'd'));
+    where["f"] = Value(ROWS / 2);
+    before = allocations;
+    start = steady_clock::now();
+    Handles *selected = table.select(&where);
+    report("select where     ", handles->size(), allocations - before, steady_clock::now() - start);
+    bool one_selected = selected->size() == 1;
+    delete selected;
+
+    u_long handles_size = handles->size();
+    delete handles;
+    table.drop();
+    return insert_allocs < ROWS && row_allocs < handles_size && one_selected && checksum == 0;
+}
+
+/**
+ * Loading a table row by row with insert() versus in batches with insert_many(), counting the pages
+ * written back to the file.
+ * @return  true if the bulk load wrote each of its blocks once
+ */
+static bool bench_bulk_load() {
+    const int ROWS = 200000, BATCH = 10000;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    Row row(&column_names);
+    row[1] = Value(string(60, 'b'));
+
+    HeapTable single("_bench_insert", column_names, column_attributes);
+    single.create();
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    Handle handle;
+    for (int i = 0; i < ROWS; i++) {
+        row[0].n = i;
+        handle = single.insert(&row);
+    }
+    single.close();
+    report("insert     ", ROWS, allocations - before, steady_clock::now() - start);
+    cout << "    " << single.get_buffer_pool().get_writes() << " page writes for " << handle.first << " blocks" << endl;
+    single.drop();
+
+    HeapTable bulk("_bench_insert_many", column_names, column_attributes);
+    bulk.create();
+    Rows batch(BATCH, row);
+    before = allocations;
+    start = steady_clock::now();
+    for (int i = 0; i < ROWS; i += BATCH) {
+        for (int j = 0; j < BATCH; j++)
+            batch[j][0].n = i + j;
+        Handles *handles = bulk.insert_many(&batch);
+        handle = handles->back();
+        delete handles;
+    }
+    bulk.close();
+    report("insert_many", ROWS, allocations - before, steady_clock::now() - start);
+    u_long writes = bulk.get_buffer_pool().get_writes();
+    cout << "    " << writes << " page writes for " << handle.first << " blocks" << endl;
+    bulk.drop();
+    return writes == handle.first;
+}
+
+/**
+ * A filtered full scan with select(where) versus the parallel select(where, workers) at increasing
+ * numbers of workers, on a warm cache.
+ * @return  true if every run selected the same rows
+ */
+static bool bench_parallel_scan() {
+    const int ROWS = 400000;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable table("_bench_parallel_scan", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i = 0; i < ROWS; i++) {
+        row[0] = Value(i);
+        row[1] = Value(string(20 + i % 40, 'b'));
+        row[2] = Value(i % 1000);
+        rows.push_back(row);
+    }
+    delete table.insert_many(&rows);
+    rows.clear();
+    SQLParserResult *parse = SQLParser::parseSQLString(
+            "SELECT * FROM t WHERE (c BETWEEN 100 AND 200 OR c IN (500, 600, 700)) AND b <> 'x'");
+    Predicate where(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names, column_attributes);
+    delete parse;
+
+    delete table.select(where);  // warm the cache
+    auto start = steady_clock::now();
+    Handles *expected = table.select(where);
+    duration<double> serial = steady_clock::now() - start;
+    report("select where      ", ROWS, 0, serial);
+    bool same = true;
+    uint max_workers = max(thread::hardware_concurrency(), 4U);
+    for (uint workers = 1; workers <= max_workers; workers *= 2) {
+        start = steady_clock::now();
+        Handles *handles = table.select(where, workers);
+        duration<double> elapsed = steady_clock::now() - start;
+        report("parallel, " + to_string(workers) + " workers", ROWS, 0, elapsed);
+        cout << "    speedup " << serial.count() / elapsed.count() << "x" << endl;
+        same = same && *handles == *expected;
+        delete handles;
+    }
+    cout << "    " << expected->size() << " rows selected" << endl;
+    delete expected;
+    table.drop();
+    return same;
+}
+
+/**
+ * SELECT a, c ... WHERE ... row at a time (select(), then project() for each handle) versus a
+ * vectorized scan that filters and projects whole column vectors.
+ * @return  true if both found the same rows and values
+ */
+static bool bench_batch_scan() {
+    const int ROWS = 200000;
+    ColumnNames column_names = {"a", "b", "c", "d"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_bench_batch_scan", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i = 0; i < ROWS; i++) {
+        row[0] = Value(i);
+        row[1] = Value(string(10 + i % 30, 'b'));
+        row[2] = Value(i % 100);
+        row[3] = Value(string(20, 'd'));
+        rows.push_back(row);
+    }
+    delete table.insert_many(&rows);
+    rows.clear();
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE c < 50 AND b <> 'x'");
+    Predicate where(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names, column_attributes);
+    delete parse;
+    ColumnNames projected = {"a", "c"};
+
+    delete table.select(where);  // warm the cache
+    long row_sum = 0, batch_sum = 0;
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    Handles *handles = table.select(where);
+    Row values;
+    for (auto const &handle: *handles) {
+        table.project(handle, values);
+        row_sum += values[0].n + values[2].n;
+    }
+    report("select + project", ROWS, allocations - before, steady_clock::now() - start);
+    u_long row_count = handles->size();
+    delete handles;
+
+    Batch batch;
+    u_long batch_count = 0;
+    before = allocations;
+    start = steady_clock::now();
+    DbRelationScan *scan = table.scan(&projected, where);
+    while (scan->next(batch)) {
+        const int32_t *a = batch.columns[0].ints.data(), *c = batch.columns[1].ints.data();
+        for (uint i = 0; i < batch.size(); i++)
+            batch_sum += a[i] + c[i];
+        batch_count += batch.size();
+    }
+    delete scan;
+    report("batch scan      ", ROWS, allocations - before, steady_clock::now() - start);
+    table.drop();
+    return row_count == batch_count && row_sum == batch_sum;
+}
+
+/**
+ * A wide table queried for two of its columns, stored as a HeapTable and as a ColumnTable.
+ * @param table  the (empty, created) table to load and scan
+ * @param name   what to call it in the report
+ * @return       sum of the projected values of the selected rows
+ */
+static long bench_wide_table(DbRelation &table, string name) {
+    const int ROWS = 100000, COLUMNS = 12;
+    ColumnNames column_names;
+    for (int j = 0; j < COLUMNS; j++)
+        column_names.push_back("c" + to_string(j));
+    ValueDict row;
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLUMNS; j++)
+            row[column_names[j]] = j % 2 == 0 ? Value(i + j) : Value(string(16, (char) ('a' + j)));
+        table.insert(&row);
+    }
+    ColumnNames projected = {"c0", "c2"};
+    Predicate all;
+    long sum = 0;
+    u_long before = allocations;
+    auto start = steady_clock::now();
+    DbRelationScan *scan = table.scan(&projected, all);
+    Batch batch;
+    while (scan->next(batch))
+        for (uint i = 0; i < batch.size(); i++)
+            sum += batch.columns[0].ints[i] + batch.columns[1].ints[i];
+    delete scan;
+    report(name, ROWS, allocations - before, steady_clock::now() - start);
+    return sum;
+}
+
+/**
+ * SELECT c0, c2 FROM a 12-column table: row storage reads every column, column storage just the two.
+ * @return  true if both gave the same answer
+ */
+static bool bench_column_storage() {
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    for (int j = 0; j < 12; j++) {
+        column_names.push_back("c" + to_string(j));
+        column_attributes.push_back(ColumnAttribute(j % 2 == 0 ? ColumnAttribute::INT : ColumnAttribute::TEXT));
+    }
+    HeapTable heap("_bench_heap_wide", column_names, column_attributes);
+    heap.create();
+    long heap_sum = bench_wide_table(heap, "heap scan of 2 columns  ");
+    heap.drop();
+    ColumnTable columns("_bench_column_wide", column_names, column_attributes);
+    columns.create();
+    long column_sum = bench_wide_table(columns, "column scan of 2 columns");
+    cout << "    " << columns.get_segment_reads("c0") << " segments of c0 read, "
+         << columns.get_segment_reads("c1") << " of c1" << endl;
+    columns.drop();
+    return heap_sum == column_sum;
+}
+
+/**
+ * A range select on time-ordered rows, whose block zones rule out nearly the whole file, versus the same
+ * rows loaded in shuffled order, where every block has to be read.
+ * @param table  the (empty, created) table to load and query
+ * @param name   what to call it in the report
+ * @param order  the row numbers, in load order
+ * @return       number of rows selected
+ */
+static u_long bench_zoned_table(HeapTable &table, string name, const vector<int> &order) {
+    ColumnNames column_names = {"a", "b"};
+    Rows rows;
+    Row row(&column_names);
+    for (int i: order) {
+        row[0] = Value(i);
+        row[1] = Value(string(40, 'b'));
+        rows.push_back(row);
+    }
+    delete table.insert_many(&rows);
+    SQLParserResult *parse = SQLParser::parseSQLString("SELECT * FROM t WHERE a BETWEEN 100000 AND 101000");
+    Predicate where(((const SelectStatement *) parse->getStatement(0))->whereClause, column_names,
+                    {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)});
+    delete parse;
+    delete table.select(where);  // warm the cache
+    u_long before = table.get_blocks_scanned();
+    auto start = steady_clock::now();
+    Handles *handles = table.select(where);
+    report(name, (u_long) order.size(), 0, steady_clock::now() - start);
+    cout << "    " << table.get_blocks_scanned() - before << " blocks read" << endl;
+    u_long selected = handles->size();
+    delete handles;
+    return selected;
+}
+
+/**
+ * SELECT ... WHERE a BETWEEN ... on clustered and on shuffled rows (see bench_zoned_table).
+ * @return  true if both selected the same number of rows
+ */
+static bool bench_zone_map() {
+    const int ROWS = 400000;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    vector<int> order;
+    for (int i = 0; i < ROWS; i++)
+        order.push_back(i);
+    HeapTable clustered("_bench_zone_clustered", column_names, column_attributes);
+    clustered.create();
+    u_long clustered_rows = bench_zoned_table(clustered, "clustered range select", order);
+    clustered.drop();
+    shuffle(order.begin(), order.end(), mt19937(5300));
+    HeapTable shuffled("_bench_zone_shuffled", column_names, column_attributes);
+    shuffled.create();
+    u_long shuffled_rows = bench_zoned_table(shuffled, "shuffled range select ", order);
+    shuffled.drop();
+    return clustered_rows == 1001 && shuffled_rows == clustered_rows;
+}
+
+/**
+ * SELECT ... WHERE a = ... on shuffled rows, scanning past the zone maps, then through a B+tree index and
+ * then through a hash index; then a select for a deleted key, with and without a bloom filter on a.
+ * @return  true if all three found the one row, and neither missing-key select found any
+ */
+static bool bench_point_lookup() {
+    const int ROWS = 400000;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    vector<int> order;
+    for (int i = 0; i < ROWS; i++)
+        order.push_back(i);
+    shuffle(order.begin(), order.end(), mt19937(5300));
+    HeapTable table("_bench_point_lookup", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    Row row(&column_names);
+    for (int i: order) {
+        row[0] = Value(i);
+        row[1] = Value(string(40, 'b'));
+        rows.push_back(row);
+    }
+    delete table.insert_many(&rows);
+    ValueDict where;
+    where["a"] = Value(ROWS / 2);
+
+    delete table.select(&where);  // warm the cache
+    u_long before = table.get_blocks_scanned();
+    auto start = steady_clock::now();
+    Handles *handles = table.select(&where);
+    report("point select, no index   ", 1, 0, steady_clock::now() - start);
+    cout << "    " << table.get_blocks_scanned() - before << " blocks read" << endl;
+    u_long scanned = handles->size();
+    delete handles;
+
+    BTreeIndex index(table, "a", {"a"}, true);
+    index.create();
+    table.attach(&index);
+    delete table.select(&where);
+    before = index.get_node_reads();
+    start = steady_clock::now();
+    handles = table.select(&where);
+    report("point select, B+tree     ", 1, 0, steady_clock::now() - start);
+    cout << "    " << index.get_node_reads() - before << " index nodes read (height " << index.get_height()
+         << ")" << endl;
+    u_long looked_up = handles->size();
+    delete handles;
+    table.detach(&index);
+    index.drop();
+
+    HashIndex hash_index(table, "h", {"a"}, true);
+    hash_index.create();
+    table.attach(&hash_index);
+    delete table.select(&where);
+    before = hash_index.get_page_reads();
+    start = steady_clock::now();
+    handles = table.select(&where);
+    report("point select, hash       ", 1, 0, steady_clock::now() - start);
+    cout << "    " << hash_index.get_page_reads() - before << " index pages read (" << hash_index.get_bucket_count()
+         << " buckets)" << endl;
+    u_long hashed = handles->size();
+    delete handles;
+    table.detach(&hash_index);
+    hash_index.drop();
+
+    handles = table.select(&where);  // delete the row, so its key is missing but still within the zone maps
+    table.del(handles->front());
+    delete handles;
+    before = table.get_blocks_scanned();
+    start = steady_clock::now();
+    handles = table.select(&where);
+    report("missing key, no filter   ", 1, 0, steady_clock::now() - start);
+    cout << "    " << table.get_blocks_scanned() - before << " blocks read" << endl;
+    u_long missed = handles->size();
+    delete handles;
+    BloomFilter filter(table, "bf", {"a"});
+    filter.create();
+    table.attach(&filter);
+    before = table.get_blocks_scanned();
+    start = steady_clock::now();
+    handles = table.select(&where);
+    report("missing key, bloom filter", 1, 0, steady_clock::now() - start);
+    cout << "    " << table.get_blocks_scanned() - before << " blocks read (false-positive rate "
+         << filter.get_false_positive_rate() << ")" << endl;
+    missed += handles->size();
+    delete handles;
+    table.detach(&filter);
+    filter.drop();
+    table.drop();
+    return scanned == 1 && looked_up == 1 && hashed == 1 && missed == 0;
+}
+
+/**
+ * Run all the storage engine benchmarks.
+ * @return  true if they all ran correctly
+ */
+bool bench_storage() {
+#ifndef COUNT_ALLOCATIONS
+    cout << "(allocations aren't counted in this build; make sql5300_bench to count them)" << endl;
+#endif
+    cout << "record access:" << endl;
+    if (!bench_record_access())
+        return assertion_failure("record access benchmark");
+    cout << "page size:" << endl;
+    if (!bench_page_sizes())
+        return assertion_failure("page size benchmark");
+    cout << "sequential scan:" << endl;
+    if (!bench_bulk_scan())
+        return assertion_failure("sequential scan benchmark");
+    cout << "row insertion and projection:" << endl;
+    if (!bench_row_projection())
+        return assertion_failure("row insertion and projection benchmark");
+    cout << "bulk load:" << endl;
+    if (!bench_bulk_load())
+        return assertion_failure("bulk load benchmark");
+    cout << "vectorized scan:" << endl;
+    if (!bench_batch_scan())
+        return assertion_failure("vectorized scan benchmark");
+    cout << "column storage:" << endl;
+    if (!bench_column_storage())
+        return assertion_failure("column storage benchmark");
+    cout << "zone maps:" << endl;
+    if (!bench_zone_map())
+        return assertion_failure("zone map benchmark");
+    cout << "point lookup:" << endl;
+    if (!bench_point_lookup())
+        return assertion_failure("point lookup benchmark");
+    cout << "parallel scan:" << endl;
+    if (!bench_parallel_scan())
+        return assertion_failure("parallel scan benchmark");
+    return true;
+}
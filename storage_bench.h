@@ -0,0 +1,15 @@
+/**
+ * @file storage_bench.h - Microbenchmarks for the heap storage engine.
+ *
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "heap_storage.h"
+
+/**
+ * Run the storage engine microbenchmarks and print their results. Allocations per row are only counted
+ * when built with COUNT_ALLOCATIONS (the Makefile's sql5300_bench target).
+ * @returns  true if every benchmark ran and its sanity checks passed
+ */
+bool bench_storage();
@@ -3,7 +3,10 @@
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
+#include <algorithm>
+#include <set>
 #include "storage_engine.h"
+#include "Predicate.h"
 
 bool Value::operator==(const Value &other) const {
     if (this->data_type != other.data_type)
@@ -17,6 +20,88 @@ bool Value::operator!=(const Value &other) const {
     return !(*this == other);
 }
 
+bool Value::operator<(const Value &other) const {
+    if (this->data_type != other.data_type)
+        return this->data_type < other.data_type;
+    if (this->data_type == ColumnAttribute::INT)
+        return this->n < other.n;
+    return this->s < other.s;
+}
+
+bool ValueView::operator==(const Value &other) const {
+    if (this->data_type != other.data_type)
+        return false;
+    if (this->data_type == ColumnAttribute::INT)
+        return this->n == other.n;
+    return other.s.compare(0, std::string::npos, this->s, this->length) == 0;
+}
+
+bool ValueView::operator!=(const Value &other) const {
+    return !(*this == other);
+}
+
+int ValueView::compare(const Value &other) const {
+    if (this->data_type == ColumnAttribute::INT)
+        return this->n < other.n ? -1 : this->n > other.n ? 1 : 0;
+    return -other.s.compare(0, std::string::npos, this->s, this->length);
+}
+
+void ValueView::materialize(Value &value) const {
+    value.data_type = this->data_type;
+    if (this->data_type == ColumnAttribute::INT)
+        value.n = this->n;
+    else
+        value.s.assign(this->s, this->length);
+}
+
+void ColumnVector::clear() {
+    this->ints.clear();
+    this->offsets.resize(1);
+    this->bytes.clear();
+}
+
+void ColumnVector::append(const ValueView &value) {
+    if (this->data_type == ColumnAttribute::INT) {
+        this->ints.push_back(value.n);
+    } else {
+        this->bytes.insert(this->bytes.end(), value.s, value.s + value.length);
+        this->offsets.push_back((u_int32_t) this->bytes.size());
+    }
+}
+
+void ColumnVector::view(uint i, ValueView &value) const {
+    value.data_type = this->data_type;
+    if (this->data_type == ColumnAttribute::INT) {
+        value.n = this->ints[i];
+    } else {
+        value.s = this->bytes.data() + this->offsets[i];
+        value.length = (u_int16_t) (this->offsets[i + 1] - this->offsets[i]);
+    }
+}
+
+void ColumnVector::gather(const ColumnVector &source, const Selection &selection) {
+    if (this->data_type == ColumnAttribute::INT) {
+        size_t n = this->ints.size();
+        this->ints.resize(n + selection.size());
+        int32_t *to = this->ints.data() + n;
+        const int32_t *from = source.ints.data();
+        for (size_t i = 0; i < selection.size(); i++)
+            to[i] = from[selection[i]];
+    } else {
+        for (u_int16_t i: selection) {
+            const char *from = source.bytes.data() + source.offsets[i];
+            this->bytes.insert(this->bytes.end(), from, from + (source.offsets[i + 1] - source.offsets[i]));
+            this->offsets.push_back((u_int32_t) this->bytes.size());
+        }
+    }
+}
+
+void Batch::clear() {
+    for (auto &column: this->columns)
+        column.clear();
+    this->handles.clear();
+}
+
 // Just pulls out the column names from a ValueDict and passes that to the usual form of project().
 ValueDict *DbRelation::project(Handle handle, const ValueDict *where) {
     ColumnNames t;
@@ -24,3 +109,347 @@ ValueDict *DbRelation::project(Handle handle, const ValueDict *where) {
         t.push_back(column.first);
     return this->project(handle, &t);
 }
+
+void DbRelation::attach(DbIndex *index) {
+    if (std::find(this->indices.begin(), this->indices.end(), index) == this->indices.end())
+        this->indices.push_back(index);
+}
+
+void DbRelation::detach(DbIndex *index) {
+    this->indices.erase(std::remove(this->indices.begin(), this->indices.end(), index), this->indices.end());
+}
+
+// Whether an update of the given columns changes an index's entries (any update does if the columns aren't known).
+bool DbRelation::index_affected(const DbIndex *index, const ValueDict *new_values) {
+    if (new_values == nullptr)
+        return true;
+    for (auto const &column_name: index->get_key_columns())
+        if (new_values->find(column_name) != new_values->end())
+            return true;
+    for (auto const &column_name: index->get_include_columns())
+        if (new_values->find(column_name) != new_values->end())
+            return true;
+    return false;
+}
+
+// Look each key up in each unique index (unless a filter on the same key rules it out), and watch for keys
+// repeated among the rows themselves.
+void DbRelation::index_check(const Rows &rows, const Handle *handle) {
+    for (auto const &index: this->indices) {
+        if (!index->is_unique())
+            continue;
+        std::set<KeyValue> keys;
+        for (auto const &row: rows) {
+            KeyValue key = index->get_key(row);
+            bool duplicate = !keys.insert(key).second;
+            bool absent = false;
+            for (auto const &filter: this->indices)
+                if (!filter->finds_rows() && filter->get_key_columns() == index->get_key_columns())
+                    absent = absent || !filter->may_contain(key);
+            if (!duplicate && !absent) {
+                Handles *handles = index->lookup(key);
+                for (auto const &found: *handles)
+                    if (handle == nullptr || found != *handle)
+                        duplicate = true;
+                delete handles;
+            }
+            if (duplicate)
+                throw DbRelationError("duplicate key for unique index '" + index->get_name() + "' of table '"
+                                      + this->table_name + "'");
+        }
+    }
+}
+
+void DbRelation::index_insert(Handle handle, const ValueDict *new_values) {
+    uint done = 0;
+    try {
+        for (; done < this->indices.size(); done++)
+            if (index_affected(this->indices[done], new_values))
+                this->indices[done]->insert(handle);
+    } catch (...) {
+        try {
+            for (uint i = 0; i < done; i++)
+                if (index_affected(this->indices[i], new_values))
+                    this->indices[i]->del(handle);
+        } catch (...) {}
+        throw;
+    }
+}
+
+void DbRelation::index_del(Handle handle, const ValueDict *new_values) {
+    for (auto const &index: this->indices)
+        if (index_affected(index, new_values))
+            index->del(handle);
+}
+
+// The updated row is the stored one with the new values put in.
+bool DbRelation::index_update(Handle handle, const ValueDict *new_values) {
+    bool affected = false;
+    for (auto const &index: this->indices)
+        affected = affected || index_affected(index, new_values);
+    if (!affected)
+        return false;
+    ValueDict *old_values = project(handle);
+    Row row(&this->column_names);
+    row.from_dict(old_values);
+    delete old_values;
+    for (auto const &new_value: *new_values) {
+        int ordinal = row.index(new_value.first);
+        if (ordinal >= 0)
+            row[(uint) ordinal] = new_value.second;
+    }
+    index_check(Rows(1, row), &handle);
+    index_del(handle, new_values);
+    return true;
+}
+
+// Each index is scored by how much of its key the where clause pins down: two points for every leading
+// key column it sets equal to a value, then one for each end of a range on the next key column. An index
+// that isn't ordered (a hash index) only scores if every key column is set equal. Ties go to an index that
+// covers the needed columns, then to one that isn't ordered. Any index whose whole key is set equal is first
+// asked whether the key might be there at all.
+Handles *DbRelation::index_select(const Predicate &where, const std::vector<bool> *needed, Rows *rows) {
+    DbIndex *best = nullptr;
+    KeyValue best_min, best_max;
+    uint best_rank = 0;
+    for (auto const &index: this->indices) {
+        KeyValue min_key, max_key;
+        uint score = 0;
+        for (auto const &column_name: index->get_key_columns()) {
+            uint ordinal = (uint) (std::find(this->column_names.begin(), this->column_names.end(), column_name)
+                                   - this->column_names.begin());
+            Value min, max;
+            bool has_min, has_max;
+            where.bounds(ordinal, min, has_min, max, has_max);
+            if (has_min && has_max && min == max) {
+                min_key.push_back(min);
+                max_key.push_back(max);
+                score += 2;
+                continue;
+            }
+            if (!index->is_ordered()) {
+                score = 0;  // can only look up whole keys
+                break;
+            }
+            if (has_min) {
+                min_key.push_back(min);
+                score++;
+            }
+            if (has_max) {
+                max_key.push_back(max);
+                score++;
+            }
+            break;
+        }
+        if (score == 2 * index->get_key_columns().size() && !index->may_contain(min_key)) {
+            if (rows != nullptr)
+                rows->clear();
+            return new Handles();  // no row has the key
+        }
+        if (!index->finds_rows())
+            continue;
+        bool covering = needed != nullptr && index->covers(*needed);
+        uint rank = score == 0 ? 0 : score * 4 + (covering ? 2 : 0) + (index->is_ordered() ? 0 : 1);
+        if (rank > best_rank) {
+            best = index;
+            best_rank = rank;
+            best_min = min_key;
+            best_max = max_key;
+        }
+    }
+    if (best == nullptr)
+        return nullptr;
+    if (rows != nullptr && (needed == nullptr || !best->covers(*needed)))
+        rows = nullptr;
+    Rows found;
+    Handles *handles = best->is_ordered() ? best->range(best_min, best_max, rows == nullptr ? nullptr : &found)
+                                          : best->lookup(best_min, rows == nullptr ? nullptr : &found);
+    if (rows == nullptr) {
+        std::sort(handles->begin(), handles->end());
+        return handles;
+    }
+    std::vector<uint> order(handles->size());
+    for (uint i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [handles](uint a, uint b) { return (*handles)[a] < (*handles)[b]; });
+    Handles sorted;
+    rows->clear();
+    for (uint i: order) {
+        sorted.push_back((*handles)[i]);
+        rows->push_back(found[i]);
+    }
+    handles->swap(sorted);
+    return handles;
+}
+
+// Covering means the index has every projected column and every column the where clause reads.
+DbRelationScan *DbRelation::index_scan(const ColumnNames *column_names, const Predicate &where) {
+    if (this->indices.empty())
+        return nullptr;
+    std::vector<bool> needed(this->column_names.size(), column_names->empty());
+    for (auto const &column_name: *column_names) {
+        auto column = std::find(this->column_names.begin(), this->column_names.end(), column_name);
+        if (column == this->column_names.end())
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        needed[column - this->column_names.begin()] = true;
+    }
+    where.uses(needed);
+    bool covered = false;
+    for (auto const &index: this->indices)
+        covered = covered || index->covers(needed);
+    if (!covered)
+        return nullptr;
+    Rows *rows = new Rows();
+    Handles *handles = index_select(where, &needed, rows);
+    if (handles == nullptr || rows->size() != handles->size()) {
+        delete handles;
+        delete rows;
+        return nullptr;
+    }
+    return new DbIndexScan(*this, column_names, where, handles, rows);
+}
+
+Handles *DbIndex::lookup(const ValueDict *key_values) {
+    KeyValue key;
+    for (auto const &column_name: this->key_columns) {
+        ValueDict::const_iterator value = key_values->find(column_name);
+        if (value == key_values->end())
+            throw DbRelationError("no value for key column '" + column_name + "' of index '" + this->name + "'");
+        key.push_back(value->second);
+    }
+    return lookup(key);
+}
+
+DbIndex::DbIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+                 ColumnNames include_columns)
+        : relation(relation), name(name), key_columns(key_columns), unique(unique), include_columns(include_columns),
+          ordinals() {
+    const ColumnNames &column_names = relation.get_column_names();
+    ColumnNames columns(key_columns);
+    columns.insert(columns.end(), include_columns.begin(), include_columns.end());
+    for (auto const &column_name: columns) {
+        auto column = std::find(column_names.begin(), column_names.end(), column_name);
+        this->ordinals.push_back(column == column_names.end() ? -1 : (int) (column - column_names.begin()));
+    }
+}
+
+Handles *DbIndex::range(const KeyValue &min_key, const KeyValue &max_key, Rows *rows) {
+    throw DbRelationError("index '" + this->name + "' does not support range lookups");
+}
+
+bool DbIndex::covers(const std::vector<bool> &needed) const {
+    if (!finds_rows())
+        return false;
+    for (uint ordinal = 0; ordinal < needed.size(); ordinal++)
+        if (needed[ordinal] && std::find(this->ordinals.begin(), this->ordinals.end(), (int) ordinal) == this->ordinals.end())
+            return false;
+    return true;
+}
+
+KeyValue DbIndex::project(Handle handle, const ColumnNames &column_names) {
+    ValueDict *row = this->relation.project(handle, &column_names);
+    KeyValue values;
+    for (auto const &column_name: column_names)
+        values.push_back((*row)[column_name]);
+    delete row;
+    return values;
+}
+
+Row DbIndex::make_row(const KeyValue &values) const {
+    Row row(&this->relation.get_column_names());
+    for (uint i = 0; i < values.size() && i < this->ordinals.size(); i++)
+        if (this->ordinals[i] >= 0)
+            row[(uint) this->ordinals[i]] = values[i];
+    return row;
+}
+
+DbIndexScan::DbIndexScan(const DbRelation &relation, const ColumnNames *column_names, const Predicate &where,
+                         Handles *handles, Rows *rows)
+        : relation(relation), column_names(*column_names), ordinals(), where(new Predicate(where)), handles(handles),
+          rows(rows), next_row(0) {
+    const ColumnNames &relation_columns = relation.get_column_names();
+    if (this->column_names.empty())
+        this->column_names = relation_columns;
+    for (auto const &column_name: this->column_names)
+        this->ordinals.push_back((uint) (std::find(relation_columns.begin(), relation_columns.end(), column_name)
+                                         - relation_columns.begin()));
+}
+
+DbIndexScan::~DbIndexScan() {
+    delete this->where;
+    delete this->handles;
+    delete this->rows;
+}
+
+// Check the rows against the where clause one at a time, appending the projected values of those that pass.
+bool DbIndexScan::next(Batch &batch) {
+    if (batch.column_names != this->column_names) {
+        batch.column_names = this->column_names;
+        batch.columns.clear();
+        for (uint ordinal: this->ordinals) {
+            ColumnAttribute ca = this->relation.get_column_attributes()[ordinal];
+            batch.columns.push_back(ColumnVector(ca.get_data_type()));
+        }
+    }
+    batch.clear();
+    ValueView view;
+    while (this->next_row < this->rows->size() && batch.size() < Batch::CAPACITY) {
+        const Row &row = (*this->rows)[this->next_row];
+        Handle handle = (*this->handles)[this->next_row++];
+        if (!this->where->evaluate(row))
+            continue;
+        for (uint j = 0; j < this->ordinals.size(); j++) {
+            const Value &value = row[this->ordinals[j]];
+            view.data_type = value.data_type;
+            view.n = value.n;
+            view.s = value.s.data();
+            view.length = (u_int16_t) value.s.length();
+            batch.columns[j].append(view);
+        }
+        batch.handles.push_back(handle);
+    }
+    return batch.size() > 0;
+}
+
+KeyValue DbIndex::get_key(const Row &row) const {
+    KeyValue key;
+    for (auto const &column_name: this->key_columns)
+        key.push_back(row[(uint) row.index(column_name)]);
+    return key;
+}
+
+int Row::index(const Identifier &column_name) const {
+    return index(*this->schema, column_name);
+}
+
+int Row::index(const ColumnNames &schema, const Identifier &column_name) {
+    for (uint ordinal = 0; ordinal < schema.size(); ordinal++)
+        if (schema[ordinal] == column_name)
+            return (int) ordinal;
+    return -1;
+}
+
+bool Row::from_dict(const ValueDict *dict) {
+    for (uint ordinal = 0; ordinal < this->schema->size(); ordinal++) {
+        ValueDict::const_iterator column = dict->find((*this->schema)[ordinal]);
+        if (column == dict->end())
+            return false;
+        this->values[ordinal] = column->second;
+    }
+    return true;
+}
+
+ValueDict *Row::to_dict(const ColumnNames *column_names) const {
+    if (column_names->empty())
+        column_names = this->schema;
+    ValueDict *dict = new ValueDict();
+    for (auto const &column_name: *column_names) {
+        int ordinal = index(column_name);
+        if (ordinal < 0) {
+            delete dict;
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        }
+        (*dict)[column_name] = this->values[ordinal];
+    }
+    return dict;
+}
@@ -3,6 +3,8 @@
  * DbBlock
  * DbFile
  * DbRelation
+ * DbIndex
+ * DbIndexScan: DbRelationScan
  *
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
@@ -28,6 +30,20 @@ typedef u_int32_t BlockID;
 typedef std::vector<RecordID> RecordIDs;
 typedef std::length_error DbBlockNoRoomError;
 
+/**
+ * @class RecordView - non-owning view of a record's bytes within a block.
+ * Only valid while the block it came from is in memory and unchanged.
+ */
+class RecordView {
+public:
+    const char *data;
+    u_int32_t size;
+
+    RecordView() : data(nullptr), size(0) {}
+
+    RecordView(const void *data, u_int32_t size) : data((const char *) data), size(size) {}
+};
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files 
  * (DbBlock's belong to DbFile's.)
@@ -35,6 +51,7 @@ typedef std::length_error DbBlockNoRoomError;
  * Methods for putting/getting records in blocks:
  * 	add(data)
  * 	get(record_id)
+ * 	view(record_id, record)
  * 	put(record_id, data)
  * 	del(record_id)
  * 	ids()
@@ -42,14 +59,20 @@ typedef std::length_error DbBlockNoRoomError;
  * 	get_block()
  * 	get_data()
  * 	get_block_id()
+ * 	get_block_size()
  */
 class DbBlock {
 public:
     /**
-     * our blocks are 4kB
+     * our blocks are 4kB unless the file was created with a larger block size
      */
     static const uint BLOCK_SZ = 4096;
 
+    /**
+     * largest block size (record offsets within a block are 16 bits)
+     */
+    static const uint MAX_BLOCK_SZ = 65536;
+
     /**
      * ctor/dtor (subclasses should handle the big-5)
      */
@@ -72,6 +95,14 @@ public:
      */
     virtual Dbt *get(RecordID record_id) const = 0;
 
+    /**
+     * Get a record from this block without copying or allocating.
+     * @param record_id  which record to fetch
+     * @param record     returned by reference: view of the record's bytes within this block
+     * @returns          false if the record has been deleted
+     */
+    virtual bool view(RecordID record_id, RecordView &record) const = 0;
+
     /**
      * Change the data stored for a record in this block.
      * @param record_id  which record to update
@@ -82,7 +113,7 @@ public:
     virtual void put(RecordID record_id, const Dbt &data) = 0;
 
     /**
-     * Delete a record from this block.
+     * Delete a record from this block. Its RecordID may be handed out again by a later add().
      * @param record_id  which record to delete
      */
     virtual void del(RecordID record_id) = 0;
@@ -111,13 +142,57 @@ public:
      */
     virtual BlockID get_block_id() { return block_id; }
 
+    /**
+     * Get the size of this block in bytes (BLOCK_SZ up to MAX_BLOCK_SZ).
+     * @returns this block's size
+     */
+    virtual uint get_block_size() const { return block.get_size(); }
+
 protected:
     Dbt block;
     BlockID block_id;
 };
 
 // convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<BlockID> BlockIDs;
+
+/**
+ * @class BlockIDIterator - iterator over a run of consecutive BlockIDs, computed as it goes
+ */
+class BlockIDIterator {
+public:
+    explicit BlockIDIterator(BlockID block_id) : block_id(block_id) {}
+
+    BlockID operator*() const { return block_id; }
+
+    BlockIDIterator &operator++() {
+        ++block_id;
+        return *this;
+    }
+
+    bool operator==(const BlockIDIterator &other) const { return block_id == other.block_id; }
+
+    bool operator!=(const BlockIDIterator &other) const { return block_id != other.block_id; }
+
+protected:
+    BlockID block_id;
+};
+
+/**
+ * @class BlockIDRange - the BlockIDs first through last, for a range-based for loop (no vector is built)
+ */
+class BlockIDRange {
+public:
+    BlockIDRange(BlockID first, BlockID last) : first(first), last(last) {}
+
+    BlockIDIterator begin() const { return BlockIDIterator(first); }
+
+    BlockIDIterator end() const { return BlockIDIterator(last + 1); }
+
+protected:
+    BlockID first;
+    BlockID last;
+};
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -128,7 +203,7 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  * 	get_new()
  *	get(block_id)
  *	put(block)
- *	block_ids()
+ *	blocks()
  */
 class DbFile {
 public:
@@ -177,11 +252,10 @@ public:
     virtual void put(DbBlock *block) = 0;
 
     /**
-     * Get a list of all the valid BlockID's in the file
-     * FIXME - not a good long-term approach, but we'll do this until we put in iterators
-     * @returns  a pointer to vector of BlockIDs (freed by caller)
+     * Get all the valid BlockID's in the file, streamed in order.
+     * @returns  range of BlockIDs to iterate over
      */
-    virtual BlockIDs *block_ids() const = 0;
+    virtual BlockIDRange blocks() const = 0;
 
 protected:
     std::string name;  // filename (or part of it)
@@ -230,16 +304,56 @@ public:
     bool operator==(const Value &other) const;
 
     bool operator!=(const Value &other) const;
+
+    /**
+     * Order values of the same type (TEXTs compare bytewise); an INT comes before any TEXT.
+     */
+    bool operator<(const Value &other) const;
+};
+
+
+/**
+ * @class ValueView - non-owning view of a field's value within a record. A TEXT value is left
+ * in the block (s and length) until materialize() copies it out; like a RecordView, the view is
+ * only valid while the block it came from is in memory and unchanged.
+ */
+class ValueView {
+public:
+    ColumnAttribute::DataType data_type;
+    int32_t n;
+    const char *s;
+    u_int16_t length;
+
+    ValueView() : data_type(ColumnAttribute::INT), n(0), s(nullptr), length(0) {}
+
+    bool operator==(const Value &other) const;
+
+    bool operator!=(const Value &other) const;
+
+    /**
+     * Order the viewed value against a value of the same type (TEXTs compare bytewise).
+     * @param other  value to compare with
+     * @returns      negative, zero or positive as this value is less than, equal to or greater than other
+     */
+    int compare(const Value &other) const;
+
+    /**
+     * Copy the viewed value into a Value (reusing its memory).
+     * @param value  where to put it
+     */
+    void materialize(Value &value) const;
 };
 
 // More type aliases
 typedef std::string Identifier;
 typedef std::vector<Identifier> ColumnNames;
+typedef std::vector<Identifier> IndexNames;
 typedef std::vector<ColumnAttribute> ColumnAttributes;
 typedef std::pair<BlockID, RecordID> Handle;
 typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
 typedef std::map<Identifier, Value> ValueDict;
 typedef std::vector<ValueDict *> ValueDicts;
+typedef std::vector<Value> KeyValue;  // the values of an index's key columns, in order
 
 
 /**
@@ -251,6 +365,183 @@ public:
 };
 
 
+/**
+ * @class Row - the values of a row by column ordinal
+ *
+ * This is how rows move through the storage engine and the executor: a Row is one vector, so
+ * filling in a row again (e.g., once per record in a scan) allocates nothing once its TEXT values have
+ * grown to size. The schema is the relation's own list of column names, shared by all its rows, and is
+ * only needed to get at a value by name. ValueDict is the form rows take at the API edge; see
+ * from_dict() and to_dict().
+ */
+class Row {
+public:
+    Row() : schema(nullptr), values() {}
+
+    explicit Row(const ColumnNames *schema) : schema(schema), values(schema->size()) {}
+
+    virtual ~Row() {}
+
+    /**
+     * Number of values (that is, of columns in the schema).
+     */
+    uint size() const { return (uint) values.size(); }
+
+    Value &operator[](uint ordinal) { return values[ordinal]; }
+
+    const Value &operator[](uint ordinal) const { return values[ordinal]; }
+
+    /**
+     * The column names the values are for.
+     */
+    const ColumnNames *get_schema() const { return schema; }
+
+    /**
+     * Find a column's ordinal by name.
+     * @param column_name  column to look for
+     * @returns            its ordinal, or -1 if the schema doesn't have it
+     */
+    int index(const Identifier &column_name) const;
+
+    /**
+     * Find a column's ordinal by name in a schema (e.g., a table's column names).
+     * @param schema       the column names
+     * @param column_name  column to look for
+     * @returns            its ordinal, or -1 if the schema doesn't have it
+     */
+    static int index(const ColumnNames &schema, const Identifier &column_name);
+
+    /**
+     * Set every value of the row from a dictionary.
+     * @param dict  values keyed by column name
+     * @returns     false if the dictionary is missing any column of the schema
+     */
+    bool from_dict(const ValueDict *dict);
+
+    /**
+     * Copy the given columns into a new dictionary.
+     * @param column_names  columns to copy (all of them if empty)
+     * @returns             dictionary keyed by column name (freed by caller)
+     * @throws              DbRelationError if the schema doesn't have one of the columns
+     */
+    ValueDict *to_dict(const ColumnNames *column_names) const;
+
+protected:
+    const ColumnNames *schema;
+    std::vector<Value> values;
+};
+
+typedef std::vector<Row> Rows;
+
+/**
+ * Positions of rows within a Batch (e.g., the ones that satisfy a where clause), in increasing order.
+ */
+typedef std::vector<u_int16_t> Selection;
+
+
+/**
+ * @class ColumnVector - the values of one column for a batch of rows, stored contiguously
+ *
+ * INT values are a plain int32_t array. TEXT values are stored back to back in one byte array, with
+ * value i running from offsets[i] up to offsets[i + 1]. Clearing keeps the memory, so a vector that is
+ * refilled batch after batch stops allocating once it has grown to size.
+ */
+class ColumnVector {
+public:
+    ColumnAttribute::DataType data_type;
+    std::vector<int32_t> ints;       // INT: the values
+    std::vector<u_int32_t> offsets;  // TEXT: where each value starts in bytes, plus where the last one ends
+    std::vector<char> bytes;         // TEXT: the values
+
+    explicit ColumnVector(ColumnAttribute::DataType data_type = ColumnAttribute::INT)
+            : data_type(data_type), ints(), offsets(1, 0), bytes() {}
+
+    virtual ~ColumnVector() {}
+
+    /**
+     * Number of values.
+     */
+    uint size() const {
+        return (uint) (data_type == ColumnAttribute::INT ? ints.size() : offsets.size() - 1);
+    }
+
+    /**
+     * Remove all the values (keeping the memory).
+     */
+    void clear();
+
+    /**
+     * Add a value to the end.
+     * @param value  a value of the vector's type
+     */
+    void append(const ValueView &value);
+
+    /**
+     * Look at a value in place.
+     * @param i      its position
+     * @param value  set to view it
+     */
+    void view(uint i, ValueView &value) const;
+
+    /**
+     * Projection kernel: add the selected values of another vector of the same type to the end.
+     * @param source     the vector to copy from
+     * @param selection  the positions in source to copy
+     */
+    void gather(const ColumnVector &source, const Selection &selection);
+};
+
+
+/**
+ * @class Batch - up to CAPACITY rows in column-major form, as filled in by a DbRelationScan
+ */
+class Batch {
+public:
+    /**
+     * most rows a scan puts in a batch
+     */
+    static const uint CAPACITY = 1024;
+
+    ColumnNames column_names;           // the projected columns
+    std::vector<ColumnVector> columns;  // their values, one vector per column in column_names
+    Handles handles;                    // the rows the values came from
+
+    Batch() : column_names(), columns(), handles() {}
+
+    virtual ~Batch() {}
+
+    /**
+     * Number of rows.
+     */
+    uint size() const { return (uint) handles.size(); }
+
+    /**
+     * Remove all the rows (keeping the memory).
+     */
+    void clear();
+};
+
+
+/**
+ * @class DbRelationScan - a scan of a relation that hands out its rows a Batch at a time
+ */
+class DbRelationScan {
+public:
+    virtual ~DbRelationScan() {}
+
+    /**
+     * Get the next batch of rows.
+     * @param batch  refilled with up to Batch::CAPACITY rows (its columns are those the scan projects)
+     * @returns      false if there are no more rows (batch is left empty)
+     */
+    virtual bool next(Batch &batch) = 0;
+};
+
+class Predicate;
+
+class DbIndex;
+
+
 /**
  * @class DbRelation - top-level object handling a physical database relation
  * 
@@ -269,6 +560,12 @@ public:
  *	select(where)
  *	project(handle)
  *	project(handle, column_names)
+ *	scan(column_names, where)
+ *	attach(index)
+ *	detach(index)
+ *
+ * A relation keeps the indices attached to it up to date as its rows change, and its selects use the
+ * one that narrows a where clause down the most (if any does) instead of scanning.
  */
 class DbRelation {
 public:
@@ -318,8 +615,12 @@ public:
      * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
      * where handle is sufficient to identify one specific record (e.g., returned
      * from an insert or select).
+     * A row that grows may not fit where it is: a HeapTable moves it to another block, but a ColumnTable's
+     * rows stay in their row group, so once the 1/8 of a TEXT segment kept free for updates is used up,
+     * growing a value in that group fails (the caller can delete the row and insert it again instead).
      * @param handle      the row to update
      * @param new_values  a dictionary keyed by column names for changing columns
+     * @throws DbRelationError if the updated row doesn't fit (the row is left as it was)
      */
     virtual void update(const Handle handle, const ValueDict *new_values) = 0;
 
@@ -369,8 +670,296 @@ public:
      */
     virtual ValueDict *project(Handle handle, const ValueDict *column_names);
 
+    /**
+     * Vectorized form of SELECT <column_names> FROM <table_name> WHERE <where>: the qualifying rows'
+     * values come out a Batch at a time, column by column.
+     * @param column_names  list of column names to project (all of them if empty)
+     * @param where         compiled where clause (see Predicate); the scan keeps a copy
+     * @returns             the scan (freed by caller)
+     */
+    virtual DbRelationScan *scan(const ColumnNames *column_names, const Predicate &where) = 0;
+
+    /**
+     * Keep an index of this relation up to date from now on, and use it to answer selects.
+     * Attaching an index that is already attached does nothing.
+     * @param index  the index (already created or opened; not owned by the relation)
+     */
+    virtual void attach(DbIndex *index);
+
+    /**
+     * Stop keeping an index up to date (e.g., before dropping it).
+     * @param index  the index
+     */
+    virtual void detach(DbIndex *index);
+
+    const Identifier &get_table_name() const { return table_name; }
+
+    const ColumnNames &get_column_names() const { return column_names; }
+
+    const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
 protected:
     Identifier table_name;
     ColumnNames column_names;
     ColumnAttributes column_attributes;
+    std::vector<DbIndex *> indices;
+
+    /**
+     * Make sure rows about to be stored would not give any unique index a duplicate key, either with a
+     * row already there or with each other.
+     * @param rows    the rows, in column order
+     * @param handle  the row being updated, whose own key doesn't count (nullptr for new rows)
+     * @throws DbRelationError if one would
+     */
+    virtual void index_check(const Rows &rows, const Handle *handle = nullptr);
+
+    /**
+     * Add a stored row to the indices (undoing the ones done so far if one fails).
+     * @param handle      the row
+     * @param new_values  if not nullptr, only the indices with a key or included column among these are changed
+     */
+    virtual void index_insert(Handle handle, const ValueDict *new_values = nullptr);
+
+    /**
+     * Take a row, while it is still stored, out of the indices.
+     * @param handle      the row
+     * @param new_values  if not nullptr, only the indices with a key or included column among these are changed
+     */
+    virtual void index_del(Handle handle, const ValueDict *new_values = nullptr);
+
+    /**
+     * Get ready to update a row: check that the updated row's keys would still be unique, then take the
+     * row out of the indices whose keys or included columns the update changes.
+     * @param handle      the row
+     * @param new_values  the columns that are changing
+     * @returns           true if any index is affected (put the row back with index_insert() afterward)
+     */
+    virtual bool index_update(Handle handle, const ValueDict *new_values);
+
+    /**
+     * Use the attached index that narrows a where clause down the most (of those that do equally well,
+     * one that covers the needed columns). If an attached index says no row has the key the where clause
+     * sets equal (see DbIndex::may_contain), no row is selected without looking any further.
+     * @param where   the where clause
+     * @param needed  needed[ordinal] is set for each column the caller wants to read (nullptr for none)
+     * @param rows    if not nullptr and the index covers the needed columns, set to the rows' values as
+     *                read from the index alone, in the same order as the handles (only the index's columns
+     *                are filled in); left empty otherwise
+     * @returns       the rows the index can't rule out, in handle order (freed by caller); the rest of
+     *                the where clause still has to be checked against them. nullptr if no index helps.
+     */
+    virtual Handles *index_select(const Predicate &where, const std::vector<bool> *needed = nullptr,
+                                  Rows *rows = nullptr);
+
+    /**
+     * Index-only scan: answer a scan from the index index_select() picks, if it covers every projected
+     * column and every column the where clause reads, without reading the relation's blocks.
+     * @param column_names  columns to project (all of them if empty)
+     * @param where         where clause the rows must meet
+     * @returns             the scan (freed by caller), or nullptr if no index can answer it
+     */
+    virtual DbRelationScan *index_scan(const ColumnNames *column_names, const Predicate &where);
+
+    static bool index_affected(const DbIndex *index, const ValueDict *new_values);
+};
+
+
+/**
+ * @class DbIndex - top-level object handling a physical index of a relation: a map from the values of
+ * some of its columns (the key) to the handles of the rows with those values
+ *
+ * Methods:
+ *	create()
+ *	drop()
+ *	open()
+ *	close()
+ *	lookup(key)
+ *	range(min_key, max_key)
+ *	insert(handle)
+ *	del(handle)
+ *
+ * The relation keeps the index up to date once it is attached to it (see DbRelation::attach).
+ * Besides its key, each entry can carry the values of some more of the row's columns (the included
+ * columns), so that a query that needs no other column can be answered from the index alone.
+ */
+class DbIndex {
+public:
+    // ctor/dtor
+    DbIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+            ColumnNames include_columns = ColumnNames());
+
+    virtual ~DbIndex() {}
+
+    /**
+     * Create the index and fill it in from the relation's rows.
+     * @throws DbRelationError  if the index is unique and two rows have the same key
+     */
+    virtual void create() = 0;
+
+    /**
+     * Remove the index.
+     */
+    virtual void drop() = 0;
+
+    /**
+     * Open the existing index.
+     */
+    virtual void open() = 0;
+
+    /**
+     * Close the index.
+     */
+    virtual void close() = 0;
+
+    /**
+     * Find the rows with a given key.
+     * @param key  a value for each key column, in order
+     * @returns    handles of the rows (freed by caller)
+     */
+    virtual Handles *lookup(const KeyValue &key) { return lookup(key, nullptr); }
+
+    /**
+     * Find the rows with a given key, and read their key and included columns out of the index.
+     * @param key   a value for each key column, in order
+     * @param rows  if not nullptr, a row of the relation's columns is added for each handle, with just
+     *              the index's columns filled in
+     * @returns     handles of the rows (freed by caller)
+     */
+    virtual Handles *lookup(const KeyValue &key, Rows *rows) = 0;
+
+    /**
+     * Find the rows with a given key.
+     * @param key_values  a value for each key column (other columns are ignored)
+     * @returns           handles of the rows (freed by caller)
+     * @throws DbRelationError  if a key column is missing
+     */
+    virtual Handles *lookup(const ValueDict *key_values);
+
+    /**
+     * Find the rows whose keys fall in a range (both ends included).
+     * @param min_key  least key, or some leading part of it (empty for no least key)
+     * @param max_key  greatest key, or some leading part of it (empty for no greatest key)
+     * @returns        handles of the rows, in key order (freed by caller)
+     * @throws DbRelationError  if the index doesn't keep its keys in order
+     */
+    virtual Handles *range(const KeyValue &min_key, const KeyValue &max_key) { return range(min_key, max_key, nullptr); }
+
+    /**
+     * Find the rows whose keys fall in a range, and read their key and included columns out of the index.
+     * @param min_key  least key, or some leading part of it (empty for no least key)
+     * @param max_key  greatest key, or some leading part of it (empty for no greatest key)
+     * @param rows     if not nullptr, a row of the relation's columns is added for each handle, with just
+     *                 the index's columns filled in
+     * @returns        handles of the rows, in key order (freed by caller)
+     * @throws DbRelationError  if the index doesn't keep its keys in order
+     */
+    virtual Handles *range(const KeyValue &min_key, const KeyValue &max_key, Rows *rows);
+
+    /**
+     * Whether the index keeps its keys in order, so that it can find a range of them (see range()).
+     * An index that doesn't can only look up whole keys.
+     */
+    virtual bool is_ordered() const { return false; }
+
+    /**
+     * Whether the index finds rows at all. One that doesn't (a BloomFilter) can only say which keys no row
+     * has (see may_contain()); lookup() and range() throw.
+     */
+    virtual bool finds_rows() const { return true; }
+
+    /**
+     * Whether any row might have a given key. False only if certainly none does, so that a select or a
+     * uniqueness check for it needn't look any further.
+     * @param key  a value for each key column, in order
+     */
+    virtual bool may_contain(const KeyValue &key) { return true; }
+
+    /**
+     * Add a row of the relation (which must already be stored there) to the index.
+     * @param handle  the row
+     * @throws DbRelationError  if the index is unique and already has the row's key
+     */
+    virtual void insert(Handle handle) = 0;
+
+    /**
+     * Remove a row of the relation (which must still be stored there) from the index.
+     * @param handle  the row
+     */
+    virtual void del(Handle handle) = 0;
+
+    /**
+     * Pick a row's key out of its values.
+     * @param row  a row of the relation
+     * @returns    the key
+     */
+    virtual KeyValue get_key(const Row &row) const;
+
+    const Identifier &get_name() const { return name; }
+
+    const ColumnNames &get_key_columns() const { return key_columns; }
+
+    const ColumnNames &get_include_columns() const { return include_columns; }
+
+    bool is_unique() const { return unique; }
+
+    /**
+     * Whether the index has the values of all the given columns of the relation.
+     * @param needed  needed[ordinal] is set for each of them
+     */
+    bool covers(const std::vector<bool> &needed) const;
+
+protected:
+    DbRelation &relation;
+    Identifier name;
+    ColumnNames key_columns;
+    bool unique;
+    ColumnNames include_columns;
+    std::vector<int> ordinals;  // the relation's ordinal of each key column, then of each included column
+
+    /**
+     * Get some of a row's values from the relation.
+     * @param handle        the row
+     * @param column_names  which columns
+     * @returns             their values, in the same order
+     */
+    KeyValue project(Handle handle, const ColumnNames &column_names);
+
+    /**
+     * Build a row of the relation from an entry's values.
+     * @param values  the entry's key, then its included values
+     * @returns       the row, with just the index's columns filled in
+     */
+    Row make_row(const KeyValue &values) const;
+};
+
+
+/**
+ * @class DbIndexScan - a scan answered from the rows an index read out of its entries (see
+ * DbRelation::index_scan), whose values it hands out a Batch at a time
+ */
+class DbIndexScan : public DbRelationScan {
+public:
+    DbIndexScan(const DbRelation &relation, const ColumnNames *column_names, const Predicate &where,
+                Handles *handles, Rows *rows);
+
+    virtual ~DbIndexScan();
+
+    DbIndexScan(const DbIndexScan &other) = delete;
+
+    DbIndexScan(DbIndexScan &&temp) = delete;
+
+    DbIndexScan &operator=(const DbIndexScan &other) = delete;
+
+    DbIndexScan &operator=(DbIndexScan &&temp) = delete;
+
+    virtual bool next(Batch &batch);
+
+protected:
+    const DbRelation &relation;
+    ColumnNames column_names;
+    std::vector<uint> ordinals;  // relation ordinal of each projected column
+    const Predicate *where;
+    Handles *handles;
+    Rows *rows;
+    uint next_row;
 };